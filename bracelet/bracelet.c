@@ -22,35 +22,85 @@
 #include "bracelet.h"
 #include "bracelet_ant.h"
 #include "bracelet_ble.h"
+#include "cue.h"
 #include "mma865.h"
+#include "motion.h"
 #include "nfc.h"
+#include "showclock.h"
+#include "tempo.h"
+#include "tilt.h"
+#include "trace.h"
 #include "ws2812.h"
 
 APP_TIMER_DEF(led_timer_id);
 APP_TIMER_DEF(longpress_timer_id);
-APP_TIMER_DEF(cooldown_timer_id);
 APP_TIMER_DEF(battery_timer_id);
 APP_TIMER_DEF(shutdown_timer_id);
 APP_TIMER_DEF(advertising_timer_id);
+APP_TIMER_DEF(stats_timer_id);
+APP_TIMER_DEF(beat_timer_id);
+APP_TIMER_DEF(idle_timer_id);
+APP_TIMER_DEF(cue_timer_id);
 
 // static uint8_t current_group = 0;
 static control_state_e state = INACTIVE;
 static bool longpress = false; /* button longpress timer active */
-static bool cooldown = false;
 static bool initialized = false;
 static button_mode_e button_mode = BTN_NUM_MODES;
+static uint32_t mode_wakeups[WS2812_NUM_MODES]; /* CPU wakeups in each LED mode */
+static motion_detector_t clap_detector = MOTION_DETECTOR(CLAP_JERK_THRESHOLD, COOLDOWN_MS);
+static motion_detector_t wave_detector = MOTION_DETECTOR(WAVE_JERK_THRESHOLD, 0);
+static tempo_t tempo;
+static tilt_t tilt;
+static cue_queue_t cues; /* received cues waiting for their show time */
+static uint32_t beat_ticks; /* app timer counter at the last predicted pulse */
+static uint8_t free_beats;  /* predicted pulses since the last clap */
+#if TRACE_RECORD
+static uint8_t trace_buffer[TRACE_BUFFER_BYTES];
+static trace_t trace;
+static uint16_t trace_dumped = 0; /* bytes of the full trace logged so far */
+#endif
 
 uint8_t group = 0;
 
 /* ######################### EVENT HANDLERS ######################### */
+static bool idle_state(control_state_e s) {
+  return s == INACTIVE || s == IDLE;
+}
+
 static void switch_state(control_state_e new_state) {
+  /* the accelerometer's wake detection runs through INACTIVE and IDLE, IDLE also has the LEDs,
+     radio and periodic timers off */
+  if (state == IDLE && new_state != IDLE) {
+    /* schedules the LED tick again */
+    ws2812_on();
+    ant_rx_open();
+    app_timer_start(battery_timer_id, APP_TIMER_TICKS(BATTERY_INTERVAL_MS), NULL);
+    app_timer_start(stats_timer_id, APP_TIMER_TICKS(STATS_INTERVAL_MS), NULL);
+  }
+  if (idle_state(state) && !idle_state(new_state)) {
+    app_timer_stop(idle_timer_id);
+    mma865_set_wake(false);
+  }
   switch (new_state) {
     case (SHUTDOWN):
       break;
     case (INACTIVE):
-      mma865_standby();
-      ws2812_set_all_rgb(0, 0, 10);
+      if (state != IDLE) {
+        mma865_set_wake(true);
+      }
+      ws2812_set_all_rgb(0, 0, INDICATOR_DIM);
       ws2812_set_mode(WS2812_STATIC);
+      app_timer_stop(idle_timer_id);
+      app_timer_start(idle_timer_id, APP_TIMER_TICKS(IDLE_STILL_MS), NULL);
+      break;
+    case (IDLE):
+      app_timer_stop(battery_timer_id);
+      app_timer_stop(stats_timer_id);
+      ant_rx_close();
+      /* stops the PWM, no frames are written until ws2812_on() */
+      app_timer_stop(led_timer_id);
+      ws2812_off();
       break;
     case (BUTTONS):
       mma865_standby();
@@ -75,6 +125,46 @@ static void switch_state(control_state_e new_state) {
   state = new_state;
 }
 
+/* LED mode for each control value received over BLE or ANT */
+static const color_gen_mode_e control_modes[] = {
+    WS2812_STATIC,
+    WS2812_PULSE,
+    WS2812_BLINK,
+    WS2812_CLAP_PULSE, /* TODO motion clap mode */
+};
+
+/* switch LED mode, accelerometer only runs for the modes that react to motion */
+static void set_led_mode(color_gen_mode_e mode) {
+  /* a state change may have put the accelerometer in standby even if the mode stays */
+  if (ws2812_mode_uses_motion(mode)) {
+    mma865_active();
+  } else {
+    mma865_standby();
+  }
+#if ACC_OFFLOAD_CLAPS
+  /* claps are big enough for the sensor's own detection, waves need every sample */
+  mma865_set_offload(mode == WS2812_CLAP_TOGGLE || mode == WS2812_CLAP_PULSE);
+#endif
+  /* BLE and ANT updates repeat the mode, the beat and detection carry on through them */
+  if (mode == ws2812_get_mode()) {
+    return;
+  }
+#if ACC_OFFLOAD_CLAPS
+  /* detection times come from a different clock when offloaded so the cooldown starts over */
+  motion_reset(&clap_detector);
+#endif
+  tempo_reset(&tempo);
+  tilt_reset(&tilt);
+  app_timer_stop(beat_timer_id);
+  ws2812_set_mode(mode);
+}
+
+static void set_control_mode(uint8_t control) {
+  if (control < ARRAY_SIZE(control_modes)) {
+    set_led_mode(control_modes[control]);
+  }
+}
+
 static void cycle_button_mode() {
   button_mode += 1;
   if (button_mode >= BTN_NUM_MODES) {
@@ -83,62 +173,160 @@ static void cycle_button_mode() {
 
   switch (button_mode) {
     case (BTN_STATIC_PURPLE):
-      mma865_standby();
       ws2812_set_all_rgb(255, 0, 255);
-      ws2812_set_mode(WS2812_STATIC);
+      set_led_mode(WS2812_STATIC);
       break;
     case (BTN_BLINKING_GREEN):
-      mma865_standby();
       ws2812_set_all_rgb(0, 255, 0);
-      ws2812_set_mode(WS2812_BLINK);
+      set_led_mode(WS2812_BLINK);
       break;
     case (BTN_PULSING_RED):
-      mma865_standby();
       ws2812_set_all_rgb(255, 0, 0);
-      ws2812_set_mode(WS2812_PULSE);
+      set_led_mode(WS2812_PULSE);
       break;
     case (BTN_RAINBOW):
-      mma865_standby();
-      ws2812_set_mode(WS2812_RAINBOW);
+      set_led_mode(WS2812_RAINBOW);
       break;
     case (BTN_SHIFTING_RED_TO_PURPLE):
-      mma865_standby();
       ws2812_set_transition(255, 255, 255, 100, 255, 100);
-      ws2812_set_mode(WS2812_COLOR_SHIFT);
+      set_led_mode(WS2812_COLOR_SHIFT);
       break;
     case (BTN_SHIFTING_GREEN_TO_BLUE):
-      mma865_standby();
       ws2812_set_transition(81, 255, 255, 160, 255, 255);
-      ws2812_set_mode(WS2812_COLOR_SHIFT);
+      set_led_mode(WS2812_COLOR_SHIFT);
       break;
     case (BTN_CLAP_TOGGLE):
-      mma865_active();
-      ws2812_set_mode(WS2812_CLAP_TOGGLE);
+      set_led_mode(WS2812_CLAP_TOGGLE);
       break;
     case (BTN_CLAP_PULSE):
-      mma865_active();
-      ws2812_set_mode(WS2812_CLAP_PULSE);
+      set_led_mode(WS2812_CLAP_PULSE);
       break;
     case (BTN_WAVE_RAINBOW):
-      mma865_active();
-      ws2812_set_mode(WS2812_WAVE_RAINBOW);
+      set_led_mode(WS2812_WAVE_RAINBOW);
+      break;
+    case (BTN_TILT):
+      set_led_mode(WS2812_TILT);
       break;
     default:
       break;
   }
 }
 
+/* no motion or button press for IDLE_STILL_MS */
+static void idle_timer_handler(void* p_context) {
+  if (state == INACTIVE) {
+    switch_state(IDLE);
+  }
+}
+
 static void advertising_timer_handler(void* p_context) {
   advertising_stop();
   switch_state(INACTIVE);
 }
 
+/* single shot, each tick schedules the next one for when the effect next changes */
 static void led_timer_handler(void* p_context) {
-  ws2812_tick();
+  uint32_t show_ms = 0;
+  uint32_t next_ms;
+  /* effects follow the controller's show time while it is driving the bracelet */
+  bool show_valid = (state == ANT) && ant_show_time(&show_ms);
+  ws2812_set_show_time(show_valid, show_ms);
+  next_ms = ws2812_tick();
+  if (next_ms) {
+    app_timer_start(led_timer_id, APP_TIMER_TICKS(next_ms), NULL);
+  }
+}
+
+/* LEDs need a tick sooner than the one scheduled, or none is scheduled */
+void led_wake_handler(void) {
+  app_timer_stop(led_timer_id);
+  app_timer_start(led_timer_id, APP_TIMER_TICKS(LED_WAKE_MS), NULL);
+}
+
+/* predicted beat, pulse and keep going at the tempo for a few beats without claps */
+static void beat_timer_handler(void* p_context) {
+  ws2812_detect_motion();
+  beat_ticks = app_timer_cnt_get();
+  if (++free_beats < TEMPO_FREE_BEATS) {
+    app_timer_start(beat_timer_id, APP_TIMER_TICKS(tempo_period_ms(&tempo)), NULL);
+  }
+}
+
+/* start the cue timer for the next cue due. The wait is converted at the nominal clock rates,
+   close enough over the few seconds a cue waits and the handler checks again anyway */
+static void cue_arm(void) {
+  const cue_t* cue = cue_peek(&cues);
+  uint32_t now, ticks;
+  int32_t wait;
+
+  app_timer_stop(cue_timer_id);
+  if (!cue || !ant_show_ticks(&now)) {
+    return;
+  }
+  wait = cue->time - now;
+  ticks = wait > 0 ? ((uint64_t)wait * APP_TIMER_CLOCK_FREQ) / SHOWCLOCK_SHOW_HZ : 0;
+  if (ticks < APP_TIMER_MIN_TIMEOUT_TICKS) {
+    ticks = APP_TIMER_MIN_TIMEOUT_TICKS;
+  }
+  app_timer_start(cue_timer_id, ticks, NULL);
+}
+
+/* apply every cue that is due, the timer is armed again if the show clock moved and the next
+   one isn't due yet */
+static void cue_timer_handler(void* p_context) {
+  const cue_t* cue;
+  uint32_t now;
+  if (!ant_show_ticks(&now)) {
+    return;
+  }
+  while ((cue = cue_peek(&cues)) != NULL && (int32_t)(cue->time - now) <= 0) {
+    ant_data_handler(cue->control, cue->red, cue->green, cue->blue);
+    cue_pop(&cues);
+  }
+  cue_arm();
+}
+
+/* clap in the pulse mode. Once the tempo locks the pulse is sent by beat_timer ahead of the next
+   beat to hide the detection latency, claps only pulse themselves if the prediction missed */
+static void clap_pulse(uint32_t time_ms) {
+  uint32_t since_beat_ms;
+  uint16_t period_ms;
+  tempo_onset(&tempo, time_ms);
+  period_ms = tempo_period_ms(&tempo);
+  if (period_ms == 0) {
+    ws2812_detect_motion();
+    return;
+  }
+  since_beat_ms = app_timer_cnt_diff_compute(app_timer_cnt_get(), beat_ticks);
+  since_beat_ms = (uint32_t)(((uint64_t)since_beat_ms * 1000) / APP_TIMER_CLOCK_FREQ);
+  if (free_beats == 0 || since_beat_ms > period_ms / 4) {
+    ws2812_detect_motion();
+  }
+  free_beats = 0;
+  app_timer_stop(beat_timer_id);
+  app_timer_start(beat_timer_id, APP_TIMER_TICKS(period_ms - TEMPO_LEAD_MS), NULL);
+}
+
+static void clap_detected(uint32_t time_ms) {
+  if (ws2812_get_mode() == WS2812_CLAP_PULSE) {
+    clap_pulse(time_ms);
+  } else {
+    ws2812_detect_motion();
+  }
 }
 
-static void cooldown_timer_handler(void* p_context) {
-  cooldown = false;
+/* log how often the CPU woke up and the LEDs ticked in each mode, and the accelerometer ISR time */
+static void stats_timer_handler(void* p_context) {
+  color_gen_mode_e m;
+  uint32_t ticks;
+  for (m = 0; m < WS2812_NUM_MODES; m++) {
+    ticks = ws2812_take_tick_count(m);
+    if (mode_wakeups[m] || ticks) {
+      NRF_LOG_INFO("mode %d: %d wakeups/min, %d led ticks/min", m, mode_wakeups[m], ticks);
+    }
+    mode_wakeups[m] = 0;
+  }
+  NRF_LOG_INFO("accelerometer max isr time: %d cycles", mma865_take_max_isr_cycles());
 }
 
 /* check battery voltage, goto inactive mode if necessary */
@@ -182,8 +370,9 @@ static void button_handler(nrf_drv_gpiote_pin_t pin, nrf_gpiote_polarity_t actio
     case SHUTDOWN:
       /* ignore everything */
       break;
+    case IDLE:
     case INACTIVE:
-      state = BUTTONS;
+      switch_state(BUTTONS);
     case BUTTONS:
       if (down) {
         longpress = true;
@@ -223,10 +412,25 @@ static void button_handler(nrf_drv_gpiote_pin_t pin, nrf_gpiote_polarity_t actio
   }
 }
 
+/* LED current budget for a battery reading, less current as the battery drains so the show
+   runs longer instead of ending at the shutdown voltage */
+static uint16_t led_power_budget(nrf_saadc_value_t sample) {
+  if (sample <= MIN_BATTERY_VOLTAGE) {
+    return LED_BUDGET_EMPTY_MA;
+  }
+  if (sample >= MAX_BATTERY_VOLTAGE) {
+    return LED_BUDGET_FULL_MA;
+  }
+  return LED_BUDGET_EMPTY_MA + ((LED_BUDGET_FULL_MA - LED_BUDGET_EMPTY_MA) *
+                                (sample - MIN_BATTERY_VOLTAGE)) /
+                                   (MAX_BATTERY_VOLTAGE - MIN_BATTERY_VOLTAGE);
+}
+
 /* check battery voltage, switch to shutdown mode if necessary */
 void check_battery(void) {
   ret_code_t ret_code;
   nrf_saadc_value_t sample;
+  uint32_t frames_encoded, frames_skipped;
   static char battery;
   /* already in progress of shutting down */
   if (state == SHUTDOWN) {
@@ -240,10 +444,14 @@ void check_battery(void) {
                    ((float)MAX_BATTERY_VOLTAGE - (float)MIN_BATTERY_VOLTAGE));
   NRF_LOG_INFO("battery: %d", battery);
   ble_send(&battery, 1);
+  ws2812_get_frame_stats(&frames_encoded, &frames_skipped);
+  NRF_LOG_INFO("led frames encoded: %d skipped: %d", frames_encoded, frames_skipped);
+  ws2812_set_power_budget(led_power_budget(sample));
+  NRF_LOG_INFO("led current: %duA", ws2812_get_current_ua());
 
   if (sample < MIN_BATTERY_VOLTAGE) {
     state = SHUTDOWN;
-    ws2812_set_all_rgb(3, 0, 0);
+    ws2812_set_all_rgb(INDICATOR_LOW, 0, 0);
     ws2812_on();
     app_timer_start(shutdown_timer_id, APP_TIMER_TICKS(5000), NULL);
   }
@@ -259,25 +467,7 @@ void ble_data_handler(uint8_t control, uint8_t red, uint8_t green, uint8_t blue)
   }
   NRF_LOG_INFO("%d, %d, %d", red, green, blue);
   ws2812_set_all_rgb(red, green, blue);
-
-  switch (control) {
-    case 0:
-      mma865_standby();
-      ws2812_set_mode(WS2812_STATIC);
-      break;
-    case 1:
-      mma865_standby();
-      ws2812_set_mode(WS2812_PULSE);
-      break;
-    case 2:
-      mma865_standby();
-      ws2812_set_mode(WS2812_BLINK);
-      break;
-    case 3:
-      mma865_active();
-      ws2812_set_mode(WS2812_CLAP_PULSE);
-      break;
-  }
+  set_control_mode(control);
 }
 
 static uint8_t lastcontrol, lastred, lastgreen, lastblue;
@@ -291,42 +481,36 @@ void ant_data_handler(uint8_t control, uint8_t red, uint8_t green, uint8_t blue)
     lastblue = blue;
     lastcontrol = control;
 
-    switch (control) {
-      case 0:
-        mma865_standby();
-        ws2812_set_mode(WS2812_STATIC);
-        break;
-      case 1:
-        mma865_standby();
-        ws2812_set_mode(WS2812_PULSE);
-        break;
-      case 2:
-        mma865_standby();
-        ws2812_set_mode(WS2812_BLINK);
-        break;
-      case 3:
-        mma865_active();
-        ws2812_set_mode(WS2812_CLAP_PULSE); /* TODO motion clap mode */
-        break;
-        /* TODO ble advertising not actually working */
-    }
+    /* TODO ble advertising not actually working */
+    set_control_mode(control);
     ws2812_set_all_rgb(red, green, blue);
   }
   NRF_LOG_INFO("%d, %d, %d, %d", control, red, green, blue);
 }
 
+/* cue for our group, applied at its show time rather than now. Repeats of a cue are dropped */
+void ant_cue_handler(uint32_t show_time, uint8_t control, uint8_t red, uint8_t green,
+                     uint8_t blue) {
+  cue_t cue = {show_time, control, red, green, blue};
+  if (!cue_push(&cues, &cue)) {
+    NRF_LOG_INFO("cue dropped, %d waiting", MAX_CUES);
+    return;
+  }
+  cue_arm();
+}
+
 void ant_disconnect_handler(void) {
   if (state == ANT) {
     switch_state(INACTIVE);
   }
-  ws2812_set_all_rgb(0, 0, 10);
+  ws2812_set_all_rgb(0, 0, INDICATOR_DIM);
 }
 
 void ble_connect_handler(void) {
   if (state == ADVERTISING) {
     switch_state(BLE);
   }
-  ws2812_set_all_rgb(10, 0, 10);
+  ws2812_set_all_rgb(INDICATOR_DIM, 0, INDICATOR_DIM);
   ws2812_set_mode(WS2812_STATIC);
 }
 
@@ -336,28 +520,69 @@ void ble_disconnect_handler(void) {
   }
 }
 
-void acc_data_handler(int16_t a_x, int16_t a_y, int16_t a_z, int16_t jerk_x, int16_t jerk_y,
-                      int16_t jerk_z) {
-  /* taking actual magnitude of 3D vector too slow to do in an ISR like this, 
-      approximate by checking max of individual dimensions*/
-  if ((button_mode == BTN_CLAP_TOGGLE) || (button_mode == BTN_CLAP_PULSE) || (state == BLE)) {
-    if (!cooldown && (jerk_x > 10000 || jerk_y > 10000 || jerk_z > 10000)) {
+void acc_data_handler(uint32_t time_ms, int16_t a_x, int16_t a_y, int16_t a_z,
+                      uint32_t jerk_sq) {
+  /* by the LED mode rather than the button mode, BLE and ANT choose modes too */
+  color_gen_mode_e mode = ws2812_get_mode();
+
+#if TRACE_RECORD
+  trace_record(&trace, time_ms, a_x, a_y, a_z);
+#endif
+  if (mode == WS2812_CLAP_TOGGLE || mode == WS2812_CLAP_PULSE) {
+    if (motion_detect(&clap_detector, time_ms, jerk_sq)) {
       // NRF_LOG_INFO("threshold passed");
-      ws2812_movement_flag = true;
-      cooldown = true;
-      app_timer_start(cooldown_timer_id, APP_TIMER_TICKS(COOLDOWN_MS), NULL);
+      clap_detected(time_ms);
     }
-  } else if (button_mode == BTN_WAVE_RAINBOW) {
-    if ((jerk_x > 1000 || jerk_y > 1000 || jerk_z > 1000)) {
+  } else if (mode == WS2812_WAVE_RAINBOW) {
+    if (motion_detect(&wave_detector, time_ms, jerk_sq)) {
       // NRF_LOG_INFO("threshold passed");
-      ws2812_movement_flag = true;
+      ws2812_detect_motion();
     }
+  } else if (mode == WS2812_TILT) {
+    /* absolute acceleration is the direction of gravity, picked up at the next LED tick */
+    tilt_update(&tilt, a_x, a_y, a_z);
+    ws2812_set_inputs(tilt_roll(&tilt), tilt_pitch(&tilt));
+  }
+}
+
+/* clap or wake motion detected by the accelerometer itself, while detection is offloaded to it */
+void acc_detect_handler(uint32_t time_ms) {
+  if (state == INACTIVE) {
+    app_timer_stop(idle_timer_id);
+    app_timer_start(idle_timer_id, APP_TIMER_TICKS(IDLE_STILL_MS), NULL);
+    return;
+  } else if (state == IDLE) {
+    NRF_LOG_INFO("motion, leaving idle");
+    switch_state(INACTIVE);
+    return;
+  }
+  if (motion_event(&clap_detector, time_ms)) {
+    clap_detected(time_ms);
   }
 }
 
+#if TRACE_RECORD
+/* log the trace a line at a time once it is full, called from the main loop */
+static void trace_dump(void) {
+  uint16_t n;
+  if (!trace_full(&trace) || trace_dumped >= trace.length) {
+    return;
+  }
+  n = trace.length - trace_dumped;
+  if (n > TRACE_DUMP_BYTES) {
+    n = TRACE_DUMP_BYTES;
+  }
+  NRF_LOG_HEXDUMP_INFO(&trace.buffer[trace_dumped], n);
+  trace_dumped += n;
+}
+#endif
+
 void set_group(uint8_t g) {
   group = g;
+  /* cues waiting were for the old group */
+  cue_reset(&cues);
   if (initialized) {
+    app_timer_stop(cue_timer_id);
     ant_set_group(g);
   }
 }
@@ -369,19 +594,25 @@ static void timers_init(void) {
   ret_code_t ret_code;
   ret_code = app_timer_init();
   APP_ERROR_CHECK(ret_code);
-  ret_code = app_timer_create(&led_timer_id, APP_TIMER_MODE_REPEATED, led_timer_handler);
+  ret_code = app_timer_create(&led_timer_id, APP_TIMER_MODE_SINGLE_SHOT, led_timer_handler);
   APP_ERROR_CHECK(ret_code);
   ret_code =
       app_timer_create(&longpress_timer_id, APP_TIMER_MODE_SINGLE_SHOT, longpress_timer_handler);
   APP_ERROR_CHECK(ret_code);
-  app_timer_create(&cooldown_timer_id, APP_TIMER_MODE_SINGLE_SHOT, cooldown_timer_handler);
-  APP_ERROR_CHECK(ret_code);
   app_timer_create(&battery_timer_id, APP_TIMER_MODE_REPEATED, battery_timer_handler);
   APP_ERROR_CHECK(ret_code);
   app_timer_create(&shutdown_timer_id, APP_TIMER_MODE_SINGLE_SHOT, shutdown_timer_handler);
   APP_ERROR_CHECK(ret_code);
+  ret_code = app_timer_create(&stats_timer_id, APP_TIMER_MODE_REPEATED, stats_timer_handler);
+  APP_ERROR_CHECK(ret_code);
   app_timer_create(&advertising_timer_id, APP_TIMER_MODE_SINGLE_SHOT, advertising_timer_handler);
   APP_ERROR_CHECK(ret_code);
+  ret_code = app_timer_create(&beat_timer_id, APP_TIMER_MODE_SINGLE_SHOT, beat_timer_handler);
+  APP_ERROR_CHECK(ret_code);
+  ret_code = app_timer_create(&idle_timer_id, APP_TIMER_MODE_SINGLE_SHOT, idle_timer_handler);
+  APP_ERROR_CHECK(ret_code);
+  ret_code = app_timer_create(&cue_timer_id, APP_TIMER_MODE_SINGLE_SHOT, cue_timer_handler);
+  APP_ERROR_CHECK(ret_code);
 }
 
 /* initialize softdevice for BLE and ANT */
@@ -473,7 +704,7 @@ int main(void) {
 
   /* initialize peripherals */
   ws2812_init();
-  ws2812_set_all_rgb(0, 0, 10);
+  ws2812_set_all_rgb(0, 0, INDICATOR_DIM);
 
   gpio_init();
   timers_init();
@@ -486,15 +717,27 @@ int main(void) {
   ant_rx_broadcast_setup(group);
 
   mma865_init();
-
-  app_timer_start(battery_timer_id, APP_TIMER_TICKS(30000), NULL);
-  app_timer_start(led_timer_id, APP_TIMER_TICKS(25), NULL);
+#if TRACE_RECORD
+  trace_begin(&trace, trace_buffer, sizeof(trace_buffer), MMA865_SAMPLE_PERIOD_MS,
+              MMA865_FAST_READ ? TRACE_FLAG_FAST_READ : 0);
+#endif
+
+  app_timer_start(battery_timer_id, APP_TIMER_TICKS(BATTERY_INTERVAL_MS), NULL);
+  app_timer_start(stats_timer_id, APP_TIMER_TICKS(STATS_INTERVAL_MS), NULL);
+  app_timer_start(led_timer_id, APP_TIMER_TICKS(WS2812_TICK_MS), NULL);
+  /* wait for motion, idles if the bracelet stays still */
+  switch_state(INACTIVE);
   check_battery();
   initialized = true;
   for (;;) {
     nrf_ble_lesc_request_handler();
+    mma865_process();
+#if TRACE_RECORD
+    trace_dump();
+#endif
     if (NRF_LOG_PROCESS() == false) {
       nrf_pwr_mgmt_run();
+      mode_wakeups[ws2812_get_mode()]++;
     }
   }
 }
\ No newline at end of file
@@ -7,24 +7,71 @@
 #define ACC_INT1 3
 #define LONGPRESS_MS 3000
 #define COOLDOWN_MS 50
+/* jerk magnitude thresholds in 10 bit sample counts, compared squared */
+#define CLAP_JERK_THRESHOLD 156 /* 10000 in the old left justified per axis jerk */
+#define WAVE_JERK_THRESHOLD 16  /* 1000 in the old left justified per axis jerk */
+/* 1 to have the accelerometer detect claps itself in the clap modes instead of streaming samples,
+   MMA865_DETECT_THS sets the threshold. Only on the MMA8652, the MMA8653 always streams */
+#define ACC_OFFLOAD_CLAPS 1
+/* 1 to record accelerometer samples from boot and log the trace as hex once the buffer fills */
+#define TRACE_RECORD 0
+#define TRACE_BUFFER_BYTES 2048 /* about 8s of samples at 50Hz */
+#define TRACE_DUMP_BYTES 16     /* bytes per log line */
 #define SAMPLES_IN_BUFFER 5
+#define LED_WAKE_MS 1           /* delay of the LED tick when something changes */
+#define STATS_INTERVAL_MS 60000 /* wakeup counts are logged per minute */
+/* clap pulse beat prediction, see tempo.h */
+#define TEMPO_LEAD_MS 40   /* clap detection latency, predicted pulses are sent this much early */
+#define TEMPO_FREE_BEATS 8 /* predicted pulses kept going after the claps stop */
+/* INACTIVE goes to IDLE after this long without motion or a button press */
+#define IDLE_STILL_MS 300000
+#define BATTERY_INTERVAL_MS 30000
 
 #define MIN_BATTERY_VOLTAGE 723 /* 3.50V */
 #define MAX_BATTERY_VOLTAGE 860 /* 4.15V */
+/* LED current budget, tightens linearly from full battery to empty */
+#define LED_BUDGET_FULL_MA 120
+#define LED_BUDGET_EMPTY_MA 20
+/* indicator levels, output is gamma corrected so these come out at the 10 and 3 of 255 the
+   indicators used to have */
+#define INDICATOR_DIM 56
+#define INDICATOR_LOW 28
 
 void ant_data_handler(uint8_t control, uint8_t red, uint8_t green, uint8_t blue);
+void ant_cue_handler(uint32_t show_time, uint8_t control, uint8_t red, uint8_t green,
+                     uint8_t blue);
 void ant_disconnect_handler(void);
 void ble_data_handler(uint8_t control, uint8_t red, uint8_t green, uint8_t blue);
 void ble_connect_handler(void);
 void ble_disconnect_handler(void);
 
-void acc_data_handler(int16_t a_x, int16_t a_y, int16_t a_z, int16_t jerk_x, int16_t jerk_y,
-                      int16_t jerk_z);
+void acc_data_handler(uint32_t time_ms, int16_t a_x, int16_t a_y, int16_t a_z,
+                      uint32_t jerk_sq);
+void acc_detect_handler(uint32_t time_ms);
 void check_battery(void);
+void led_wake_handler(void);
 
+/*
+Estimated average current in each state, from the datasheets rather than measured:
+  state        LEDs                   radio                    accelerometer   total
+  SHUTDOWN     off                    off                      standby  2uA    ~5uA
+  INACTIVE     dim blue       ~3.2mA  ANT search      ~6mA     6.25Hz   6uA    ~9mA
+  IDLE         off                    off                      6.25Hz   6uA    ~10uA
+  BUTTONS      mode, budget  2-120mA  ANT search      ~6mA     50Hz    30uA    8-126mA
+  ADVERTISING  pulsing blue  2-40mA   ANT search + advertising ~6.3mA          8-46mA
+  BLE          mode, budget  2-120mA  ANT search + connection  ~6.1mA          8-126mA
+  ANT          mode, budget  2-120mA  ANT tracking at 32Hz ~0.2mA              2-120mA
+The LEDs draw 600uA each even when dark so they are only powered off in IDLE and SHUTDOWN,
+the nRF itself sleeps at ~3uA between events in every state. The dim blue of INACTIVE is a
+static color, rounded to an output step rather than dithered, so the LED tick and the PWM stop
+once it is shown.
+IDLE stops the LED tick and the PWM as well as the LED power, only the RTC and the
+accelerometer run.
+*/
 typedef enum control_state {
   SHUTDOWN,
   INACTIVE,
+  IDLE, /* still for IDLE_STILL_MS, LEDs and radio off until motion or a button press */
   BUTTONS,
   ADVERTISING,
   BLE,
@@ -41,6 +88,7 @@ typedef enum button_mode {
   BTN_CLAP_TOGGLE,
   BTN_CLAP_PULSE,
   BTN_WAVE_RAINBOW,
+  BTN_TILT,
   BTN_NUM_MODES
 } button_mode_e;
 
@@ -1,7 +1,10 @@
 /* Copyright (c) 2023  Hunter Whyte */
+#include <stdbool.h>
 #include <stdint.h>
 
 #include "app_error.h"
+#include "app_timer.h"
+#include "app_util_platform.h"
 #include "nrf_log.h"
 #include "nrf_sdh_ant.h"
 
@@ -13,30 +16,60 @@
 #include "bracelet.h"
 #include "bracelet_ant.h"
 #include "common.h"
+#include "showclock.h"
+#include "wire.h"
 
 static uint8_t open_group;
+static bool closed = false;  /* channel closed to save power */
+static bool closing = false; /* close requested, waiting for EVENT_CHANNEL_CLOSED */
+static showclock_t show_clock;
+static wire_parity_t parity; /* change messages kept to rebuild a missed one */
+/* app_timer counter extended past its 24 bits, read at least every 1024s while it matters */
+static uint32_t local_ticks;
+static uint32_t local_counter;
+
+static uint32_t local_time(void) {
+  uint32_t counter, now;
+  CRITICAL_REGION_ENTER();
+  counter = app_timer_cnt_get();
+  local_ticks += app_timer_cnt_diff_compute(counter, local_counter);
+  local_counter = counter;
+  now = local_ticks;
+  CRITICAL_REGION_EXIT();
+  return now;
+}
 
 /* ######################### EVENT HANDLERS ######################### */
 void ant_evt_handler(ant_evt_t* p_ant_evt, void* p_context) {
-  uint8_t index;
-  union payload message_payload;
-  uint32_t data;
+  group_data_t data;
+  uint32_t show_time, now;
+  uint8_t* payload;
+  ret_code_t ret_code;
   switch (p_ant_evt->event) {
     case EVENT_RX:
-      /* parse data from received message */
-      index = GROUP_TO_INDEX(open_group);
-      for (int i = 0; i < ANT_STANDARD_DATA_PAYLOAD_SIZE; i++) {
-        message_payload.values[i] = p_ant_evt->message.ANT_MESSAGE_aucPayload[i];
+      /* a message from the channel that was open before a group change */
+      if (p_ant_evt->channel != GROUP_TO_CHANNEL(open_group)) {
+        break;
+      }
+      payload = p_ant_evt->message.ANT_MESSAGE_aucPayload;
+      /* every message keeps the show clock, whichever page it carries */
+      if (wire_decode_time(payload, &show_time)) {
+        showclock_time(&show_clock, local_time(), WIRE_SEQ(payload), show_time);
+      } else {
+        showclock_message(&show_clock, local_time(), WIRE_SEQ(payload));
+      }
+      /* only the page with our group is decoded, the rest of the rotation is dropped */
+      if (wire_decode_group(payload, open_group, &data)) {
+        ant_data_handler(data.control, (data.red << 3), (data.green << 2), (data.blue << 3));
+      } else if (ant_show_ticks(&now) &&
+                 wire_decode_cue(payload, open_group, now, &data, &show_time)) {
+        ant_cue_handler(show_time, data.control, (data.red << 3), (data.green << 2),
+                        (data.blue << 3));
+      } else if (wire_parity_recover(&parity, payload, open_group, &data)) {
+        NRF_LOG_INFO("ant: missed change rebuilt from parity");
+        ant_data_handler(data.control, (data.red << 3), (data.green << 2), (data.blue << 3));
       }
-      if (index == 0)
-        data = GROUP_A_DATA(message_payload.combined);
-      else if (index == 1)
-        data = GROUP_B_DATA(message_payload.combined);
-      else
-        data = GROUP_C_DATA(message_payload.combined);
-
-      ant_data_handler(GROUP_CONTROL(data), (GROUP_RED(data) << 3), (GROUP_GREEN(data) << 2),
-                       (GROUP_BLUE(data) << 3));
+      wire_parity_add(&parity, payload);
       break;
     case EVENT_RX_FAIL:
       NRF_LOG_INFO("ant: rx fail event");
@@ -50,6 +83,14 @@ void ant_evt_handler(ant_evt_t* p_ant_evt, void* p_context) {
       break;
     case EVENT_CHANNEL_CLOSED:
       NRF_LOG_INFO("ant: channel closed event");
+      if (closing) {
+        closing = false;
+        /* opened again while the close was still going */
+        if (!closed) {
+          ret_code = sd_ant_channel_open(GROUP_TO_CHANNEL(open_group));
+          APP_ERROR_CHECK(ret_code);
+        }
+      }
       break;
     default:
       break;
@@ -70,9 +111,13 @@ void ant_set_group(uint8_t group) {
   new_channel = GROUP_TO_CHANNEL(group);
 
   NRF_LOG_INFO("old group %d new group %d", open_group, group);
+  open_group = group;
 
   if (old_channel != new_channel) {
     NRF_LOG_INFO("old channel %d new channel %d", old_channel, new_channel);
+    /* sequence numbers are per channel */
+    wire_parity_reset(&parity);
+    showclock_unanchor(&show_clock);
     ret_code = sd_ant_channel_close(old_channel);
     NRF_LOG_INFO("sd_ant_channel_close %d", ret_code);
     APP_ERROR_CHECK(ret_code);
@@ -81,12 +126,60 @@ void ant_set_group(uint8_t group) {
     NRF_LOG_INFO("sd_ant_channel_open %d", ret_code);
     APP_ERROR_CHECK(ret_code);
   }
-  open_group = group;
+}
+
+/* stop searching for the controller, the channel can't receive until ant_rx_open() */
+void ant_rx_close(void) {
+  ret_code_t ret_code;
+  if (closed) {
+    return;
+  }
+  closed = true;
+  if (!closing) {
+    ret_code = sd_ant_channel_close(GROUP_TO_CHANNEL(open_group));
+    APP_ERROR_CHECK(ret_code);
+    closing = true;
+  }
+}
+
+void ant_rx_open(void) {
+  ret_code_t ret_code;
+  if (!closed) {
+    return;
+  }
+  closed = false;
+  /* the close hasn't finished, the channel is opened again on EVENT_CHANNEL_CLOSED */
+  if (closing) {
+    return;
+  }
+  ret_code = sd_ant_channel_open(GROUP_TO_CHANNEL(open_group));
+  APP_ERROR_CHECK(ret_code);
+}
+
+/* controller's show time in 1/32768s, false until a time message has been received */
+bool ant_show_ticks(uint32_t* show_time) {
+  if (!showclock_locked(&show_clock)) {
+    return false;
+  }
+  *show_time = showclock_now(&show_clock, local_time());
+  return true;
+}
+
+/* controller's show time in ms, false until a time message has been received */
+bool ant_show_time(uint32_t* time_ms) {
+  uint32_t show_time;
+  if (!ant_show_ticks(&show_time)) {
+    return false;
+  }
+  *time_ms = ((uint64_t)show_time * 1000) / SHOWCLOCK_SHOW_HZ;
+  return true;
 }
 
 /* ######################### INITIALIZATION ######################### */
 void ant_rx_broadcast_setup(uint8_t group) {
   ret_code_t ret_code;
+  showclock_reset(&show_clock);
+  local_counter = app_timer_cnt_get();
   for (int i = 0; i < NUM_CHANNELS; i++) {
     ant_channel_config_t broadcast_channel_config = {
         .channel_number = i,
@@ -5,5 +5,9 @@
 void ant_evt_handler(ant_evt_t* p_ant_evt, void* p_context);
 void ant_rx_broadcast_setup(uint8_t group);
 void ant_set_group(uint8_t group);
+void ant_rx_close(void);
+void ant_rx_open(void);
+bool ant_show_ticks(uint32_t* show_time);
+bool ant_show_time(uint32_t* time_ms);
 
 #endif  /* BRACELET_ANT_H */
\ No newline at end of file
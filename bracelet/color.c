@@ -0,0 +1,139 @@
+/* Copyright (c) 2023  Hunter Whyte */
+/* integer only color conversion, everything here runs every LED tick so no divides or floats */
+#include <stdint.h>
+
+#include "color.h"
+
+/* hue regions are 43 wide, h / 43 == (h * 191) >> 13 for all h in 0-255 */
+#define HUE_REGION(h) (((h) * 191) >> 13)
+
+/* ceil(2^24 / d), n / d == (n * recip_lut[d]) >> 24 exactly for every n <= 255 * 255 */
+static const uint32_t recip_lut[256] = {
+    0x0, 0x1000000, 0x800000, 0x555556, 0x400000, 0x333334, 0x2aaaab, 0x24924a,
+    0x200000, 0x1c71c8, 0x19999a, 0x1745d2, 0x155556, 0x13b13c, 0x124925, 0x111112,
+    0x100000, 0xf0f10, 0xe38e4, 0xd7944, 0xccccd, 0xc30c4, 0xba2e9, 0xb2165,
+    0xaaaab, 0xa3d71, 0x9d89e, 0x97b43, 0x92493, 0x8d3dd, 0x88889, 0x84211,
+    0x80000, 0x7c1f1, 0x78788, 0x75076, 0x71c72, 0x6eb3f, 0x6bca2, 0x6906a,
+    0x66667, 0x63e71, 0x61862, 0x5f418, 0x5d175, 0x5b05c, 0x590b3, 0x57263,
+    0x55556, 0x53979, 0x51eb9, 0x50506, 0x4ec4f, 0x4d488, 0x4bda2, 0x4a791,
+    0x4924a, 0x47dc2, 0x469ef, 0x456c8, 0x44445, 0x4325d, 0x42109, 0x41042,
+    0x40000, 0x3f040, 0x3e0f9, 0x3d227, 0x3c3c4, 0x3b5cd, 0x3a83b, 0x39b0b,
+    0x38e39, 0x381c1, 0x375a0, 0x369d1, 0x35e51, 0x3531e, 0x34835, 0x33d92,
+    0x33334, 0x32917, 0x31f39, 0x31598, 0x30c31, 0x30304, 0x2fa0c, 0x2f14a,
+    0x2e8bb, 0x2e05d, 0x2d82e, 0x2d02e, 0x2c85a, 0x2c0b1, 0x2b932, 0x2b1db,
+    0x2aaab, 0x2a3a1, 0x29cbd, 0x295fb, 0x28f5d, 0x288e0, 0x28283, 0x27c46,
+    0x27628, 0x27028, 0x26a44, 0x2647d, 0x25ed1, 0x25940, 0x253c9, 0x24e6b,
+    0x24925, 0x243f7, 0x23ee1, 0x239e1, 0x234f8, 0x23024, 0x22b64, 0x226ba,
+    0x22223, 0x21d9f, 0x2192f, 0x214d1, 0x21085, 0x20c4a, 0x20821, 0x20409,
+    0x20000, 0x1fc08, 0x1f820, 0x1f447, 0x1f07d, 0x1ecc1, 0x1e914, 0x1e574,
+    0x1e1e2, 0x1de5e, 0x1dae7, 0x1d77c, 0x1d41e, 0x1d0cc, 0x1cd86, 0x1ca4c,
+    0x1c71d, 0x1c3f9, 0x1c0e1, 0x1bdd3, 0x1bad0, 0x1b7d7, 0x1b4e9, 0x1b204,
+    0x1af29, 0x1ac58, 0x1a98f, 0x1a6d1, 0x1a41b, 0x1a16e, 0x19ec9, 0x19c2e,
+    0x1999a, 0x1970f, 0x1948c, 0x19210, 0x18f9d, 0x18d31, 0x18acc, 0x1886f,
+    0x18619, 0x183ca, 0x18182, 0x17f41, 0x17d06, 0x17ad3, 0x178a5, 0x1767e,
+    0x1745e, 0x17243, 0x1702f, 0x16e20, 0x16c17, 0x16a14, 0x16817, 0x1661f,
+    0x1642d, 0x16240, 0x16059, 0x15e76, 0x15c99, 0x15ac1, 0x158ee, 0x1571f,
+    0x15556, 0x15391, 0x151d1, 0x15016, 0x14e5f, 0x14cac, 0x14afe, 0x14954,
+    0x147af, 0x1460d, 0x14470, 0x142d7, 0x14142, 0x13fb1, 0x13e23, 0x13c9a,
+    0x13b14, 0x13992, 0x13814, 0x13699, 0x13522, 0x133af, 0x1323f, 0x130d2,
+    0x12f69, 0x12e03, 0x12ca0, 0x12b41, 0x129e5, 0x1288c, 0x12736, 0x125e3,
+    0x12493, 0x12346, 0x121fc, 0x120b5, 0x11f71, 0x11e2f, 0x11cf1, 0x11bb5,
+    0x11a7c, 0x11946, 0x11812, 0x116e1, 0x115b2, 0x11486, 0x1135d, 0x11236,
+    0x11112, 0x10ff0, 0x10ed0, 0x10db3, 0x10c98, 0x10b7f, 0x10a69, 0x10954,
+    0x10843, 0x10733, 0x10625, 0x1051a, 0x10411, 0x1030a, 0x10205, 0x10102,};
+
+/* which of v, p, q, t each of red, green, blue gets in each hue region */
+enum { PART_V, PART_P, PART_Q, PART_T };
+static const uint8_t region_parts[6][3] = {
+    {PART_V, PART_T, PART_P}, {PART_Q, PART_V, PART_P}, {PART_P, PART_V, PART_T},
+    {PART_P, PART_Q, PART_V}, {PART_T, PART_P, PART_V}, {PART_V, PART_P, PART_Q},
+};
+
+/* n / d for n <= 255 * 255 and 0 < d <= 255 */
+static inline uint32_t div_u8(uint32_t n, uint8_t d) {
+  return (uint32_t)(((uint64_t)n * recip_lut[d]) >> 24);
+}
+
+/* converts [hue, saturation, value] color to [red, green, blue] */
+/* algorithm from: https://stackoverflow.com/a/14733008 */
+rgb_color_t hsv_to_rgb(hsv_color_t hsv) {
+  rgb_color_t rgb;
+  uint8_t parts[4];
+  uint8_t region, remainder, h, s, v;
+  const uint8_t* map;
+  h = hsv.hue;
+  s = hsv.saturation;
+  v = hsv.value;
+
+  if (s == 0) {
+    rgb.red = v;
+    rgb.green = v;
+    rgb.blue = v;
+    return rgb;
+  }
+
+  region = HUE_REGION(h);
+  remainder = (h - (region * 43)) * 6;
+
+  parts[PART_V] = v;
+  parts[PART_P] = (v * (255 - s)) >> 8;
+  parts[PART_Q] = (v * (255 - ((s * remainder) >> 8))) >> 8;
+  parts[PART_T] = (v * (255 - ((s * (255 - remainder)) >> 8))) >> 8;
+
+  map = region_parts[region];
+  rgb.red = parts[map[0]];
+  rgb.green = parts[map[1]];
+  rgb.blue = parts[map[2]];
+
+  return rgb;
+}
+
+/* converts [red, green, blue] color to [hue, saturation, value] */
+/* algorithm from: https://stackoverflow.com/a/14733008 */
+hsv_color_t rgb_to_hsv(rgb_color_t rgb) {
+  hsv_color_t hsv;
+  uint8_t min, max, delta, r, g, b, base;
+  int16_t diff;
+  uint8_t offset;
+
+  r = rgb.red;
+  g = rgb.green;
+  b = rgb.blue;
+
+  min = r < g ? (r < b ? r : b) : (g < b ? g : b);
+  max = r > g ? (r > b ? r : b) : (g > b ? g : b);
+  delta = max - min;
+
+  hsv.value = max;
+  if (max == 0 || delta == 0) {
+    hsv.hue = 0;
+    hsv.saturation = 0;
+    return hsv;
+  }
+  /* never 0 here since delta > 0 */
+  hsv.saturation = div_u8(255 * delta, max);
+
+  if (max == r) {
+    base = 0;
+    diff = g - b;
+  } else if (max == g) {
+    base = 85;
+    diff = b - r;
+  } else {
+    base = 171;
+    diff = r - g;
+  }
+  /* divide the magnitude so the result truncates toward zero like a signed divide */
+  offset = div_u8(43 * (diff < 0 ? -diff : diff), delta);
+  hsv.hue = diff < 0 ? base - offset : base + offset;
+
+  return hsv;
+}
+
+/* linear interpolation between a and b, t = 0 gives the smaller, t = 255 the larger */
+uint8_t lerp_8(uint8_t a, uint8_t b, uint8_t t) {
+  uint8_t low = a < b ? a : b;
+  uint8_t high = a < b ? b : a;
+  uint16_t x = (high - low) * t;
+  return low + DIV_255(x);
+}
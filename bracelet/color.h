@@ -0,0 +1,53 @@
+/* Copyright (c) 2023  Hunter Whyte */
+#ifndef COLOR_H
+#define COLOR_H
+
+#include <stdint.h>
+
+typedef struct rgb_color {
+  uint8_t red;
+  uint8_t green;
+  uint8_t blue;
+} rgb_color_t;
+
+typedef struct hsv_color {
+  uint8_t hue;
+  uint8_t saturation;
+  uint8_t value;
+} hsv_color_t;
+
+/* 8 bit color to 16 bit linear light, gamma 2.2. Any non-zero color is at least 256 (one
+   output step) so dim colors stay visible instead of being dithered in and out */
+static const uint16_t gamma_lut[256] = {
+    0x0, 0x100, 0x102, 0x104, 0x107, 0x10b, 0x111, 0x118, 0x120, 0x12a, 0x135, 0x141,
+    0x14e, 0x15e, 0x16e, 0x180, 0x194, 0x1a9, 0x1bf, 0x1d8, 0x1f1, 0x20d, 0x22a, 0x248,
+    0x268, 0x28a, 0x2ae, 0x2d3, 0x2fa, 0x323, 0x34d, 0x379, 0x3a7, 0x3d6, 0x408, 0x43b,
+    0x470, 0x4a6, 0x4df, 0x519, 0x555, 0x593, 0x5d3, 0x614, 0x658, 0x69d, 0x6e4, 0x72d,
+    0x778, 0x7c5, 0x814, 0x865, 0x8b7, 0x90c, 0x962, 0x9bb, 0xa15, 0xa71, 0xacf, 0xb30,
+    0xb92, 0xbf6, 0xc5c, 0xcc5, 0xd2f, 0xd9b, 0xe09, 0xe79, 0xeec, 0xf60, 0xfd6, 0x104f,
+    0x10c9, 0x1146, 0x11c4, 0x1245, 0x12c8, 0x134d, 0x13d3, 0x145c, 0x14e7, 0x1575, 0x1604, 0x1695,
+    0x1729, 0x17be, 0x1856, 0x18f0, 0x198c, 0x1a2a, 0x1acb, 0x1b6d, 0x1c12, 0x1cb9, 0x1d62, 0x1e0d,
+    0x1eba, 0x1f69, 0x201b, 0x20cf, 0x2185, 0x223d, 0x22f8, 0x23b4, 0x2473, 0x2534, 0x25f8, 0x26bd,
+    0x2785, 0x284f, 0x291b, 0x29ea, 0x2aba, 0x2b8d, 0x2c62, 0x2d3a, 0x2e14, 0x2ef0, 0x2fce, 0x30ae,
+    0x3191, 0x3276, 0x335e, 0x3447, 0x3533, 0x3622, 0x3712, 0x3805, 0x38fa, 0x39f1, 0x3aeb, 0x3be7,
+    0x3ce6, 0x3de6, 0x3eea, 0x3fef, 0x40f7, 0x4201, 0x430d, 0x441c, 0x452d, 0x4640, 0x4756, 0x486e,
+    0x4989, 0x4aa6, 0x4bc5, 0x4ce6, 0x4e0a, 0x4f31, 0x505a, 0x5185, 0x52b2, 0x53e2, 0x5514, 0x5649,
+    0x5780, 0x58ba, 0x59f6, 0x5b34, 0x5c75, 0x5db8, 0x5efd, 0x6045, 0x6190, 0x62dc, 0x642c, 0x657d,
+    0x66d1, 0x6828, 0x6981, 0x6adc, 0x6c3a, 0x6d9b, 0x6efd, 0x7063, 0x71ca, 0x7335, 0x74a1, 0x7610,
+    0x7782, 0x78f6, 0x7a6c, 0x7be5, 0x7d61, 0x7edf, 0x805f, 0x81e2, 0x8368, 0x84ef, 0x867a, 0x8807,
+    0x8996, 0x8b28, 0x8cbc, 0x8e53, 0x8fed, 0x9189, 0x9327, 0x94c8, 0x966c, 0x9812, 0x99ba, 0x9b65,
+    0x9d13, 0x9ec3, 0xa076, 0xa22b, 0xa3e3, 0xa59d, 0xa75a, 0xa919, 0xaadb, 0xaca0, 0xae67, 0xb031,
+    0xb1fd, 0xb3cc, 0xb59d, 0xb771, 0xb947, 0xbb20, 0xbcfc, 0xbeda, 0xc0bb, 0xc29e, 0xc484, 0xc66d,
+    0xc858, 0xca46, 0xcc36, 0xce29, 0xd01e, 0xd216, 0xd411, 0xd60e, 0xd80e, 0xda11, 0xdc16, 0xde1e,
+    0xe028, 0xe235, 0xe445, 0xe657, 0xe86c, 0xea83, 0xec9d, 0xeeba, 0xf0d9, 0xf2fb, 0xf520, 0xf747,
+    0xf971, 0xfb9e, 0xfdcd, 0xffff,
+};
+
+/* divide by 255 without dividing, exact for 0 <= x < 65535 */
+#define DIV_255(x) (((x) + 1 + ((x) >> 8)) >> 8)
+
+rgb_color_t hsv_to_rgb(hsv_color_t hsv);
+hsv_color_t rgb_to_hsv(rgb_color_t rgb);
+uint8_t lerp_8(uint8_t a, uint8_t b, uint8_t t);
+
+#endif /* COLOR_H */
@@ -0,0 +1,55 @@
+/* Copyright (c) 2023  Hunter Whyte */
+/* time ordered ring of cues, see cue.h */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cue.h"
+
+#define SLOT(queue, i) (((queue)->head + (i)) % MAX_CUES)
+
+static bool cue_equal(const cue_t* a, const cue_t* b) {
+  return a->time == b->time && a->control == b->control && a->red == b->red &&
+         a->green == b->green && a->blue == b->blue;
+}
+
+void cue_reset(cue_queue_t* queue) {
+  queue->head = 0;
+  queue->count = 0;
+}
+
+/* add a cue in time order, after any due at the same time. False if the ring is full */
+bool cue_push(cue_queue_t* queue, const cue_t* cue) {
+  uint8_t i;
+
+  for (i = 0; i < queue->count; i++) {
+    if (cue_equal(&queue->cues[SLOT(queue, i)], cue)) {
+      return true;
+    }
+  }
+  if (queue->count >= MAX_CUES) {
+    return false;
+  }
+  /* shift later cues back a slot to make room */
+  for (i = queue->count; i > 0; i--) {
+    if ((int32_t)(queue->cues[SLOT(queue, i - 1)].time - cue->time) <= 0) {
+      break;
+    }
+    queue->cues[SLOT(queue, i)] = queue->cues[SLOT(queue, i - 1)];
+  }
+  queue->cues[SLOT(queue, i)] = *cue;
+  queue->count++;
+  return true;
+}
+
+/* cue due next, NULL if there are none */
+const cue_t* cue_peek(const cue_queue_t* queue) {
+  return queue->count ? &queue->cues[queue->head] : NULL;
+}
+
+void cue_pop(cue_queue_t* queue) {
+  if (queue->count) {
+    queue->head = (queue->head + 1) % MAX_CUES;
+    queue->count--;
+  }
+}
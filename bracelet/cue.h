@@ -0,0 +1,36 @@
+/* Copyright (c) 2023  Hunter Whyte */
+#ifndef CUE_H
+#define CUE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "common.h"
+
+/*
+Cues waiting for their show time, see wire.h. A fixed ring of MAX_CUES kept in time order so
+the next one due is always at the head. The controller holds no more than MAX_CUES per channel
+and a bracelet only takes the cues for its own group, so the ring can't overflow while the two
+agree. Each cue is received up to WIRE_CUE_REPEATS times, repeats are dropped.
+*/
+
+typedef struct cue {
+  uint32_t time; /* show time in 1/32768s */
+  uint8_t control;
+  uint8_t red;
+  uint8_t green;
+  uint8_t blue;
+} cue_t;
+
+typedef struct cue_queue {
+  cue_t cues[MAX_CUES];
+  uint8_t head;
+  uint8_t count;
+} cue_queue_t;
+
+void cue_reset(cue_queue_t* queue);
+bool cue_push(cue_queue_t* queue, const cue_t* cue);
+const cue_t* cue_peek(const cue_queue_t* queue);
+void cue_pop(cue_queue_t* queue);
+
+#endif /* CUE_H */
@@ -0,0 +1,154 @@
+/* Copyright (c) 2023  Hunter Whyte */
+/* interpreter for effect descriptions, evaluated for every LED every tick */
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "color.h"
+#include "effect.h"
+
+/* how far along a track is, 0 at start and 255 at end */
+static uint8_t wave_amount(uint8_t wave, uint8_t phase) {
+  switch (wave) {
+    case EFFECT_WAVE_RAMP:
+      return phase;
+    case EFFECT_WAVE_SINE:
+      return sine_lut[phase];
+    case EFFECT_WAVE_SQUARE:
+      return phase < 128 ? 0 : 255;
+    case EFFECT_WAVE_HOLD:
+    default:
+      return 0;
+  }
+}
+
+static uint8_t track_eval(const effect_track_t* track, uint8_t phase, uint8_t color,
+                          const effect_inputs_t* inputs) {
+  uint8_t amount;
+
+  if (track->source == EFFECT_SRC_ROLL) {
+    phase = inputs->roll;
+  } else if (track->source == EFFECT_SRC_PITCH) {
+    phase = inputs->pitch;
+  }
+  amount = wave_amount(track->wave, phase);
+
+  if (track->source == EFFECT_SRC_COLOR) {
+    /* offset from the LED's color, wraps around so hue can go all the way round */
+    return color + DIV_255(track->end * amount);
+  }
+  if (track->end < track->start) {
+    return track->start - DIV_255((track->start - track->end) * amount);
+  }
+  return track->start + DIV_255((track->end - track->start) * amount);
+}
+
+/* phase an effect starts at when it is selected, one shot effects start finished */
+uint8_t effect_start_phase(const effect_t* effect) {
+  return (effect->flags & EFFECT_ONESHOT) ? 255 : 0;
+}
+
+/* phase after the given number of ticks */
+uint8_t effect_advance(const effect_t* effect, uint8_t phase, uint8_t ticks) {
+  uint16_t step = effect->rate * ticks;
+  if ((effect->flags & EFFECT_ONESHOT) && (phase + step > 255)) {
+    return 255;
+  }
+  return phase + step;
+}
+
+/* phase of a wrapping effect that has been running for the given number of ticks, so effects
+   started from the same time line up */
+uint8_t effect_phase_at(const effect_t* effect, uint32_t ticks) {
+  return effect->rate * ticks;
+}
+
+/* phase after a motion event */
+uint8_t effect_trigger(const effect_t* effect, uint8_t phase) {
+  switch (effect->trigger) {
+    case EFFECT_TRIGGER_RESTART:
+      return 0;
+    case EFFECT_TRIGGER_STEP:
+      return phase + effect->step;
+    case EFFECT_TRIGGER_NONE:
+    default:
+      return phase;
+  }
+}
+
+/* color of an LED at the given phase, color is the color the LED was set to */
+hsv_color_t effect_eval(const effect_t* effect, uint8_t phase, hsv_color_t color,
+                        const effect_inputs_t* inputs) {
+  hsv_color_t hsv;
+  hsv.hue = track_eval(&effect->hue, phase, color.hue, inputs);
+  hsv.saturation = track_eval(&effect->saturation, phase, color.saturation, inputs);
+  hsv.value = track_eval(&effect->value, phase, color.value, inputs);
+  return hsv;
+}
+
+static bool track_is_color(const effect_track_t* track) {
+  return track->source == EFFECT_SRC_COLOR &&
+         (track->wave == EFFECT_WAVE_HOLD || track->end == 0);
+}
+
+/* true if the effect always shows the colors the LEDs were set to */
+bool effect_is_static(const effect_t* effect) {
+  return track_is_color(&effect->hue) && track_is_color(&effect->saturation) &&
+         track_is_color(&effect->value);
+}
+
+static bool track_is_input(const effect_track_t* track) {
+  return track->source == EFFECT_SRC_ROLL || track->source == EFFECT_SRC_PITCH;
+}
+
+/* true if the track changes with phase */
+static bool track_varies(const effect_track_t* track) {
+  if (track->wave == EFFECT_WAVE_HOLD || track_is_input(track)) {
+    return false;
+  }
+  if (track->source == EFFECT_SRC_COLOR) {
+    return track->end != 0;
+  }
+  return track->start != track->end;
+}
+
+/* ticks until the effect can look different, 0 if it won't change until it is triggered or an
+   input changes */
+uint8_t effect_ticks_to_change(const effect_t* effect, uint8_t phase) {
+  const effect_track_t* tracks[] = {&effect->hue, &effect->saturation, &effect->value};
+  uint16_t boundary;
+  bool varies = false;
+  uint8_t i;
+
+  if (effect_is_static(effect) || effect->rate == 0) {
+    return 0;
+  }
+  if ((effect->flags & EFFECT_ONESHOT) && phase == 255) {
+    return 0;
+  }
+  for (i = 0; i < 3; i++) {
+    if (!track_varies(tracks[i])) {
+      continue;
+    }
+    if (tracks[i]->wave != EFFECT_WAVE_SQUARE) {
+      return 1;
+    }
+    varies = true;
+  }
+  if (!varies) {
+    return 0;
+  }
+  /* square waves only change at the half and full period */
+  boundary = phase < 128 ? 128 : 256;
+  return (boundary - phase + effect->rate - 1) / effect->rate;
+}
+
+/* true if motion events change the effect, so the accelerometer is needed */
+bool effect_uses_motion(const effect_t* effect) {
+  return effect->trigger != EFFECT_TRIGGER_NONE;
+}
+
+/* true if any track follows an input, so the accelerometer is needed */
+bool effect_uses_inputs(const effect_t* effect) {
+  return track_is_input(&effect->hue) || track_is_input(&effect->saturation) ||
+         track_is_input(&effect->value);
+}
@@ -0,0 +1,105 @@
+/* Copyright (c) 2023  Hunter Whyte */
+#ifndef EFFECT_H
+#define EFFECT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "color.h"
+
+/*
+An effect describes a look as data instead of code. Each effect has a phase that
+runs 0-255 and wraps, advanced by rate every LED tick and optionally moved by
+motion events. Hue, saturation and value each have a track that maps the phase
+to a value, either between two constants or relative to the color the LED was
+set to. LEDs along the chain can be offset in phase from each other. A track can
+follow one of the effect inputs instead of the phase, so sensor readings shape
+the color continuously.
+*/
+
+/* how a track moves from its start to its end value as the phase goes 0-255 */
+typedef enum effect_wave {
+  EFFECT_WAVE_HOLD,   /* stays at start */
+  EFFECT_WAVE_RAMP,   /* start to end, then jumps back to start */
+  EFFECT_WAVE_SINE,   /* start to end and back, following sine_lut */
+  EFFECT_WAVE_SQUARE, /* start for the first half, end for the second */
+} effect_wave_e;
+
+/* where a track gets its values from */
+typedef enum effect_source {
+  EFFECT_SRC_CONST, /* from start to end */
+  EFFECT_SRC_COLOR, /* from the LED's own color to that plus end, wrapping */
+  EFFECT_SRC_ROLL,  /* from start to end as the roll input goes 0-255, instead of the phase */
+  EFFECT_SRC_PITCH, /* from start to end as the pitch input goes 0-255, instead of the phase */
+} effect_source_e;
+
+/* what a motion event does to the phase */
+typedef enum effect_trigger {
+  EFFECT_TRIGGER_NONE,    /* motion is ignored */
+  EFFECT_TRIGGER_RESTART, /* phase goes back to 0 */
+  EFFECT_TRIGGER_STEP,    /* phase advances by step */
+} effect_trigger_e;
+
+/* effect flags */
+#define EFFECT_ONESHOT 0x1 /* phase stops at 255 instead of wrapping */
+
+/* values from outside the effect that tracks can follow */
+typedef struct effect_inputs {
+  uint8_t roll;
+  uint8_t pitch;
+} effect_inputs_t;
+
+typedef struct effect_track {
+  uint8_t wave;   /* effect_wave_e */
+  uint8_t source; /* effect_source_e */
+  uint8_t start;
+  uint8_t end;
+} effect_track_t;
+
+typedef struct effect {
+  effect_track_t hue;
+  effect_track_t saturation;
+  effect_track_t value;
+  uint8_t rate;    /* phase advance per tick */
+  uint8_t spread;  /* phase offset from the first to the last LED, 255 is a full cycle */
+  uint8_t trigger; /* effect_trigger_e */
+  uint8_t step;    /* phase advance for EFFECT_TRIGGER_STEP */
+  uint8_t flags;
+} effect_t;
+
+/* track that leaves the LED's own color component alone */
+#define EFFECT_TRACK_COLOR {EFFECT_WAVE_HOLD, EFFECT_SRC_COLOR, 0, 0}
+/* track that holds a constant */
+#define EFFECT_TRACK_CONST(v) {EFFECT_WAVE_HOLD, EFFECT_SRC_CONST, v, v}
+
+uint8_t effect_start_phase(const effect_t* effect);
+uint8_t effect_advance(const effect_t* effect, uint8_t phase, uint8_t ticks);
+uint8_t effect_phase_at(const effect_t* effect, uint32_t ticks);
+uint8_t effect_ticks_to_change(const effect_t* effect, uint8_t phase);
+uint8_t effect_trigger(const effect_t* effect, uint8_t phase);
+hsv_color_t effect_eval(const effect_t* effect, uint8_t phase, hsv_color_t color,
+                        const effect_inputs_t* inputs);
+bool effect_is_static(const effect_t* effect);
+bool effect_uses_motion(const effect_t* effect);
+bool effect_uses_inputs(const effect_t* effect);
+
+static const uint8_t sine_lut[256] = {
+    0x0,  0x0,  0x0,  0x1,  0x1,  0x1,  0x2,  0x2,  0x3,  0x4,  0x5,  0x5,  0x6,  0x7,  0x9,  0xa,
+    0xb,  0xc,  0xe,  0xf,  0x11, 0x12, 0x14, 0x15, 0x17, 0x19, 0x1b, 0x1d, 0x1f, 0x21, 0x23, 0x25,
+    0x28, 0x2a, 0x2c, 0x2f, 0x31, 0x34, 0x36, 0x39, 0x3b, 0x3e, 0x41, 0x43, 0x46, 0x49, 0x4c, 0x4f,
+    0x52, 0x55, 0x58, 0x5a, 0x5d, 0x61, 0x64, 0x67, 0x6a, 0x6d, 0x70, 0x73, 0x76, 0x79, 0x7c, 0x80,
+    0x83, 0x86, 0x89, 0x8c, 0x8f, 0x92, 0x95, 0x98, 0x9b, 0x9e, 0xa2, 0xa5, 0xa7, 0xaa, 0xad, 0xb0,
+    0xb3, 0xb6, 0xb9, 0xbc, 0xbe, 0xc1, 0xc4, 0xc6, 0xc9, 0xcb, 0xce, 0xd0, 0xd3, 0xd5, 0xd7, 0xda,
+    0xdc, 0xde, 0xe0, 0xe2, 0xe4, 0xe6, 0xe8, 0xea, 0xeb, 0xed, 0xee, 0xf0, 0xf1, 0xf3, 0xf4, 0xf5,
+    0xf6, 0xf8, 0xf9, 0xfa, 0xfa, 0xfb, 0xfc, 0xfd, 0xfd, 0xfe, 0xfe, 0xfe, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xfe, 0xfe, 0xfe, 0xfd, 0xfd, 0xfc, 0xfb, 0xfa, 0xfa, 0xf9, 0xf8, 0xf6, 0xf5,
+    0xf4, 0xf3, 0xf1, 0xf0, 0xee, 0xed, 0xeb, 0xea, 0xe8, 0xe6, 0xe4, 0xe2, 0xe0, 0xde, 0xdc, 0xda,
+    0xd7, 0xd5, 0xd3, 0xd0, 0xce, 0xcb, 0xc9, 0xc6, 0xc4, 0xc1, 0xbe, 0xbc, 0xb9, 0xb6, 0xb3, 0xb0,
+    0xad, 0xaa, 0xa7, 0xa5, 0xa2, 0x9e, 0x9b, 0x98, 0x95, 0x92, 0x8f, 0x8c, 0x89, 0x86, 0x83, 0x80,
+    0x7c, 0x79, 0x76, 0x73, 0x70, 0x6d, 0x6a, 0x67, 0x64, 0x61, 0x5d, 0x5a, 0x58, 0x55, 0x52, 0x4f,
+    0x4c, 0x49, 0x46, 0x43, 0x41, 0x3e, 0x3b, 0x39, 0x36, 0x34, 0x31, 0x2f, 0x2c, 0x2a, 0x28, 0x25,
+    0x23, 0x21, 0x1f, 0x1d, 0x1b, 0x19, 0x17, 0x15, 0x14, 0x12, 0x11, 0xf,  0xe,  0xc,  0xb,  0xa,
+    0x9,  0x7,  0x6,  0x5,  0x5,  0x4,  0x3,  0x2,  0x2,  0x1,  0x1,  0x1,  0x0,  0x0,  0x0,  0x0,
+};
+
+#endif /* EFFECT_H */
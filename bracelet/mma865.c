@@ -2,118 +2,562 @@
 /* https://www.nxp.com/docs/en/data-sheet/MMA8653FC.pdf */
 /* https://www.nxp.com/docs/en/application-note/AN4083.pdf */
 #include <stdbool.h>
+#include <string.h>
 
+#include "app_util_platform.h"
+#include "app_timer.h"
+#include "nordic_common.h"
+#include "nrf.h"
 #include "nrf_drv_gpiote.h"
 #include "nrf_drv_twi.h"
 #include "nrf_log.h"
 #include "nrf_log_ctrl.h"
+#include "nrf_twi_mngr.h"
 
 #include "bracelet.h"
 #include "mma865.h"
+#include "motion.h"
 #include "ws2812.h"
 
-/* I2C instance. */
-static const nrf_drv_twi_t m_twi = NRF_DRV_TWI_INSTANCE(0);
-static uint8_t values[6];
-static int16_t a_x, a_y, a_z, jerk_x, jerk_y, jerk_z;
-static int16_t max_jerk = 0;
+/* transactions are queued and run one after another by the TWI manager on the TWIM with EasyDMA,
+   completion callbacks run in the TWI interrupt */
+NRF_TWI_MNGR_DEF(m_twi_mngr, MMA865_TWI_QUEUE_SIZE, 0);
+
+static uint8_t values[MMA865_FIFO_SIZE * MMA865_BYTES_PER_SAMPLE];
+static uint8_t sample_count = 0; /* samples in values waiting for mma865_process() */
+static uint8_t sample_size = MMA865_BYTES_PER_SAMPLE; /* bytes per sample of the current read */
+/* time of the last sample, counted in sample periods so it follows the sensor's own clock */
+static uint32_t sample_time_ms = 0;
+static motion_filter_t jerk_filter = MOTION_FILTER(MMA865_FILTER);
+static uint32_t max_jerk_sq = 0;
 static bool active = false;
+static bool fifo = false; /* samples are batched in the sensor's FIFO */
+/* sensor detects motion itself and only interrupts on detections, no samples are read */
+static bool offload = false;
+static volatile bool reading = false;    /* read queued or samples not processed yet */
+static volatile bool data_ready = false; /* samples in values are ready to process */
+static volatile bool detected = false;   /* detection engine event waiting to be handled */
+static uint32_t event_time_ms = 0;       /* app_timer time of the last detection */
+static uint32_t event_ticks = 0;
+static uint32_t max_isr_cycles = 0;      /* longest time spent in an interrupt handler here */
+static bool config_queued = false;  /* configuration write waiting or running */
+static bool config_changed = false; /* shadow changed after the queued write was filled */
+static uint8_t config_ctrl_reg1;    /* CTRL_REG1 once the queued configuration is written */
+static bool mode_queued = false;    /* standby or active write waiting or running */
+static bool mode_changed = false;   /* active bit changed after the queued write was filled */
 
-/* ######################### HELPERS ######################### */
-/* write 1 byte to a given register */
-ret_code_t mma865_register_write(uint8_t register_address, uint8_t value) {
-  uint8_t w2_data[2];
-  w2_data[0] = register_address;
-  w2_data[1] = value;
-  return nrf_drv_twi_tx(&m_twi, MMA865_ADDR, w2_data, 2, false);
-}
+/* RAM copy of the sensor's configuration registers, read once at init and written from here
+   without reading the sensor first */
+static struct {
+  uint8_t xyz_data_cfg;
+  uint8_t ctrl_reg[MMA865_NUM_CTRL_REGS]; /* CTRL_REG1..CTRL_REG5 */
+  uint8_t f_setup;                        /* MMA8652 only */
+  /* detection engine, transient on the MMA8652 and motion on the MMA8653 */
+  uint8_t detect_cfg;
+  uint8_t detect_ths;
+  uint8_t detect_count;
+} shadow;
+static uint8_t detect_base; /* CFG register of the detection engine, SRC, THS and COUNT follow */
+
+/* transactions have to stay in memory until they complete */
+static const uint8_t reg_status = MMA865_REG_STATUS;
+static const uint8_t reg_out_x_msb = MMA865_REG_OUT_X_MSB;
+static uint8_t f_status;
+static uint8_t detect_src;
+static uint8_t reg_detect_src;
+static uint8_t standby_write[2];
+static uint8_t ctrl_reg1_write[2];
+static uint8_t xyz_data_cfg_write[2];
+static uint8_t ctrl_regs_write[1 + MMA865_NUM_CTRL_REGS];
+static uint8_t f_setup_write[2];
+static uint8_t detect_cfg_write[2];
+static uint8_t detect_ths_write[3];
+static uint8_t active_write[2];
+static nrf_twi_mngr_transfer_t status_transfers[] = {
+    NRF_TWI_MNGR_WRITE(MMA865_ADDR, &reg_status, 1, NRF_TWI_MNGR_NO_STOP),
+    NRF_TWI_MNGR_READ(MMA865_ADDR, &f_status, 1, 0)};
+static nrf_twi_mngr_transfer_t sample_transfers[] = {
+    NRF_TWI_MNGR_WRITE(MMA865_ADDR, &reg_out_x_msb, 1, NRF_TWI_MNGR_NO_STOP),
+    NRF_TWI_MNGR_READ(MMA865_ADDR, values, MMA865_BYTES_PER_SAMPLE, 0)};
+static nrf_twi_mngr_transfer_t detect_src_transfers[] = {
+    NRF_TWI_MNGR_WRITE(MMA865_ADDR, &reg_detect_src, 1, NRF_TWI_MNGR_NO_STOP),
+    NRF_TWI_MNGR_READ(MMA865_ADDR, &detect_src, 1, 0)};
+/* the sensor ignores writes to the other registers while active, so CTRL_REG1 goes out with the
+   active bit clear first and its final value last. The control registers are consecutive so they
+   go out in one auto-increment write, as do the detection threshold and count. F_SETUP is
+   dropped at init for the MMA8653 */
+static nrf_twi_mngr_transfer_t config_transfers[] = {
+    NRF_TWI_MNGR_WRITE(MMA865_ADDR, standby_write, 2, 0),
+    NRF_TWI_MNGR_WRITE(MMA865_ADDR, xyz_data_cfg_write, 2, 0),
+    NRF_TWI_MNGR_WRITE(MMA865_ADDR, detect_cfg_write, 2, 0),
+    NRF_TWI_MNGR_WRITE(MMA865_ADDR, detect_ths_write, 3, 0),
+    NRF_TWI_MNGR_WRITE(MMA865_ADDR, ctrl_regs_write, sizeof(ctrl_regs_write), 0),
+    NRF_TWI_MNGR_WRITE(MMA865_ADDR, f_setup_write, 2, 0),
+    NRF_TWI_MNGR_WRITE(MMA865_ADDR, ctrl_reg1_write, 2, 0)};
+#define CONFIG_F_SETUP 5 /* index of the F_SETUP write in config_transfers */
+/* switching between standby and active only needs CTRL_REG1 */
+static nrf_twi_mngr_transfer_t mode_transfers[] = {
+    NRF_TWI_MNGR_WRITE(MMA865_ADDR, active_write, 2, 0)};
+
+static void status_read_done(ret_code_t result, void* p_user_data);
+static void sample_read_done(ret_code_t result, void* p_user_data);
+static void detect_src_read_done(ret_code_t result, void* p_user_data);
+static void config_write_done(ret_code_t result, void* p_user_data);
+static void mode_write_done(ret_code_t result, void* p_user_data);
+static const nrf_twi_mngr_transaction_t status_transaction = {
+    .callback = status_read_done,
+    .p_transfers = status_transfers,
+    .number_of_transfers = ARRAY_SIZE(status_transfers)};
+static const nrf_twi_mngr_transaction_t sample_transaction = {
+    .callback = sample_read_done,
+    .p_transfers = sample_transfers,
+    .number_of_transfers = ARRAY_SIZE(sample_transfers)};
+static const nrf_twi_mngr_transaction_t detect_src_transaction = {
+    .callback = detect_src_read_done,
+    .p_transfers = detect_src_transfers,
+    .number_of_transfers = ARRAY_SIZE(detect_src_transfers)};
+static nrf_twi_mngr_transaction_t config_transaction = {
+    .callback = config_write_done,
+    .p_transfers = config_transfers,
+    .number_of_transfers = ARRAY_SIZE(config_transfers)};
+static const nrf_twi_mngr_transaction_t mode_transaction = {
+    .callback = mode_write_done,
+    .p_transfers = mode_transfers,
+    .number_of_transfers = ARRAY_SIZE(mode_transfers)};
 
-/* read n byte from a given register */
+/* ######################### HELPERS ######################### */
+/* read n byte from a given register, blocks until done so only used from the main loop */
 ret_code_t mma865_register_read(uint8_t register_address, uint8_t* destination,
                                 uint8_t number_of_bytes) {
+  nrf_twi_mngr_transfer_t transfers[] = {
+      NRF_TWI_MNGR_WRITE(MMA865_ADDR, &register_address, 1, NRF_TWI_MNGR_NO_STOP),
+      NRF_TWI_MNGR_READ(MMA865_ADDR, destination, number_of_bytes, 0)};
+  return nrf_twi_mngr_perform(&m_twi_mngr, NULL, transfers, ARRAY_SIZE(transfers), NULL);
+}
+
+/* read every configuration register into the shadow */
+static ret_code_t shadow_read(void) {
   ret_code_t ret_code;
-  ret_code = nrf_drv_twi_tx(&m_twi, MMA865_ADDR, &register_address, 1, true);
+  ret_code = mma865_register_read(MMA865_XYZ_DATA_CFG, &shadow.xyz_data_cfg, 1);
+  if (ret_code) {
+    return ret_code;
+  }
+  ret_code = mma865_register_read(MMA865_CTRL_REG1, shadow.ctrl_reg, MMA865_NUM_CTRL_REGS);
+  if (ret_code) {
+    return ret_code;
+  }
+  ret_code = mma865_register_read(detect_base, &shadow.detect_cfg, 1);
+  if (ret_code) {
+    return ret_code;
+  }
+  ret_code = mma865_register_read(detect_base + 2, &shadow.detect_ths, 1);
   if (ret_code) {
     return ret_code;
   }
-  ret_code = nrf_drv_twi_rx(&m_twi, MMA865_ADDR, destination, number_of_bytes);
-  return ret_code;
+  ret_code = mma865_register_read(detect_base + 3, &shadow.detect_count, 1);
+  if (ret_code || !fifo) {
+    return ret_code;
+  }
+  return mma865_register_read(MMA865_REG_F_SETUP, &shadow.f_setup, 1);
 }
 
-/* Put the sensor into Standby Mode by clearing the Active bit of the System Control 1 Register */
-void mma865_standby(void) {
-  uint8_t n;
+/* fill the configuration write from the shadow and queue it */
+static void config_write(void) {
   ret_code_t ret_code;
-  if (!active) {
-    return;
+  standby_write[0] = MMA865_CTRL_REG1;
+  standby_write[1] = shadow.ctrl_reg[0] & ~0x1;
+  xyz_data_cfg_write[0] = MMA865_XYZ_DATA_CFG;
+  xyz_data_cfg_write[1] = shadow.xyz_data_cfg;
+  detect_cfg_write[0] = detect_base;
+  detect_cfg_write[1] = shadow.detect_cfg;
+  detect_ths_write[0] = detect_base + 2;
+  detect_ths_write[1] = shadow.detect_ths;
+  detect_ths_write[2] = shadow.detect_count;
+  ctrl_regs_write[0] = MMA865_CTRL_REG1;
+  memcpy(&ctrl_regs_write[1], shadow.ctrl_reg, MMA865_NUM_CTRL_REGS);
+  ctrl_regs_write[1] &= ~0x1;
+  f_setup_write[0] = MMA865_REG_F_SETUP;
+  f_setup_write[1] = shadow.f_setup;
+  ctrl_reg1_write[0] = MMA865_CTRL_REG1;
+  ctrl_reg1_write[1] = shadow.ctrl_reg[0];
+  config_ctrl_reg1 = shadow.ctrl_reg[0];
+  ret_code = nrf_twi_mngr_schedule(&m_twi_mngr, &config_transaction);
+  APP_ERROR_CHECK(ret_code);
+}
+
+/* write every configuration register from the shadow, returns straight away. Only one write is
+   queued at a time, changes made while it waits are written once it completes so a burst of
+   changes takes at most two writes and can't fill the TWI queue */
+void mma865_configure(void) {
+  bool queued;
+  CRITICAL_REGION_ENTER();
+  queued = config_queued;
+  config_queued = true;
+  if (queued) {
+    config_changed = true;
+  }
+  CRITICAL_REGION_EXIT();
+  if (!queued) {
+    config_write();
+  }
+}
+
+/* fill the CTRL_REG1 write from the shadow and queue it */
+static void mode_write(void) {
+  ret_code_t ret_code;
+  active_write[0] = MMA865_CTRL_REG1;
+  active_write[1] = shadow.ctrl_reg[0];
+  ret_code = nrf_twi_mngr_schedule(&m_twi_mngr, &mode_transaction);
+  APP_ERROR_CHECK(ret_code);
+}
+
+/* write the active bit alone, returns straight away. The sensor only takes the active bit of
+   CTRL_REG1 while active, any other change is left to a configuration write. Queued once at a
+   time like the configuration */
+static void mode_update(void) {
+  bool queued;
+  CRITICAL_REGION_ENTER();
+  queued = mode_queued;
+  mode_queued = true;
+  if (queued) {
+    mode_changed = true;
+  }
+  CRITICAL_REGION_EXIT();
+  if (!queued) {
+    mode_write();
+  }
+}
+
+/* set the active bit in the shadow, false if it already was */
+static bool mode_set(bool enable) {
+  if (enable == active) {
+    return false;
   }
-  ret_code = mma865_register_read(MMA865_CTRL_REG1, &n, 1);
-  NRF_LOG_INFO("read from mma865:%x = %x", MMA865_CTRL_REG1, n);
+  active = enable;
+  if (enable) {
+    shadow.ctrl_reg[0] |= 0x1;
+    /* the last sample is from before the standby */
+    motion_filter_reset(&jerk_filter);
+  } else {
+    shadow.ctrl_reg[0] &= ~0x1;
+  }
+  return true;
+}
+
+/* read the configuration back from the sensor and check it matches the shadow, blocks until
+   done so only call from the main loop */
+bool mma865_verify(void) {
+  uint8_t ctrl_reg[MMA865_NUM_CTRL_REGS];
+  uint8_t n, i;
+  bool ok = true;
+  ret_code_t ret_code;
+
+  ret_code = mma865_register_read(MMA865_XYZ_DATA_CFG, &n, 1);
+  APP_ERROR_CHECK(ret_code);
+  if (n != shadow.xyz_data_cfg) {
+    NRF_LOG_INFO("mma865 XYZ_DATA_CFG %x, expected %x", n, shadow.xyz_data_cfg);
+    ok = false;
+  }
+  ret_code = mma865_register_read(MMA865_CTRL_REG1, ctrl_reg, MMA865_NUM_CTRL_REGS);
   APP_ERROR_CHECK(ret_code);
-  ret_code = mma865_register_write(MMA865_CTRL_REG1, n & ~0x1);
+  for (i = 0; i < MMA865_NUM_CTRL_REGS; i++) {
+    if (ctrl_reg[i] != shadow.ctrl_reg[i]) {
+      NRF_LOG_INFO("mma865 CTRL_REG%d %x, expected %x", i + 1, ctrl_reg[i], shadow.ctrl_reg[i]);
+      ok = false;
+    }
+  }
+  ret_code = mma865_register_read(detect_base + 2, &n, 1);
   APP_ERROR_CHECK(ret_code);
-  active = false;
+  if (n != shadow.detect_ths) {
+    NRF_LOG_INFO("mma865 detection THS %x, expected %x", n, shadow.detect_ths);
+    ok = false;
+  }
+  if (fifo) {
+    ret_code = mma865_register_read(MMA865_REG_F_SETUP, &n, 1);
+    APP_ERROR_CHECK(ret_code);
+    if (n != shadow.f_setup) {
+      NRF_LOG_INFO("mma865 F_SETUP %x, expected %x", n, shadow.f_setup);
+      ok = false;
+    }
+  }
+  return ok;
+}
+
+/* cycle counter for timing interrupt handlers */
+static inline uint32_t cycles_get(void) {
+  return DWT->CYCCNT;
+}
+
+static inline void isr_cycles_record(uint32_t start) {
+  uint32_t cycles = cycles_get() - start;
+  if (cycles > max_isr_cycles) {
+    max_isr_cycles = cycles;
+  }
+}
+
+/* longest time spent in one of the accelerometer's interrupt handlers since the last call */
+uint32_t mma865_take_max_isr_cycles(void) {
+  uint32_t cycles = max_isr_cycles;
+  max_isr_cycles = 0;
+  return cycles;
+}
+
+/* Put the sensor into Standby Mode by clearing the Active bit of the System Control 1 Register */
+/* only queues the write so it is safe to call from interrupt context */
+void mma865_standby(void) {
+  if (mode_set(false)) {
+    mode_update();
+  }
 }
 
 /* Put the sensor into Active Mode by setting the Active bit of the System Control 1 Register */
+/* only queues the write so it is safe to call from interrupt context */
 void mma865_active(void) {
-  uint8_t n;
-  ret_code_t ret_code;
-  if (active) {
+  if (mode_set(true)) {
+    mode_update();
+  }
+}
+
+/* interrupt source that hands samples over, FIFO watermark on the MMA8652 and data ready on the
+   MMA8653 which doesn't have a FIFO */
+static uint8_t sample_interrupt(void) {
+  return fifo ? MMA865_INT_FIFO : MMA865_INT_DRDY;
+}
+
+/* let the sensor's detection engine look for motion over MMA865_DETECT_THS instead of streaming
+   samples, INT1 only fires on detections so the nRF sleeps in between. Only the MMA8652's
+   transient engine filters out gravity and slow motion, the MMA8653's motion engine would fire
+   on any swing so samples keep streaming there and claps are detected from the jerk */
+void mma865_set_offload(bool enable) {
+  uint8_t source;
+  if (!fifo) {
+    enable = false;
+  }
+  if (enable == offload) {
     return;
   }
-  ret_code = mma865_register_read(MMA865_CTRL_REG1, &n, 1);
-  NRF_LOG_INFO("read from mma865:%x = %x", MMA865_CTRL_REG1, n);
-  APP_ERROR_CHECK(ret_code);
-  ret_code = mma865_register_write(MMA865_CTRL_REG1, n | 0x1);
-  APP_ERROR_CHECK(ret_code);
-  active = true;
+  offload = enable;
+  if (enable) {
+    source = fifo ? MMA865_INT_TRANS : MMA865_INT_FF_MT;
+  } else {
+    source = sample_interrupt();
+  }
+  shadow.ctrl_reg[3] = source;
+  shadow.ctrl_reg[4] = source;
+  mma865_configure();
 }
 
-/* ######################### EVENT HANDLERS ######################### */
-/* interrupt INT1 triggered */
-void mma865_handler(nrf_drv_gpiote_pin_t pin, nrf_gpiote_polarity_t action) {
+/* low power wake detection. The sensor runs at 6.25Hz in low power oversampling with a motion
+   threshold just over what a still bracelet sees, so INT1 fires on the first movement and the
+   sensor draws a few uA. Disabling goes back to streaming samples in standby */
+void mma865_set_wake(bool enable) {
+  shadow.ctrl_reg[0] &= ~MMA865_DR_MASK;
+  shadow.ctrl_reg[1] &= ~0x3;
+  if (enable) {
+    shadow.ctrl_reg[0] |= MMA865_DR_6HZ;
+    shadow.ctrl_reg[1] |= 0x3;
+    shadow.detect_ths = fifo ? MMA865_WAKE_THS_TRANSIENT : MMA865_WAKE_THS_MOTION;
+    offload = true;
+    shadow.ctrl_reg[3] = fifo ? MMA865_INT_TRANS : MMA865_INT_FF_MT;
+  } else {
+    shadow.ctrl_reg[0] |= MMA865_DR_50HZ;
+    shadow.detect_ths = MMA865_DETECT_THS;
+    offload = false;
+    shadow.ctrl_reg[3] = sample_interrupt();
+  }
+  shadow.ctrl_reg[4] = shadow.ctrl_reg[3];
+  /* the configuration write ends with CTRL_REG1, so it carries the active bit as well */
+  mode_set(enable);
+  mma865_configure();
+}
+
+/* switch between 8 bit fast read samples (3 bytes) and full resolution ones (6 bytes) */
+void mma865_set_fast_read(bool enable) {
+  if (enable == !!(shadow.ctrl_reg[0] & 0x2)) {
+    return;
+  }
+  if (enable) {
+    shadow.ctrl_reg[0] |= 0x2;
+  } else {
+    shadow.ctrl_reg[0] &= ~0x2;
+  }
+  mma865_configure();
+}
+
+/* update the jerk from one sample read out of OUT_X_MSB..OUT_Z_LSB */
+static void sample_process(const uint8_t* sample) {
   int16_t x, y, z;
-  uint16_t temp;
-  ret_code_t ret_code = mma865_register_read(MMA865_REG_OUT_X_MSB, values, 6);
-  APP_ERROR_CHECK(ret_code);
+  uint32_t jerk_sq;
 
-  /* combine high and low bytes for x,y,z into signed 16 bit int */
-  x = values[0] << 8;
-  x |= values[1];
+  if (sample_size == MMA865_BYTES_PER_FAST_SAMPLE) {
+    /* fast read only has the MSBs, keep them in the top byte so the jerk is on the same scale */
+    x = sample[0] << 8;
+    y = sample[1] << 8;
+    z = sample[2] << 8;
+  } else {
+    /* combine high and low bytes for x,y,z into signed 16 bit int */
+    x = sample[0] << 8;
+    x |= sample[1];
 
-  y = values[2] << 8;
-  y |= values[3];
+    y = sample[2] << 8;
+    y |= sample[3];
 
-  z = values[4] << 8;
-  z |= values[5];
+    z = sample[4] << 8;
+    z |= sample[5];
+  }
+
+  /* down to the sensor's 10 bits so the sum of squares fits in 32 bits */
+  x >>= 6;
+  y >>= 6;
+  z >>= 6;
+
+  sample_time_ms += MMA865_SAMPLE_PERIOD_MS;
+  jerk_sq = motion_jerk_sq(&jerk_filter, x, y, z);
+  if (jerk_sq > max_jerk_sq) {
+    NRF_LOG_INFO("jerk squared surpassed max: %d ", jerk_sq);
+    max_jerk_sq = jerk_sq;
+  }
+
+  acc_data_handler(sample_time_ms, x, y, z, jerk_sq);
+}
+
+/* start reading out every sample waiting in the sensor, or the detection source when offloaded */
+static void samples_read(void) {
+  ret_code_t ret_code;
+  bool busy;
+  /* called from both the main loop and INT1 */
+  CRITICAL_REGION_ENTER();
+  busy = reading;
+  reading = true;
+  CRITICAL_REGION_EXIT();
+  if (busy) {
+    return;
+  }
+  /* reads are queued behind the last configuration write, so the size matches the mode they run
+     in */
+  sample_size = (config_ctrl_reg1 & 0x2) ? MMA865_BYTES_PER_FAST_SAMPLE : MMA865_BYTES_PER_SAMPLE;
+  if (offload) {
+    /* reading SRC clears the detection */
+    reg_detect_src = detect_base + 1;
+    ret_code = nrf_twi_mngr_schedule(&m_twi_mngr, &detect_src_transaction);
+  } else if (fifo) {
+    /* with the FIFO on STATUS is F_STATUS, holding the number of samples stored */
+    ret_code = nrf_twi_mngr_schedule(&m_twi_mngr, &status_transaction);
+  } else {
+    sample_transfers[1].length = sample_size;
+    ret_code = nrf_twi_mngr_schedule(&m_twi_mngr, &sample_transaction);
+  }
+  APP_ERROR_CHECK(ret_code);
+}
+
+/* time in ms from the app_timer counter, sample timestamps stop while detection is offloaded */
+static uint32_t event_time_get(void) {
+  uint32_t ticks = app_timer_cnt_get();
+  event_time_ms +=
+      ((uint64_t)app_timer_cnt_diff_compute(ticks, event_ticks) * 1000) / APP_TIMER_CLOCK_FREQ;
+  event_ticks = ticks;
+  return event_time_ms;
+}
 
-  jerk_x = x - a_x;
-  jerk_y = y - a_y;
-  jerk_z = z - a_z;
+/* called from the main loop, processes the samples read in the background */
+void mma865_process(void) {
+  uint8_t i;
+  if (detected) {
+    detected = false;
+    acc_detect_handler(event_time_get());
+  }
+  if (!data_ready) {
+    return;
+  }
+  data_ready = false;
+  for (i = 0; i < sample_count; i++) {
+    sample_process(&values[i * sample_size]);
+  }
+  reading = false;
+  /* interrupt line is level, if it is still asserted there is more to read */
+  if (active && !nrf_drv_gpiote_in_is_set(ACC_INT1)) {
+    samples_read();
+  }
+}
 
-  a_x = x;
-  a_y = y;
-  a_z = z;
+/* ######################### EVENT HANDLERS ######################### */
+/* interrupt INT1 triggered, data ready, FIFO watermark reached or motion detected */
+void mma865_handler(nrf_drv_gpiote_pin_t pin, nrf_gpiote_polarity_t action) {
+  uint32_t start = cycles_get();
+  samples_read();
+  isr_cycles_record(start);
+}
 
-  ABS(jerk_x, temp);
-  ABS(jerk_y, temp);
-  ABS(jerk_z, temp);
+/* F_STATUS read, read out as many samples as the FIFO holds in one burst */
+static void status_read_done(ret_code_t result, void* p_user_data) {
+  ret_code_t ret_code;
+  uint32_t start = cycles_get();
+  APP_ERROR_CHECK(result);
+  sample_count = f_status & MMA865_F_CNT_MASK;
+  if (sample_count == 0) {
+    data_ready = true;
+  } else {
+    /* the last output register wraps back round to OUT_X_MSB, each pass reads the next sample
+       from the FIFO */
+    sample_transfers[1].length = sample_count * sample_size;
+    ret_code = nrf_twi_mngr_schedule(&m_twi_mngr, &sample_transaction);
+    APP_ERROR_CHECK(ret_code);
+  }
+  isr_cycles_record(start);
+}
 
-  if (jerk_x > max_jerk) {
-    NRF_LOG_INFO("x jerk surpassed max: %d ", jerk_x);
-    max_jerk = jerk_x;
+/* detection source read, hand any detection over to the main loop */
+static void detect_src_read_done(ret_code_t result, void* p_user_data) {
+  uint32_t start = cycles_get();
+  APP_ERROR_CHECK(result);
+  /* event active flag is bit 6 of TRANSIENT_SRC and bit 7 of FF_MT_SRC */
+  if (detect_src & (fifo ? 0x40 : 0x80)) {
+    detected = true;
   }
-  if (jerk_y > max_jerk) {
-    NRF_LOG_INFO("y jerk surpassed max: %d ", jerk_y);
-    max_jerk = jerk_y;
+  sample_count = 0;
+  data_ready = true;
+  isr_cycles_record(start);
+}
+
+/* configuration written, write it again if the shadow changed while it was queued */
+static void config_write_done(ret_code_t result, void* p_user_data) {
+  bool changed;
+  uint32_t start = cycles_get();
+  APP_ERROR_CHECK(result);
+  CRITICAL_REGION_ENTER();
+  changed = config_changed;
+  config_changed = false;
+  config_queued = changed;
+  CRITICAL_REGION_EXIT();
+  if (changed) {
+    config_write();
   }
-  if (jerk_z > max_jerk) {
-    NRF_LOG_INFO("z jerk surpassed max: %d ", jerk_z);
-    max_jerk = jerk_z;
+  isr_cycles_record(start);
+}
+
+/* active bit written, write it again if it changed while queued */
+static void mode_write_done(ret_code_t result, void* p_user_data) {
+  bool changed;
+  uint32_t start = cycles_get();
+  APP_ERROR_CHECK(result);
+  CRITICAL_REGION_ENTER();
+  changed = mode_changed;
+  mode_changed = false;
+  mode_queued = changed;
+  CRITICAL_REGION_EXIT();
+  if (changed) {
+    mode_write();
   }
+  isr_cycles_record(start);
+}
 
-  acc_data_handler(a_x, a_y, a_z, jerk_x, jerk_y, jerk_z);
+/* samples read, hand them over to the main loop */
+static void sample_read_done(ret_code_t result, void* p_user_data) {
+  uint32_t start = cycles_get();
+  APP_ERROR_CHECK(result);
+  sample_count = sample_transfers[1].length / sample_size;
+  data_ready = true;
+  isr_cycles_record(start);
 }
 
 /* ######################### INITIALIZATION ######################### */
@@ -127,11 +571,12 @@ void twi_init(void) {
   twi_config.interrupt_priority = APP_IRQ_PRIORITY_HIGH;
   twi_config.clear_bus_init = false;
 
-  /* if twi_handler is NULL then blocking mode is enabled */
-  ret_code = nrf_drv_twi_init(&m_twi, &twi_config, NULL, NULL);
+  ret_code = nrf_twi_mngr_init(&m_twi_mngr, &twi_config);
   APP_ERROR_CHECK(ret_code);
 
-  nrf_drv_twi_enable(&m_twi);
+  /* start the cycle counter used to time interrupt handlers */
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
 }
 
 void mma865_init(void) {
@@ -140,43 +585,61 @@ void mma865_init(void) {
 
   twi_init();
 
-  /* put device into standby mode, and configure */
-  mma865_standby();
-
-  /* set sensitivity */
-  ret_code = mma865_register_read(MMA865_XYZ_DATA_CFG, &n, 1);
+  /* device comes out of reset in standby mode, configure it */
+  ret_code = mma865_register_read(MMA865_REG_WHO_AM_I, &n, 1);
   APP_ERROR_CHECK(ret_code);
-  n &= ~0x3;
-  n |= 0x2;
-  ret_code = mma865_register_write(MMA865_XYZ_DATA_CFG, n);
+  fifo = n == MMA8652_ID;
+  detect_base = fifo ? MMA865_REG_TRANSIENT_CFG : MMA865_REG_FF_MT_CFG;
+  if (!fifo) {
+    /* no F_SETUP on the MMA8653 */
+    config_transfers[CONFIG_F_SETUP] = config_transfers[CONFIG_F_SETUP + 1];
+    config_transaction.number_of_transfers--;
+  }
+  NRF_LOG_INFO("accelerometer id %x, fifo %d", n, fifo);
+  ret_code = shadow_read();
   APP_ERROR_CHECK(ret_code);
+  /* sensor is still active if only the nRF was reset */
+  shadow.ctrl_reg[0] &= ~0x1;
+
+  /* set sensitivity */
+  shadow.xyz_data_cfg &= ~0x3;
+  shadow.xyz_data_cfg |= 0x2;
 
   /* Set the data rate */
-  ret_code = mma865_register_read(MMA865_CTRL_REG1, &n, 1);
-  APP_ERROR_CHECK(ret_code);
-  n &= ~0x38;
-  n |= 0x20; /* 50Hz sample rate - this can mess with LEDs, what about ANT? */
-  ret_code = mma865_register_write(MMA865_CTRL_REG1, n);
-  APP_ERROR_CHECK(ret_code);
+  shadow.ctrl_reg[0] &= ~MMA865_DR_MASK;
+  shadow.ctrl_reg[0] |= MMA865_DR_50HZ; /* MMA865_SAMPLE_PERIOD_MS has to match */
 
   /* set oversampling mode to normal */
-  ret_code = mma865_register_read(MMA865_CTRL_REG2, &n, 1);
-  APP_ERROR_CHECK(ret_code);
-  n &= ~0x3;
-  ret_code = mma865_register_write(MMA865_CTRL_REG2, n);
-  APP_ERROR_CHECK(ret_code);
+  shadow.ctrl_reg[1] &= ~0x3;
 
-  /* set fast read mode off */
-  ret_code = mma865_register_read(MMA865_CTRL_REG1, &n, 1);
-  APP_ERROR_CHECK(ret_code);
-  n &= ~0x2;
-  ret_code = mma865_register_write(MMA865_CTRL_REG1, n);
-  APP_ERROR_CHECK(ret_code);
+  /* fast read mode only reads the 8 bit MSBs, skipping the LSB registers */
+  if (MMA865_FAST_READ) {
+    shadow.ctrl_reg[0] |= 0x2;
+  } else {
+    shadow.ctrl_reg[0] &= ~0x2;
+  }
 
-  /* enable data ready interrupts */
   /* Configure the INT pins for Open Drain and Active Low */
-  mma865_register_write(MMA865_CTRL_REG3, 0x1);
-  /* Enable the Data Ready Interrupt and route it to INT1 */
-  mma865_register_write(MMA865_CTRL_REG4, 0x1);
-  mma865_register_write(MMA865_CTRL_REG5, 0x1);
-}
\ No newline at end of file
+  shadow.ctrl_reg[2] = 0x1;
+  if (fifo) {
+    /* circular FIFO, interrupt once the watermark is reached */
+    shadow.f_setup = 0x40 | MMA865_FIFO_WATERMARK;
+    /* transient detection on all axes through the high pass filter, latched until read */
+    shadow.detect_cfg = 0x1E;
+  } else {
+    /* the MMA8653 has no transient engine, motion detection on all axes compares the raw
+       acceleration so the threshold has to be well above gravity, latched until read */
+    shadow.detect_cfg = 0xF8;
+  }
+  shadow.detect_ths = MMA865_DETECT_THS;
+  shadow.detect_count = 0;
+  /* interrupt for every sample or batch of samples routed to INT1 */
+  shadow.ctrl_reg[3] = sample_interrupt();
+  shadow.ctrl_reg[4] = sample_interrupt();
+
+  /* queued write goes out before the blocking reads of the verify */
+  mma865_configure();
+  if (!mma865_verify()) {
+    NRF_LOG_INFO("accelerometer configuration failed to verify");
+  }
+}
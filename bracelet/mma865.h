@@ -13,28 +13,67 @@
 #define MMA865_REG_OUT_Y_LSB 0x04U
 #define MMA865_REG_OUT_Z_MSB 0x05U
 #define MMA865_REG_OUT_Z_LSB 0x06U
+#define MMA865_REG_F_SETUP 0x09U /* MMA8652 only */
 #define MMA865_REG_SYSMOD 0x0BU
+#define MMA865_REG_WHO_AM_I 0x0DU
+#define MMA865_REG_FF_MT_CFG 0x15U     /* freefall/motion, SRC, THS and COUNT follow */
+#define MMA865_REG_TRANSIENT_CFG 0x1DU /* MMA8652 only, SRC, THS and COUNT follow */
 #define MMA865_XYZ_DATA_CFG 0x0EU
 #define MMA865_CTRL_REG1 0x2AU
 #define MMA865_CTRL_REG2 0x2BU
 #define MMA865_CTRL_REG3 0x2CU
 #define MMA865_CTRL_REG4 0x2DU
 #define MMA865_CTRL_REG5 0x2EU
+#define MMA865_NUM_CTRL_REGS 5
+/* interrupt sources in CTRL_REG4 (enable) and CTRL_REG5 (route to INT1) */
+#define MMA865_INT_DRDY 0x01U
+#define MMA865_INT_FF_MT 0x04U
+#define MMA865_INT_TRANS 0x20U
+#define MMA865_INT_FIFO 0x40U
+/* clap detection threshold in 0.063g steps. The MMA8652's transient engine compares the high
+   pass filtered acceleration, 2.4g of which roughly matches the clap jerk threshold. The MMA8653
+   only has the motion engine, which compares raw acceleration, so claps are never offloaded to
+   it, see mma865_set_offload() */
+#define MMA865_DETECT_THS 38
+/* wake detection thresholds, the MMA8653 compares raw acceleration so gravity has to fit under */
+#define MMA865_WAKE_THS_TRANSIENT 5 /* 0.3g through the high pass filter */
+#define MMA865_WAKE_THS_MOTION 20   /* 1.25g on any axis */
+
+#define MMA8652_ID 0x4AU /* WHO_AM_I of the MMA8652, which has a 32 sample FIFO */
+#define MMA8653_ID 0x5AU /* WHO_AM_I of the MMA8653, no FIFO */
+#define MMA865_FIFO_SIZE 32
+#define MMA865_SAMPLE_PERIOD_MS 20 /* 50Hz output data rate */
+/* CTRL_REG1 data rate bits */
+#define MMA865_DR_MASK 0x38U
+#define MMA865_DR_50HZ 0x20U
+#define MMA865_DR_6HZ 0x30U /* 6.25Hz, used while only waiting for motion to wake up */
+/* samples collected before the FIFO interrupts, 5 at 50Hz adds up to 100ms of latency to motion
+   but wakes the CPU 10 times a second instead of 50 */
+#define MMA865_FIFO_WATERMARK 5
+#define MMA865_F_CNT_MASK 0x3FU
+#define MMA865_BYTES_PER_SAMPLE 6
+#define MMA865_BYTES_PER_FAST_SAMPLE 3
+/* 1 to read 8 bit samples at init, half the bus time per sample and precise enough for the
+   jerk thresholds, can be switched with mma865_set_fast_read() */
+#define MMA865_FAST_READ 0
+/* filter applied to samples before taking the jerk magnitude, MOTION_FILTER_DIFF or DC */
+#define MMA865_FILTER MOTION_FILTER_DIFF
+/* TWI transactions that can be waiting at once, at most one configuration write, one active bit
+   write and one read are queued by the driver */
+#define MMA865_TWI_QUEUE_SIZE 4
 
 #define SCL_PIN 27
 #define SDA_PIN 26
 
-/* convert signed integer v to its absolute value without branching t is a temp uint16_t
-   https://graphics.stanford.edu/~seander/bithacks.html#IntegerAbs */
-#define ABS(v, t) \
-  do {            \
-    t = v >> 15;  \
-    v ^= t;       \
-    v += t & 1;   \
-  } while (0)
-
 void mma865_init(void);
 void mma865_handler(nrf_drv_gpiote_pin_t pin, nrf_gpiote_polarity_t action);
+void mma865_process(void);
+void mma865_configure(void);
+bool mma865_verify(void);
+void mma865_set_fast_read(bool enable);
+void mma865_set_offload(bool enable);
+void mma865_set_wake(bool enable);
+uint32_t mma865_take_max_isr_cycles(void);
 void mma865_standby(void);
 void mma865_active(void);
 
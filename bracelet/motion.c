@@ -0,0 +1,60 @@
+/* Copyright (c) 2023  Hunter Whyte */
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "motion.h"
+
+/* squared magnitude of the jerk for a sample in 10 bit counts. Differences stay within 11 bits
+   so the sum of the three squares fits in 32 bits, and comparing against squared thresholds
+   saves the square root. The first sample after a reset only primes the filter */
+uint32_t motion_jerk_sq(motion_filter_t* filter, int16_t x, int16_t y, int16_t z) {
+  const int16_t sample[3] = {x, y, z};
+  int32_t d;
+  uint32_t jerk_sq = 0;
+  uint8_t i;
+
+  for (i = 0; i < 3; i++) {
+    if (!filter->primed) {
+      filter->last[i] = sample[i];
+      filter->mean[i] = (int32_t)sample[i] << MOTION_DC_SHIFT;
+    }
+    if (filter->type == MOTION_FILTER_DC) {
+      d = sample[i] - (filter->mean[i] >> MOTION_DC_SHIFT);
+      filter->mean[i] += sample[i] - (filter->mean[i] >> MOTION_DC_SHIFT);
+    } else {
+      d = sample[i] - filter->last[i];
+    }
+    filter->last[i] = sample[i];
+    jerk_sq += d * d;
+  }
+  filter->primed = true;
+  return jerk_sq;
+}
+
+/* start over, for when samples stopped and the last one is stale */
+void motion_filter_reset(motion_filter_t* filter) {
+  filter->primed = false;
+}
+
+/* true if the jerk passes the threshold and the last detection is more than the cooldown ago */
+bool motion_detect(motion_detector_t* detector, uint32_t time_ms, uint32_t jerk_sq) {
+  if (jerk_sq <= detector->threshold_sq) {
+    return false;
+  }
+  return motion_event(detector, time_ms);
+}
+
+/* motion already detected (by the sensor), true unless the detector is still cooling down */
+bool motion_event(motion_detector_t* detector, uint32_t time_ms) {
+  if (detector->detected && time_ms - detector->last_ms < detector->cooldown_ms) {
+    return false;
+  }
+  detector->detected = true;
+  detector->last_ms = time_ms;
+  return true;
+}
+
+/* forget the last detection, for when the sample timestamps start over */
+void motion_reset(motion_detector_t* detector) {
+  detector->detected = false;
+}
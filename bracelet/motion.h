@@ -0,0 +1,48 @@
+/* Copyright (c) 2023  Hunter Whyte */
+#ifndef MOTION_H
+#define MOTION_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+Motion detection on the jerk magnitude of accelerometer samples. Kept free of any SDK calls and
+timed by sample timestamps rather than app_timer, so recorded traces can be replayed through
+exactly the same filter and detection the bracelet runs.
+*/
+
+/* what the jerk is measured from */
+#define MOTION_FILTER_DIFF 0 /* difference from the last sample */
+#define MOTION_FILTER_DC 1   /* difference from a running mean of the axis, removes gravity */
+/* running mean follows 1/2 of each new sample. A slower mean lets arm swings through, at 1/8 the
+   swing traces of host/replay_test.c gave 730 false positives */
+#define MOTION_DC_SHIFT 1
+
+typedef struct motion_filter {
+  uint8_t type;    /* MOTION_FILTER_* */
+  bool primed;     /* a sample has been seen since the reset */
+  int16_t last[3]; /* last sample */
+  int32_t mean[3]; /* running mean of each axis << MOTION_DC_SHIFT */
+} motion_filter_t;
+
+#define MOTION_FILTER(type) \
+  { (type), false, {0, 0, 0}, {0, 0, 0} }
+
+typedef struct motion_detector {
+  uint32_t threshold_sq; /* squared jerk that has to be passed */
+  uint32_t cooldown_ms;  /* time after a detection where motion is ignored */
+  uint32_t last_ms;      /* time of the last detection */
+  bool detected;         /* last_ms is valid */
+} motion_detector_t;
+
+/* threshold is in 10 bit sample counts, as the jerk from mma865 */
+#define MOTION_DETECTOR(threshold, cooldown) \
+  { (threshold) * (threshold), (cooldown), 0, false }
+
+uint32_t motion_jerk_sq(motion_filter_t* filter, int16_t x, int16_t y, int16_t z);
+void motion_filter_reset(motion_filter_t* filter);
+bool motion_detect(motion_detector_t* detector, uint32_t time_ms, uint32_t jerk_sq);
+bool motion_event(motion_detector_t* detector, uint32_t time_ms);
+void motion_reset(motion_detector_t* detector);
+
+#endif /* MOTION_H */
@@ -11,8 +11,9 @@
 #include "bracelet.h"
 #include "common.h"
 
-/* just using 1 byte to store group data but have to receive ascii text with a header */
-#define NFC_FILE_SIZE 11
+/* just using 1 byte to store group data but have to receive ascii text with a header: NLEN, 7
+   bytes of text record header and up to 3 digits for groups past 99 */
+#define NFC_FILE_SIZE 12
 
 __ALIGN(4) static uint8_t ndef_msg_buf[NFC_FILE_SIZE]; /* Buffer for NFC message */
 __ALIGN(4) static uint8_t ndef_loaded_msg[NFC_FILE_SIZE]; /* Buffer for NFC message */
@@ -205,7 +206,9 @@ static void fds_evt_handler(fds_evt_t const* const p_fds_evt) {
 static void nfc_callback(void* context, nfc_t4t_event_t event, const uint8_t* data,
                          size_t data_length, uint32_t flags) {
   ret_code_t ret_code;
-  uint8_t new_group;
+  uint16_t new_group; /* 1 based as written */
+  bool valid;
+  size_t i;
   (void)context;
 
   switch (event) {
@@ -225,16 +228,16 @@ static void nfc_callback(void* context, nfc_t4t_event_t event, const uint8_t* da
       NRF_LOG_INFO("NFC_T4T_EVENT_NDEF_UPDATED");
       if (data_length > 0) {
         NRF_LOG_HEXDUMP_INFO(ndef_msg_buf, data_length + NLEN_FIELD_SIZE);
-        /* get group number from ascii data */
-        if (data_length > 8) {
-          new_group = (ndef_msg_buf[9] - 0x30) * 10;
-          new_group += (ndef_msg_buf[10] - 0x30);
-        } else {
-          new_group = ndef_msg_buf[9] - 0x30;
+        /* get group number from ascii data, 1 to 3 digits after the header */
+        valid = data_length + NLEN_FIELD_SIZE > 9 && data_length + NLEN_FIELD_SIZE <= NFC_FILE_SIZE;
+        new_group = 0;
+        for (i = 9; valid && i < data_length + NLEN_FIELD_SIZE; i++) {
+          valid = ndef_msg_buf[i] >= '0' && ndef_msg_buf[i] <= '9';
+          new_group = new_group * 10 + (ndef_msg_buf[i] - '0');
         }
 
         NRF_LOG_INFO("GROUP RECEIVED: %d", new_group);
-        if (VALID_GROUP(new_group)) {
+        if (valid && new_group >= 1 && VALID_GROUP(new_group - 1)) {
           group = new_group - 1;
           /* update ANT group */
           set_group(group);
@@ -0,0 +1,101 @@
+/* Copyright (c) 2023  Hunter Whyte */
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "common.h"
+#include "showclock.h"
+#include "wire.h"
+
+#define RATE_MAX_ERROR \
+  ((uint32_t)(((uint64_t)SHOWCLOCK_RATE_NOMINAL * SHOWCLOCK_MAX_PPM) / 1000000))
+#define SEQ_SPAN (WIRE_SEQ_MASK + 1)
+
+/* show time at a local time, with fraction */
+static uint64_t show_predict(const showclock_t* clock, uint32_t local) {
+  uint32_t elapsed = local - clock->local_ref;
+  return clock->show_ref +
+         (((uint64_t)elapsed * clock->rate) >> (SHOWCLOCK_RATE_SHIFT - SHOWCLOCK_FRAC_BITS));
+}
+
+/* a message was received at local time, sent at show time */
+static void sync(showclock_t* clock, uint32_t local, uint32_t show_time) {
+  uint64_t predicted = show_predict(clock, local);
+  uint32_t elapsed = local - clock->local_ref;
+  /* only the low 32 bits are compared so show time can wrap, fine for errors under 4 minutes */
+  int32_t error = (uint32_t)((uint64_t)show_time << SHOWCLOCK_FRAC_BITS) - (uint32_t)predicted;
+  int64_t rate;
+
+  if (!clock->locked || error > (SHOWCLOCK_STEP_TICKS << SHOWCLOCK_FRAC_BITS) ||
+      error < -(SHOWCLOCK_STEP_TICKS << SHOWCLOCK_FRAC_BITS)) {
+    clock->show_ref = (uint64_t)show_time << SHOWCLOCK_FRAC_BITS;
+    clock->local_ref = local;
+    clock->locked = true;
+    return;
+  }
+  clock->show_ref = predicted + (error >> SHOWCLOCK_PHASE_SHIFT);
+  clock->local_ref = local;
+  if (elapsed == 0) {
+    return;
+  }
+  /* error per local tick, in the rate's Q30 */
+  rate = clock->rate + ((((int64_t)error << (SHOWCLOCK_RATE_SHIFT - SHOWCLOCK_FRAC_BITS)) /
+                         elapsed) >> SHOWCLOCK_FREQ_SHIFT);
+  if (rate > SHOWCLOCK_RATE_NOMINAL + RATE_MAX_ERROR) {
+    rate = SHOWCLOCK_RATE_NOMINAL + RATE_MAX_ERROR;
+  } else if (rate < SHOWCLOCK_RATE_NOMINAL - RATE_MAX_ERROR) {
+    rate = SHOWCLOCK_RATE_NOMINAL - RATE_MAX_ERROR;
+  }
+  clock->rate = rate;
+}
+
+void showclock_reset(showclock_t* clock) {
+  clock->rate = SHOWCLOCK_RATE_NOMINAL;
+  clock->anchored = false;
+  clock->locked = false;
+}
+
+/* time message received at local time */
+void showclock_time(showclock_t* clock, uint32_t local, uint8_t seq, uint32_t show_time) {
+  clock->anchor_show = show_time;
+  clock->anchor_seq = seq;
+  clock->anchored = true;
+  sync(clock, local, show_time);
+}
+
+/* any other message received at local time, timed from the last time message. The sequence
+   number only counts to 16, so the show time is whichever fits it closest to the prediction */
+void showclock_message(showclock_t* clock, uint32_t local, uint8_t seq) {
+  uint32_t predicted;
+  uint32_t show_time;
+  int32_t spans;
+
+  if (!clock->anchored) {
+    return;
+  }
+  predicted = show_predict(clock, local) >> SHOWCLOCK_FRAC_BITS;
+  show_time = clock->anchor_show + ((seq - clock->anchor_seq) & WIRE_SEQ_MASK) * CHAN_PERIOD;
+  spans = (int32_t)(predicted - show_time);
+  spans = (spans + (spans < 0 ? -1 : 1) * (SEQ_SPAN * CHAN_PERIOD / 2)) / (SEQ_SPAN * CHAN_PERIOD);
+  sync(clock, local, show_time + spans * (SEQ_SPAN * CHAN_PERIOD));
+}
+
+/* every channel keeps its own sequence numbers, after switching channel the anchor's number
+   means nothing so messages are ignored until the next time message. The offset and rate are
+   kept, show time is the same on every channel */
+void showclock_unanchor(showclock_t* clock) {
+  clock->anchored = false;
+}
+
+/* show time at a local time */
+uint32_t showclock_now(const showclock_t* clock, uint32_t local) {
+  return show_predict(clock, local) >> SHOWCLOCK_FRAC_BITS;
+}
+
+bool showclock_locked(const showclock_t* clock) {
+  return clock->locked;
+}
+
+/* learned drift of the show clock against the local one */
+int32_t showclock_drift_ppm(const showclock_t* clock) {
+  return ((int64_t)clock->rate - SHOWCLOCK_RATE_NOMINAL) * 1000000 / SHOWCLOCK_RATE_NOMINAL;
+}
@@ -0,0 +1,48 @@
+/* Copyright (c) 2023  Hunter Whyte */
+#ifndef SHOWCLOCK_H
+#define SHOWCLOCK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+Local copy of the controller's show time, so effects on every bracelet run in phase. Show time
+is in 1/32768s and is sent in time messages (see wire.h), every other message is timed from the
+last one by its sequence number. The local clock is the app_timer counter, show time is
+predicted from it with an offset and a rate, and each timed message corrects both: a share of
+the error goes into the offset (phase) and a much smaller share of the error over the time
+since the last message into the rate, which learns the drift between the two crystals so the
+clock holds between messages and through dropouts. Kept free of SDK calls so it can be
+simulated.
+*/
+
+#define SHOWCLOCK_LOCAL_HZ 16384 /* app_timer counter */
+#define SHOWCLOCK_SHOW_HZ 32768
+#define SHOWCLOCK_RATE_SHIFT 30 /* rate is show ticks per local tick in Q30 */
+#define SHOWCLOCK_RATE_NOMINAL \
+  ((uint32_t)(SHOWCLOCK_SHOW_HZ / SHOWCLOCK_LOCAL_HZ) << SHOWCLOCK_RATE_SHIFT)
+#define SHOWCLOCK_MAX_PPM 500     /* drift allowed, anything past it is clamped */
+#define SHOWCLOCK_FRAC_BITS 8     /* fraction bits kept on the show time */
+#define SHOWCLOCK_PHASE_SHIFT 2   /* 1/4 of the error corrects the offset */
+#define SHOWCLOCK_FREQ_SHIFT 10   /* 1/1024 of the error over the interval corrects the rate */
+#define SHOWCLOCK_STEP_TICKS 3277 /* errors over 100ms step the clock instead */
+
+typedef struct showclock {
+  uint64_t show_ref;  /* show time at local_ref, SHOWCLOCK_FRAC_BITS of fraction */
+  uint32_t local_ref;
+  uint32_t rate;
+  uint32_t anchor_show; /* show time of the last time message */
+  uint8_t anchor_seq;
+  bool anchored; /* anchor_seq counts on the channel being received */
+  bool locked;   /* set by the first time message */
+} showclock_t;
+
+void showclock_reset(showclock_t* clock);
+void showclock_time(showclock_t* clock, uint32_t local, uint8_t seq, uint32_t show_time);
+void showclock_message(showclock_t* clock, uint32_t local, uint8_t seq);
+void showclock_unanchor(showclock_t* clock);
+uint32_t showclock_now(const showclock_t* clock, uint32_t local);
+bool showclock_locked(const showclock_t* clock);
+int32_t showclock_drift_ppm(const showclock_t* clock);
+
+#endif /* SHOWCLOCK_H */
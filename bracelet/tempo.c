@@ -0,0 +1,113 @@
+/* Copyright (c) 2023  Hunter Whyte */
+/* tempo estimate from onset autocorrelation, see tempo.h */
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "tempo.h"
+
+#define HISTORY_BYTES (TEMPO_HISTORY_BINS / 8)
+
+static bool history_get(const tempo_t* tempo, uint16_t bin) {
+  if (bin >= TEMPO_HISTORY_BINS) {
+    return false;
+  }
+  return tempo->history[bin / 8] & (1 << (bin % 8));
+}
+
+/* age the history by n bins */
+static void history_shift(tempo_t* tempo, uint32_t n) {
+  int16_t i;
+  uint8_t bytes = n / 8;
+  uint8_t bits = n % 8;
+  uint8_t high, low;
+
+  if (n >= TEMPO_HISTORY_BINS) {
+    memset(tempo->history, 0, HISTORY_BYTES);
+    return;
+  }
+  for (i = HISTORY_BYTES - 1; i >= 0; i--) {
+    high = i - bytes >= 0 ? tempo->history[i - bytes] : 0;
+    low = i - bytes - 1 >= 0 ? tempo->history[i - bytes - 1] : 0;
+    tempo->history[i] = bits ? (high << bits) | (low >> (8 - bits)) : high;
+  }
+}
+
+/* how well the history matches an onset lag bins before the latest one */
+static uint16_t lag_hit(const tempo_t* tempo, uint16_t lag) {
+  if (history_get(tempo, lag)) {
+    return TEMPO_HIT;
+  }
+  /* onsets are only roughly on the beat, let the neighbouring bins count for half */
+  if (history_get(tempo, lag - 1) || history_get(tempo, lag + 1)) {
+    return TEMPO_HIT / 2;
+  }
+  return 0;
+}
+
+void tempo_reset(tempo_t* tempo) {
+  memset(tempo, 0, sizeof(*tempo));
+}
+
+/* add an onset at time_ms, onsets have to come in time order */
+void tempo_onset(tempo_t* tempo, uint32_t time_ms) {
+  uint16_t i, lag;
+  int32_t score;
+
+  if (tempo->started) {
+    history_shift(tempo, (time_ms - tempo->last_ms + TEMPO_BIN_MS / 2) / TEMPO_BIN_MS);
+  }
+  tempo->started = true;
+  tempo->last_ms = time_ms;
+
+  for (i = 0; i < TEMPO_LAGS; i++) {
+    lag = TEMPO_MIN_LAG + i;
+    score = tempo->score[i] - (tempo->score[i] >> TEMPO_DECAY_SHIFT);
+    /* an onset two lags back backs the lag up, one half way between means it is two beats */
+    score += lag_hit(tempo, lag) + lag_hit(tempo, 2 * lag) / 2 - lag_hit(tempo, lag / 2) / 2;
+    if (score < 0) {
+      score = 0;
+    }
+    tempo->score[i] = score > UINT16_MAX ? UINT16_MAX : score;
+  }
+  tempo->history[0] |= 1;
+}
+
+/* beat period in ms, 0 until the onsets have settled on a tempo */
+uint16_t tempo_period_ms(const tempo_t* tempo) {
+  uint16_t i, lag, half, best = 0;
+  int32_t left, right, centre, curve;
+  int32_t offset = 0; /* fraction of a bin from the best lag, 8.8 fixed point */
+
+  for (i = 1; i < TEMPO_LAGS; i++) {
+    if (tempo->score[i] > tempo->score[best]) {
+      best = i;
+    }
+  }
+  if (tempo->score[best] < TEMPO_LOCK_SCORE) {
+    return 0;
+  }
+  /* a beat between two lags splits its score over them and double the period can come out on
+     top, take the half lag when it's close */
+  lag = (TEMPO_MIN_LAG + best) / 2;
+  half = best;
+  for (i = lag; i <= lag + 1; i++) {
+    if (i >= TEMPO_MIN_LAG && 2 * tempo->score[i - TEMPO_MIN_LAG] >= tempo->score[best]) {
+      half = i - TEMPO_MIN_LAG;
+    }
+  }
+  best = half;
+  /* fit a parabola through the best lag and its neighbours for a finer period than a bin */
+  if (best > 0 && best < TEMPO_LAGS - 1) {
+    left = tempo->score[best - 1];
+    centre = tempo->score[best];
+    right = tempo->score[best + 1];
+    curve = 2 * centre - left - right;
+    if (curve > 0) {
+      offset = ((right - left) * 128) / curve;
+    }
+    /* the half lag needn't be a peak, keep it within its bin */
+    offset = offset > 128 ? 128 : offset < -128 ? -128 : offset;
+  }
+  return ((TEMPO_MIN_LAG + best) * 256 + offset) * TEMPO_BIN_MS / 256;
+}
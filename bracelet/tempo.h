@@ -0,0 +1,38 @@
+/* Copyright (c) 2023  Hunter Whyte */
+#ifndef TEMPO_H
+#define TEMPO_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+Online tempo estimate from motion onsets (claps). Onsets are kept as a bitset of 20ms bins over
+the last 4 seconds. Each new onset is compared against the history at every lag in the tempo
+range and a decaying score per lag counts how often onsets are that far apart, an
+autocorrelation of the onset train that only has to be updated when an onset arrives. An onset
+two lags back counts towards the lag as well, like a comb filter, and one half a lag back counts
+against it so double the period doesn't win. Uses about 100 bytes of RAM and no SDK calls so
+traces can be replayed.
+*/
+
+#define TEMPO_BIN_MS 20
+#define TEMPO_HISTORY_BINS 200 /* 4s */
+#define TEMPO_MIN_LAG 17       /* 340ms, 176 BPM */
+#define TEMPO_MAX_LAG 50       /* 1000ms, 60 BPM */
+#define TEMPO_LAGS (TEMPO_MAX_LAG - TEMPO_MIN_LAG + 1)
+#define TEMPO_HIT 256        /* score for an onset exactly one lag back, 8.8 fixed point */
+#define TEMPO_DECAY_SHIFT 3  /* scores lose 1/8 every onset */
+#define TEMPO_LOCK_SCORE 768 /* best score needed before a tempo is reported */
+
+typedef struct tempo {
+  uint8_t history[TEMPO_HISTORY_BINS / 8]; /* onsets, bit 0 is the bin of the latest onset */
+  uint16_t score[TEMPO_LAGS];
+  uint32_t last_ms; /* time of the latest onset */
+  bool started;
+} tempo_t;
+
+void tempo_reset(tempo_t* tempo);
+void tempo_onset(tempo_t* tempo, uint32_t time_ms);
+uint16_t tempo_period_ms(const tempo_t* tempo);
+
+#endif /* TEMPO_H */
@@ -0,0 +1,76 @@
+/* Copyright (c) 2023  Hunter Whyte */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "tilt.h"
+
+#define ANGLE_EIGHTH 8192  /* 45 degrees */
+#define ANGLE_QUARTER 16384
+#define ANGLE_HALF 32768
+/* atan(r) ~= r * pi/4 + 0.273 * r * (1 - r) for r in 0-1, good to about a quarter degree. The 0.273
+   term in binary angle units */
+#define ATAN_CORRECTION 2847
+
+/* angle of (x, y) in binary units, 0 along +x and counter clockwise. Folded into the first
+   octant so the ratio stays in 0-1 and only one division is needed */
+uint16_t tilt_atan2(int32_t y, int32_t x) {
+  uint32_t abs_x = abs(x);
+  uint32_t abs_y = abs(y);
+  uint32_t r; /* smaller over larger, 15 bit fraction */
+  uint16_t angle;
+
+  if (abs_x == 0 && abs_y == 0) {
+    return 0;
+  }
+  if (abs_y <= abs_x) {
+    r = (abs_y << 15) / abs_x;
+  } else {
+    r = (abs_x << 15) / abs_y;
+  }
+  angle = ((r * ANGLE_EIGHTH) >> 15) + ((ATAN_CORRECTION * ((r * (32768 - r)) >> 15)) >> 15);
+  if (abs_y > abs_x) {
+    angle = ANGLE_QUARTER - angle;
+  }
+  if (x < 0) {
+    angle = ANGLE_HALF - angle;
+  }
+  if (y < 0) {
+    angle = -angle;
+  }
+  return angle;
+}
+
+void tilt_reset(tilt_t* tilt) {
+  tilt->started = false;
+}
+
+/* filter in a sample, 10 bit counts as from mma865 */
+void tilt_update(tilt_t* tilt, int16_t a_x, int16_t a_y, int16_t a_z) {
+  if (!tilt->started) {
+    tilt->x = a_x << TILT_LPF_SHIFT;
+    tilt->y = a_y << TILT_LPF_SHIFT;
+    tilt->z = a_z << TILT_LPF_SHIFT;
+    tilt->started = true;
+    return;
+  }
+  tilt->x += a_x - (tilt->x >> TILT_LPF_SHIFT);
+  tilt->y += a_y - (tilt->y >> TILT_LPF_SHIFT);
+  tilt->z += a_z - (tilt->z >> TILT_LPF_SHIFT);
+}
+
+/* rotation around the x axis, 0-255 for a full turn so it wraps like hue */
+uint8_t tilt_roll(const tilt_t* tilt) {
+  return tilt_atan2(tilt->y, tilt->z) >> 8;
+}
+
+/* angle of the x axis to horizontal, 0 pointing straight down to 255 straight up */
+uint8_t tilt_pitch(const tilt_t* tilt) {
+  uint32_t abs_y = abs(tilt->y);
+  uint32_t abs_z = abs(tilt->z);
+  /* length of the y-z component without a square root, max + min / 2 is within 12% */
+  uint32_t yz = abs_y > abs_z ? abs_y + abs_z / 2 : abs_z + abs_y / 2;
+  int16_t pitch = tilt_atan2(tilt->x, yz); /* -quarter to +quarter turn */
+  int32_t scaled = (pitch + ANGLE_QUARTER) >> 7;
+  return scaled > 255 ? 255 : scaled;
+}
@@ -0,0 +1,28 @@
+/* Copyright (c) 2023  Hunter Whyte */
+#ifndef TILT_H
+#define TILT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+Wrist orientation from the direction of gravity. Samples are low pass filtered so the angles
+follow slow turns of the wrist and not every shake, then turned into roll (around the x axis,
+a full turn) and pitch (x axis up or down, a half turn) with an integer atan2. Angles are in
+binary units, 65536 to a turn, and the 8 bit versions go straight into effect inputs.
+*/
+
+#define TILT_LPF_SHIFT 3 /* filter follows 1/8 of each new sample, ~150ms at 50Hz */
+
+typedef struct tilt {
+  int32_t x, y, z; /* filtered acceleration, scaled up by 1 << TILT_LPF_SHIFT */
+  bool started;
+} tilt_t;
+
+uint16_t tilt_atan2(int32_t y, int32_t x);
+void tilt_reset(tilt_t* tilt);
+void tilt_update(tilt_t* tilt, int16_t a_x, int16_t a_y, int16_t a_z);
+uint8_t tilt_roll(const tilt_t* tilt);
+uint8_t tilt_pitch(const tilt_t* tilt);
+
+#endif /* TILT_H */
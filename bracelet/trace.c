@@ -0,0 +1,84 @@
+/* Copyright (c) 2023  Hunter Whyte */
+/* recording and reading back accelerometer traces, see trace.h for the format */
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "trace.h"
+
+#define AXIS_MASK 0x3FF
+
+/* sign extend a 10 bit axis */
+static int16_t axis_get(uint32_t packed, uint8_t shift) {
+  int16_t v = (packed >> shift) & AXIS_MASK;
+  return v & 0x200 ? v - 0x400 : v;
+}
+
+/* start a new trace in buffer, writing the header */
+void trace_begin(trace_t* trace, uint8_t* buffer, uint16_t size, uint8_t period_ms, uint8_t flags) {
+  trace->buffer = buffer;
+  trace->size = size;
+  trace->length = 0;
+  trace->last_ms = 0;
+  if (size < TRACE_HEADER_BYTES) {
+    return;
+  }
+  memcpy(buffer, TRACE_MAGIC, 4);
+  buffer[4] = TRACE_VERSION;
+  buffer[5] = period_ms;
+  buffer[6] = flags;
+  buffer[7] = 0;
+  trace->length = TRACE_HEADER_BYTES;
+}
+
+/* append a sample, false once the buffer is full */
+bool trace_record(trace_t* trace, uint32_t time_ms, int16_t x, int16_t y, int16_t z) {
+  uint8_t* sample;
+  uint32_t dt = time_ms - trace->last_ms;
+  uint32_t packed;
+
+  if (trace_full(trace)) {
+    return false;
+  }
+  sample = &trace->buffer[trace->length];
+  packed = (x & AXIS_MASK) | ((uint32_t)(y & AXIS_MASK) << 10) | ((uint32_t)(z & AXIS_MASK) << 20);
+  sample[0] = dt > 255 ? 255 : dt;
+  sample[1] = packed;
+  sample[2] = packed >> 8;
+  sample[3] = packed >> 16;
+  sample[4] = packed >> 24;
+  trace->length += TRACE_SAMPLE_BYTES;
+  trace->last_ms = time_ms;
+  return true;
+}
+
+bool trace_full(const trace_t* trace) {
+  return trace->length == 0 || trace->length + TRACE_SAMPLE_BYTES > trace->size;
+}
+
+/* read the sample at *pos and advance it, start with *pos = 0 and *time_ms = 0. False at the
+   end of the trace or if the header isn't valid */
+bool trace_read(const uint8_t* buffer, uint16_t length, uint16_t* pos, uint32_t* time_ms,
+                int16_t* x, int16_t* y, int16_t* z) {
+  const uint8_t* sample;
+  uint32_t packed;
+
+  if (*pos == 0) {
+    if (length < TRACE_HEADER_BYTES || memcmp(buffer, TRACE_MAGIC, 4) != 0 ||
+        buffer[4] != TRACE_VERSION) {
+      return false;
+    }
+    *pos = TRACE_HEADER_BYTES;
+  }
+  if (*pos + TRACE_SAMPLE_BYTES > length) {
+    return false;
+  }
+  sample = &buffer[*pos];
+  packed = sample[1] | (sample[2] << 8) | ((uint32_t)sample[3] << 16) | ((uint32_t)sample[4] << 24);
+  *time_ms += sample[0];
+  *x = axis_get(packed, 0);
+  *y = axis_get(packed, 10);
+  *z = axis_get(packed, 20);
+  *pos += TRACE_SAMPLE_BYTES;
+  return true;
+}
@@ -0,0 +1,42 @@
+/* Copyright (c) 2023  Hunter Whyte */
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+Binary trace of accelerometer samples, as handed to acc_data_handler, for replaying through
+the motion detection offline. All values are little endian.
+
+header, 8 bytes:
+  0..3  magic "ACCT"
+  4     version
+  5     sample period in ms
+  6     flags, TRACE_FLAG_*
+  7     reserved, 0
+each sample, 5 bytes:
+  0     ms since the previous sample (since time 0 for the first), saturates at 255
+  1..4  x, y, z as 10 bit two's complement in bits 0-9, 10-19 and 20-29
+*/
+
+#define TRACE_MAGIC "ACCT"
+#define TRACE_VERSION 1
+#define TRACE_HEADER_BYTES 8
+#define TRACE_SAMPLE_BYTES 5
+#define TRACE_FLAG_FAST_READ 0x1 /* samples only had 8 bit resolution */
+
+typedef struct trace {
+  uint8_t* buffer;
+  uint16_t size;   /* bytes available in buffer */
+  uint16_t length; /* bytes written, header included */
+  uint32_t last_ms;
+} trace_t;
+
+void trace_begin(trace_t* trace, uint8_t* buffer, uint16_t size, uint8_t period_ms, uint8_t flags);
+bool trace_record(trace_t* trace, uint32_t time_ms, int16_t x, int16_t y, int16_t z);
+bool trace_full(const trace_t* trace);
+bool trace_read(const uint8_t* buffer, uint16_t length, uint16_t* pos, uint32_t* time_ms,
+                int16_t* x, int16_t* y, int16_t* z);
+
+#endif /* TRACE_H */
@@ -1,193 +1,480 @@
 /* Copyright (c) 2023  Hunter Whyte */
 #include <stdbool.h>
+#include <string.h>
+#include "app_util_platform.h"
 #include "nrf.h"
 #include "nrf_drv_pwm.h"
 #include "nrf_gpio.h"
 #include "nrf_log.h"
+
+#include "bracelet.h"
+#include "color.h"
+#include "effect.h"
 #include "ws2812.h"
 
 static nrf_drv_pwm_t pwm_instance = NRF_DRV_PWM_INSTANCE(0);
-static nrf_pwm_values_common_t pwm_sequence_values[TOTAL_CYCLES];
-static nrf_pwm_sequence_t pwm_sequence;
-static rgb_color_t rgb_colors[NUM_LEDS];
-static hsv_color_t hsv_colors[NUM_LEDS];
+/* two halves of the ring the frame is streamed through, one sequence each */
+__ALIGN(4) static nrf_pwm_values_common_t pwm_ring_values[2][RING_CYCLES];
+static nrf_pwm_sequence_t pwm_sequences[2];
+/* frames are written to the back buffer while the front buffer is streamed out */
+static uint8_t frame_bytes[2][WS2812_MAX_LEDS * BYTES_PER_LED];
+static uint16_t frame_length[2];              /* bytes in each frame */
+static volatile uint8_t front_buffer = 0;     /* frame currently or last streamed out */
+static volatile bool playback_active = false; /* PWM is busy with the front buffer */
+static volatile bool frame_pending = false;   /* back buffer holds a frame waiting to be shown */
+static volatile int32_t stream_pos;           /* next frame byte to stream, negative in reset */
+static bool powered = true;                   /* NPVOUT on, frames are only written while it is */
+static uint16_t num_leds = NUM_LEDS;
+static rgb_color_t rgb_colors[WS2812_MAX_LEDS];
+static hsv_color_t hsv_colors[WS2812_MAX_LEDS];
+/* fraction of an output step left over from the last frame for each color byte */
+static uint8_t dither_error[WS2812_MAX_LEDS * BYTES_PER_LED];
+static bool dither_active = false; /* some color falls between output steps */
+static uint32_t budget_ua = WS2812_DEFAULT_BUDGET_MA * 1000;
+static uint32_t frame_current_ua = 0; /* estimated draw of the last frame written */
 static color_gen_mode_e mode = WS2812_STATIC;
-static hsv_color_t shifting_colors[2] = {{0, 250, 20}, {220, 250, 20}};
-bool ws2812_movement_flag = false;
-
-rgb_color_t hsv_to_rgb(hsv_color_t hsv);
-hsv_color_t rgb_to_hsv(rgb_color_t rgb);
-uint8_t lerp_8 (uint8_t a, uint8_t b, uint8_t t);
+static uint8_t phase = 0; /* phase of the current effect */
+static bool movement_flag = false;
+static effect_inputs_t inputs;
+static bool inputs_changed = false; /* since the last tick */
+static bool show_valid = false;     /* show_ms is the controller's show time */
+static uint32_t show_ms;
+/* ticks until the next ws2812_tick(), 0 while nothing is scheduled */
+static uint8_t tick_step = 1;
+static uint32_t tick_counts[WS2812_NUM_MODES]; /* ws2812_tick() calls in each mode */
+
+/* effect for each mode, built in. Kept in RAM so ws2812_set_transition() can change the color
+   shift */
+static effect_t effects[WS2812_NUM_MODES] = {
+    [WS2812_STATIC] = {EFFECT_TRACK_COLOR, EFFECT_TRACK_COLOR, EFFECT_TRACK_COLOR},
+    [WS2812_BLINK] = {.hue = EFFECT_TRACK_COLOR,
+                      .saturation = EFFECT_TRACK_COLOR,
+                      .value = {EFFECT_WAVE_SQUARE, EFFECT_SRC_CONST, 255, 0},
+                      .rate = 4},
+    [WS2812_PULSE] = {.hue = EFFECT_TRACK_COLOR,
+                      .saturation = EFFECT_TRACK_COLOR,
+                      .value = {EFFECT_WAVE_SINE, EFFECT_SRC_CONST, 0, 255},
+                      .rate = 2},
+    [WS2812_RAINBOW] = {.hue = {EFFECT_WAVE_RAMP, EFFECT_SRC_CONST, 0, 255},
+                        .saturation = EFFECT_TRACK_CONST(250),
+                        .value = EFFECT_TRACK_CONST(250),
+                        .rate = 2,
+                        .spread = 255},
+    /* lerp between the two hsv colors using sine curve, set by ws2812_set_transition() */
+    [WS2812_COLOR_SHIFT] = {.hue = {EFFECT_WAVE_SINE, EFFECT_SRC_CONST, 0, 220},
+                            .saturation = {EFFECT_WAVE_SINE, EFFECT_SRC_CONST, 250, 250},
+                            .value = {EFFECT_WAVE_SINE, EFFECT_SRC_CONST, 20, 20},
+                            .rate = 1},
+    [WS2812_CLAP_TOGGLE] = {.hue = {EFFECT_WAVE_RAMP, EFFECT_SRC_CONST, 0, 255},
+                            .saturation = EFFECT_TRACK_CONST(255),
+                            .value = EFFECT_TRACK_CONST(255),
+                            .trigger = EFFECT_TRIGGER_STEP,
+                            .step = 25},
+    /* full brightness on motion then fade out */
+    [WS2812_CLAP_PULSE] = {.hue = EFFECT_TRACK_COLOR,
+                           .saturation = EFFECT_TRACK_COLOR,
+                           .value = {EFFECT_WAVE_RAMP, EFFECT_SRC_CONST, 255, 1},
+                           .rate = 16,
+                           .trigger = EFFECT_TRIGGER_RESTART,
+                           .flags = EFFECT_ONESHOT},
+    [WS2812_WAVE_RAINBOW] = {.hue = {EFFECT_WAVE_RAMP, EFFECT_SRC_CONST, 0, 255},
+                             .saturation = EFFECT_TRACK_CONST(250),
+                             .value = EFFECT_TRACK_CONST(255),
+                             .trigger = EFFECT_TRIGGER_STEP,
+                             .step = 10},
+    [WS2812_TILT] = {.hue = {EFFECT_WAVE_RAMP, EFFECT_SRC_ROLL, 0, 255},
+                     .saturation = EFFECT_TRACK_CONST(255),
+                     .value = {EFFECT_WAVE_RAMP, EFFECT_SRC_PITCH, 20, 255}},
+};
+
+/* frame tracking so unchanged frames are not re-encoded or played back */
+static bool frame_dirty = true;  /* colors changed since last write */
+static bool frame_stale = true;  /* LEDs are not showing the last encoded frame */
+static uint32_t frame_hash = 0;  /* hash of the last encoded frame */
+static uint32_t frames_encoded = 0;
+static uint32_t frames_skipped = 0;
+#ifdef WS2812_VERIFY
+static volatile uint32_t verify_errors = 0; /* bytes that didn't decode back to the frame */
+#endif
 
 /* ####################### COLOR GENERATION ####################### */
+/* something changed that the next frame has to show, make sure a tick is coming soon */
+static void request_tick(void) {
+  if (powered && tick_step != 1) {
+    tick_step = 1;
+    led_wake_handler();
+  }
+}
+
 void ws2812_cycle_mode(void) {
   mode += 1;
   if (mode >= WS2812_NUM_MODES) {
     mode = 0;
   }
+  phase = effect_start_phase(&effects[mode]);
+  request_tick();
 }
 
 void ws2812_set_mode(color_gen_mode_e m) {
+  if (m == mode || m >= WS2812_NUM_MODES) {
+    return;
+  }
   mode = m;
+  phase = effect_start_phase(&effects[m]);
+  request_tick();
 }
 
 color_gen_mode_e ws2812_get_mode(void) {
   return mode;
 }
 
-void ws2812_tick(void) {
-  uint8_t i, blink_val;
-  uint8_t sine;
-  uint8_t shift_h, shift_s, shift_v;
-  // uint8_t larger_v;
+/* true if the mode reacts to motion or orientation, so the accelerometer needs to be active */
+bool ws2812_mode_uses_motion(color_gen_mode_e m) {
+  return effect_uses_motion(&effects[m]) || effect_uses_inputs(&effects[m]);
+}
 
-  static uint8_t clap_toggle_hue = 0;
-  static uint8_t clap_pulse_brightness = 0;
-  static uint8_t counter = 0;
+/* set the color an effect rendered for an LED, leaves the color it was set to alone */
+static void led_render(uint16_t index, rgb_color_t rgb) {
+  if (rgb.red != rgb_colors[index].red || rgb.green != rgb_colors[index].green ||
+      rgb.blue != rgb_colors[index].blue) {
+    rgb_colors[index] = rgb;
+    frame_dirty = true;
+  }
+}
 
-  switch (mode) {
-    case WS2812_STATIC:
-      for (i = 0; i < NUM_LEDS; i++) {
-        ws2812_set_rgb(i, rgb_colors[i].red, rgb_colors[i].green, rgb_colors[i].blue);
-        ws2812_write();
-      }
-      break;
-    case WS2812_BLINK:
-      counter += 2;
-      blink_val = (uint8_t)(counter * 2) > 128 ? 0 : 255;
-      for (i = 0; i < NUM_LEDS; i++) {
-        ws2812_set_hsv(i, hsv_colors[i].hue, hsv_colors[i].saturation, blink_val);
-        ws2812_write();
-      }
-      break;
-    case WS2812_PULSE:
-      counter += 2;
-      sine = sine_lut[counter];
-      for (i = 0; i < NUM_LEDS; i++) {
-        ws2812_set_hsv(i, hsv_colors[i].hue, hsv_colors[i].saturation, sine);
-        ws2812_write();
-      }
-      break;
-    case WS2812_RAINBOW:
-      counter += 2;
-      /* TODO: figure out why this is jittering so much */
-      ws2812_set_hsv(0, counter, 250, 250);
-      ws2812_write();
-      ws2812_set_hsv(1, counter + 84, 250, 250);
-      ws2812_write();
-      ws2812_set_hsv(2, counter + 172, 250, 250);
-      ws2812_write();
-      break;
-    case WS2812_COLOR_SHIFT:
-      /* lerp between the two hsv colors using sine curve 0-255 */
-      counter += 1;
-      sine = sine_lut[counter];
+/* motion event for the effects that react to it */
+void ws2812_detect_motion(void) {
+  if (effect_uses_motion(&effects[mode])) {
+    movement_flag = true;
+    request_tick();
+  }
+}
 
-      shift_h = lerp_8(shifting_colors[0].hue, shifting_colors[1].hue, sine);
-      shift_v = lerp_8(shifting_colors[0].saturation, shifting_colors[1].saturation, sine);
-      shift_s = lerp_8(shifting_colors[0].value, shifting_colors[1].value, sine);
+/* new sensor readings for effects that follow them. Only picked up by the next tick, and ticks
+   keep the effect tick rate while the inputs keep changing, so the LEDs are not written for every
+   sample */
+void ws2812_set_inputs(uint8_t roll, uint8_t pitch) {
+  if (roll == inputs.roll && pitch == inputs.pitch) {
+    return;
+  }
+  inputs.roll = roll;
+  inputs.pitch = pitch;
+  if (effect_uses_inputs(&effects[mode])) {
+    inputs_changed = true;
+    request_tick();
+  }
+}
 
-      ws2812_set_all_hsv(shift_h, shift_s, shift_v);
-      break;
-    case WS2812_CLAP_TOGGLE:
-      if (ws2812_movement_flag) {
-        clap_toggle_hue += 25;
-        ws2812_movement_flag = false;
-      }
-      ws2812_set_all_hsv(clap_toggle_hue, 255, 255);
-      break;
-    case WS2812_CLAP_PULSE:
-      if (ws2812_movement_flag) {
-        clap_pulse_brightness = 255;
-        ws2812_movement_flag = false;
-      } else {
-        if (clap_pulse_brightness > 16) {
-          clap_pulse_brightness -= 16;
-        } else {
-          clap_pulse_brightness = 1;
-        }
-      }
-      ws2812_set_all_hsv(hsv_colors[0].hue, hsv_colors[0].saturation, clap_pulse_brightness);
-      break;
-    case WS2812_WAVE_RAINBOW:
-      if (ws2812_movement_flag) {
-        clap_toggle_hue += 10;
-        ws2812_set_all_hsv(clap_toggle_hue, 250, 255);
-        ws2812_write();
-        ws2812_movement_flag = false;
-      }
-      break;
-    default:
-      break;
+/* controller's show time for the next tick, effects that only run on their own take their phase
+   from it so every bracelet in the show is in step */
+void ws2812_set_show_time(bool valid, uint32_t time_ms) {
+  show_valid = valid;
+  show_ms = time_ms;
+}
+
+/* true if the effect's phase follows the show time instead of its own ticks */
+static bool effect_follows_show(const effect_t* effect) {
+  return show_valid && effect->rate && !(effect->flags & EFFECT_ONESHOT) &&
+         !effect_uses_motion(effect);
+}
+
+/* advance the effect and write the frame, returns ms until the next tick should run or 0 if
+   nothing changes until the LEDs are set or motion is detected */
+uint32_t ws2812_tick(void) {
+  uint16_t i;
+  uint8_t led_phase;
+  const effect_t* effect = &effects[mode];
+
+  if (!powered) {
+    tick_step = 0;
+    return 0;
+  }
+  tick_counts[mode]++;
+  if (effect_follows_show(effect)) {
+    phase = effect_phase_at(effect, show_ms / WS2812_TICK_MS);
+  } else if (movement_flag && effect_uses_motion(effect)) {
+    phase = effect_trigger(effect, phase);
+  } else {
+    phase = effect_advance(effect, phase, tick_step);
+  }
+  movement_flag = false;
+
+  if (!effect_is_static(effect)) {
+    for (i = 0; i < num_leds; i++) {
+      led_phase = phase + (effect->spread * i) / num_leds;
+      led_render(i, hsv_to_rgb(effect_eval(effect, led_phase, hsv_colors[i], &inputs)));
+    }
+  }
+  /* static effects keep the colors the LEDs were set to, only drives the frame if they changed */
+  ws2812_write();
+
+  tick_step = effect_ticks_to_change(effect, phase);
+  /* inputs changed since the last tick, tick again at the normal rate instead of as soon as they
+     next change */
+  if (inputs_changed && tick_step != 1) {
+    tick_step = 1;
+  }
+  inputs_changed = false;
+  /* colors between output steps are dithered over frames, so keep refreshing */
+  if (dither_active && tick_step != 1) {
+    tick_step = 1;
+  }
+  /* land the next tick on a show time tick boundary */
+  if (tick_step && effect_follows_show(effect)) {
+    return tick_step * WS2812_TICK_MS - show_ms % WS2812_TICK_MS;
   }
+  return tick_step * WS2812_TICK_MS;
+}
+
+/* ws2812_tick() calls made in a mode since the last call */
+uint32_t ws2812_take_tick_count(color_gen_mode_e m) {
+  uint32_t count = tick_counts[m];
+  tick_counts[m] = 0;
+  return count;
 }
 
 //#define EYE_SAVER
+/* decode every byte streamed into the ring back out of the PWM values and check it against the
+   frame, adds a few us per LED to the PWM handler so only for debugging the encoder */
+//#define WS2812_VERIFY
 /* ######################### LED CONTROL ######################### */
-/* write rgb_colors array to pwm sequence array and start pwm playback */
-void ws2812_write(void) {
-  uint16_t i, j;
-  uint16_t seq_offset; /* offset for current sequence */
-
-  /* for each LED */
-  for (i = 0; i < (sizeof(rgb_colors) / sizeof(rgb_color_t)); i++) {
-    seq_offset = RESET_CYCLES + (i * CYCLES_PER_LED);
-    /* check bits for each color */
-    for (j = 0; j < 8; j++) {
-      /* clear last value and write polarity */
-      pwm_sequence_values[seq_offset + j + G_OFFSET] = PWM_FALLING_EDGE;
-      pwm_sequence_values[seq_offset + j + R_OFFSET] = PWM_FALLING_EDGE;
-      pwm_sequence_values[seq_offset + j + B_OFFSET] = PWM_FALLING_EDGE;
+/* PWM duty cycle value for bit n (MSB first) of byte b, polarity bit included */
+#define BIT_VALUE(b, n) \
+  (PWM_FALLING_EDGE | (((b) & (0x80 >> (n))) ? ONE_HIGH_TICKS : ZERO_HIGH_TICKS))
+#define BYTE_VALUES(b)                                                                    \
+  {                                                                                       \
+    BIT_VALUE(b, 0), BIT_VALUE(b, 1), BIT_VALUE(b, 2), BIT_VALUE(b, 3), BIT_VALUE(b, 4), \
+        BIT_VALUE(b, 5), BIT_VALUE(b, 6), BIT_VALUE(b, 7)                                 \
+  }
+#define BYTE_VALUES_4(b) BYTE_VALUES(b), BYTE_VALUES(b + 1), BYTE_VALUES(b + 2), BYTE_VALUES(b + 3)
+#define BYTE_VALUES_16(b) \
+  BYTE_VALUES_4(b), BYTE_VALUES_4(b + 4), BYTE_VALUES_4(b + 8), BYTE_VALUES_4(b + 12)
+#define BYTE_VALUES_64(b) \
+  BYTE_VALUES_16(b), BYTE_VALUES_16(b + 16), BYTE_VALUES_16(b + 32), BYTE_VALUES_16(b + 48)
+
+/* every possible color byte expanded into its 8 sequence values, 4kB of flash. Each row is
+   16 bytes and word aligned so copying a byte out is four word loads and stores */
+__ALIGN(4) static const nrf_pwm_values_common_t byte_lut[256][8] = {
+    BYTE_VALUES_64(0), BYTE_VALUES_64(64), BYTE_VALUES_64(128), BYTE_VALUES_64(192)};
+
+/* sequence values for the line held low, used for the reset and to pad out the last half */
+__ALIGN(4) static const nrf_pwm_values_common_t low_values[8] = {
+    PWM_FALLING_EDGE, PWM_FALLING_EDGE, PWM_FALLING_EDGE, PWM_FALLING_EDGE,
+    PWM_FALLING_EDGE, PWM_FALLING_EDGE, PWM_FALLING_EDGE, PWM_FALLING_EDGE};
+
+/* FNV-1a hash of length frame bytes */
+static uint32_t frame_hash_get(const uint8_t* bytes, uint16_t length) {
+  uint16_t i;
+  uint32_t hash = 2166136261U;
+
+  for (i = 0; i < length; i++) {
+    hash ^= bytes[i];
+    hash *= 16777619U;
+  }
+  return hash;
+}
+
+/* gamma correct a color into 16 bit linear light, LED current is proportional to this */
+static inline uint32_t color_level(uint8_t color) {
 #ifdef EYE_SAVER
-      /* green */
-      pwm_sequence_values[seq_offset + j + G_OFFSET] |=
-          (((rgb_colors[i].green / 4) & (0x80 >> j)) ? ONE_HIGH_TICKS : ZERO_HIGH_TICKS);
-      /* red */
-      pwm_sequence_values[seq_offset + j + R_OFFSET] |=
-          (((rgb_colors[i].red / 4) & (0x80 >> j)) ? ONE_HIGH_TICKS : ZERO_HIGH_TICKS);
-      /* blue */
-      pwm_sequence_values[seq_offset + j + B_OFFSET] |=
-          (((rgb_colors[i].blue / 4) & (0x80 >> j)) ? ONE_HIGH_TICKS : ZERO_HIGH_TICKS);
+  return gamma_lut[color] / 4;
 #else
-      /* green */
-      pwm_sequence_values[seq_offset + j + G_OFFSET] |=
-          ((rgb_colors[i].green & (0x80 >> j)) ? ONE_HIGH_TICKS : ZERO_HIGH_TICKS);
-      /* red */
-      pwm_sequence_values[seq_offset + j + R_OFFSET] |=
-          ((rgb_colors[i].red & (0x80 >> j)) ? ONE_HIGH_TICKS : ZERO_HIGH_TICKS);
-      /* blue */
-      pwm_sequence_values[seq_offset + j + B_OFFSET] |=
-          ((rgb_colors[i].blue & (0x80 >> j)) ? ONE_HIGH_TICKS : ZERO_HIGH_TICKS);
+  return gamma_lut[color];
 #endif
+}
+
+/* dither a 16 bit level back down to an 8 bit output, carrying what is left over into the
+   next frame so low levels average out between steps. Levels from WS2812_DITHER_LEVEL up, or any
+   level if dither is false, are rounded, fraction is only set if the output alternates between
+   frames */
+static inline uint8_t color_output(uint32_t level, bool dither, uint8_t* error,
+                                   uint8_t* fraction) {
+  if (level >= WS2812_DITHER_LEVEL || !dither) {
+    *error = 0;
+    level += 0x80;
+    return level > 0xFFFF ? 0xFF : level >> 8;
+  }
+  *fraction |= level & 0xFF;
+  level += *error;
+  *error = level & 0xFF;
+  return level > 0xFFFF ? 0xFF : level >> 8;
+}
+
+/* estimate the current the frame will draw and return how much it has to be scaled by to stay
+   inside the budget, 1 << 16 is full brightness */
+static uint32_t power_scale(void) {
+  uint16_t i;
+  uint32_t sum = 0;
+  uint32_t current_ua, idle_ua, available_ua, scale;
+
+  for (i = 0; i < num_leds; i++) {
+    sum += color_level(rgb_colors[i].red);
+    sum += color_level(rgb_colors[i].green);
+    sum += color_level(rgb_colors[i].blue);
+  }
+  /* sum / 65536 channels fully on, split the shift to stay inside 32 bits */
+  current_ua = ((sum >> 8) * WS2812_CHANNEL_UA) >> 8;
+  idle_ua = num_leds * WS2812_IDLE_UA;
+  available_ua = budget_ua > idle_ua ? budget_ua - idle_ua : 0;
+
+  if (current_ua <= available_ua) {
+    frame_current_ua = idle_ua + current_ua;
+    return 1 << 16;
+  }
+  scale = ((uint64_t)available_ua << 16) / current_ua;
+  frame_current_ua = idle_ua + available_ua;
+  return scale;
+}
+
+/* number of times the pair of ring halves is played back for a frame of length bytes */
+static uint16_t stream_loops(uint16_t length) {
+  uint16_t halves = (RESET_BYTES + length + RING_BYTES - 1) / RING_BYTES;
+  return (halves + 1) / 2;
+}
+
+#ifdef WS2812_VERIFY
+/* byte sent by 8 sequence values, -1 if any value isn't a valid one or zero bit */
+static int16_t byte_decode(const nrf_pwm_values_common_t* values) {
+  uint8_t n;
+  int16_t byte = 0;
+
+  for (n = 0; n < 8; n++) {
+    byte <<= 1;
+    if (values[n] == (PWM_FALLING_EDGE | ONE_HIGH_TICKS)) {
+      byte |= 1;
+    } else if (values[n] != (PWM_FALLING_EDGE | ZERO_HIGH_TICKS)) {
+      return -1;
     }
   }
+  return byte;
+}
+#endif
 
-  /* start playback */
-  nrf_drv_pwm_simple_playback(&pwm_instance, &pwm_sequence, 1, 0);
+/* fill one half of the ring with the next bytes of the front frame */
+static void ring_fill(nrf_pwm_values_common_t* seq) {
+  uint16_t i;
+  const uint8_t* bytes = frame_bytes[front_buffer];
+
+  for (i = 0; i < RING_BYTES; i++, stream_pos++) {
+    if (stream_pos >= 0 && stream_pos < frame_length[front_buffer]) {
+      memcpy(&seq[i * 8], byte_lut[bytes[stream_pos]], sizeof(byte_lut[0]));
+#ifdef WS2812_VERIFY
+      if (byte_decode(&seq[i * 8]) != bytes[stream_pos]) {
+        verify_errors++;
+      }
+#endif
+    } else {
+      memcpy(&seq[i * 8], low_values, sizeof(low_values));
+    }
+  }
+}
+
+/* start streaming the front frame out, starting with the reset */
+static void stream_start(void) {
+  stream_pos = -RESET_BYTES;
+  ring_fill(pwm_ring_values[0]);
+  ring_fill(pwm_ring_values[1]);
+  nrf_drv_pwm_complex_playback(
+      &pwm_instance, &pwm_sequences[0], &pwm_sequences[1],
+      stream_loops(frame_length[front_buffer]),
+      NRF_DRV_PWM_FLAG_SIGNAL_END_SEQ0 | NRF_DRV_PWM_FLAG_SIGNAL_END_SEQ1 | NRF_DRV_PWM_FLAG_STOP);
+}
+
+/* write rgb_colors array to the back frame and start streaming it out */
+/* skipped if the LEDs are already showing the same colors */
+void ws2812_write(void) {
+  uint16_t i;
+  uint8_t back;
+  uint8_t fraction = 0;
+  /* a static frame would never stop ticking if it were dithered */
+  bool dither = !effect_is_static(&effects[mode]);
+  bool was_pending;
+  uint32_t hash, scale;
+  uint8_t* bytes; /* frame bytes for current LED */
+  uint8_t* error; /* dither error for current LED */
+
+#ifdef WS2812_VERIFY
+  if (verify_errors) {
+    NRF_LOG_INFO("ws2812 verify failed, %d bad bytes", verify_errors);
+    verify_errors = 0;
+  }
+#endif
+  /* a dithered frame changes every write even if the colors don't */
+  if (!powered || (!frame_dirty && !frame_stale && !dither_active)) {
+    frames_skipped++;
+    return;
+  }
+  frame_dirty = false;
+
+  /* any frame still waiting in the back buffer is replaced by this one, make sure the PWM
+     handler doesn't swap it in while it is being rewritten */
+  CRITICAL_REGION_ENTER();
+  was_pending = frame_pending;
+  frame_pending = false;
+  CRITICAL_REGION_EXIT();
+  back = front_buffer ^ 1;
+  scale = power_scale();
+
+  /* for each LED store the colors in the order they are sent, G R B */
+  for (i = 0; i < num_leds; i++) {
+    bytes = &frame_bytes[back][i * BYTES_PER_LED];
+    error = &dither_error[i * BYTES_PER_LED];
+    bytes[G_OFFSET] = color_output((color_level(rgb_colors[i].green) * scale) >> 16, dither,
+                                   &error[G_OFFSET], &fraction);
+    bytes[R_OFFSET] = color_output((color_level(rgb_colors[i].red) * scale) >> 16, dither,
+                                   &error[R_OFFSET], &fraction);
+    bytes[B_OFFSET] = color_output((color_level(rgb_colors[i].blue) * scale) >> 16, dither,
+                                   &error[B_OFFSET], &fraction);
+  }
+  frame_length[back] = num_leds * BYTES_PER_LED;
+  dither_active = fraction != 0;
+
+  /* colors may have been changed and changed back, or dithered to the same output. A frame
+     that was waiting got overwritten with the same bytes so it still has to go out */
+  hash = frame_hash_get(frame_bytes[back], frame_length[back]);
+  if (hash == frame_hash && !frame_stale && !was_pending) {
+    frames_skipped++;
+    return;
+  }
+  frame_hash = hash;
+  frame_stale = false;
+  frames_encoded++;
+
+  /* start playback now if the PWM is idle, otherwise swap when the current frame ends */
+  CRITICAL_REGION_ENTER();
+  if (playback_active) {
+    frame_pending = true;
+  } else {
+    front_buffer = back;
+    playback_active = true;
+    stream_start();
+  }
+  CRITICAL_REGION_EXIT();
 }
 
 /* set the color for a single LED using red, green, blue */
 /* ws2812_write() must be called afterwards to drive the updated color to LED */
-void ws2812_set_rgb(uint8_t index, uint8_t red, uint8_t green, uint8_t blue) {
-  rgb_colors[index].red = red;
-  rgb_colors[index].green = green;
-  rgb_colors[index].blue = blue;
-  hsv_colors[index] = rgb_to_hsv(rgb_colors[index]);
+void ws2812_set_rgb(uint16_t index, uint8_t red, uint8_t green, uint8_t blue) {
+  rgb_color_t rgb = {red, green, blue};
+  hsv_colors[index] = rgb_to_hsv(rgb);
+  led_render(index, rgb);
+  request_tick();
 }
 
 /* set color for a single LED using hue, saturation, value */
 /* ws2812_write() must be called afterwards to drive the updated color to LED */
-void ws2812_set_hsv(uint8_t index, uint8_t hue, uint8_t saturation, uint8_t value) {
+void ws2812_set_hsv(uint16_t index, uint8_t hue, uint8_t saturation, uint8_t value) {
   hsv_colors[index].hue = hue;
   hsv_colors[index].saturation = saturation;
   hsv_colors[index].value = value;
-  rgb_colors[index] = hsv_to_rgb(hsv_colors[index]);
+  led_render(index, hsv_to_rgb(hsv_colors[index]));
+  request_tick();
 }
 
 /* sets all LEDs to the same rgb color and drives the updated color to the LEDs */
 void ws2812_set_all_rgb(uint8_t red, uint8_t green, uint8_t blue) {
-  uint8_t i;
-  for (i = 0; i < NUM_LEDS; i++) {
+  uint16_t i;
+  for (i = 0; i < num_leds; i++) {
     ws2812_set_rgb(i, red, green, blue);
   }
   ws2812_write();
@@ -195,8 +482,8 @@ void ws2812_set_all_rgb(uint8_t red, uint8_t green, uint8_t blue) {
 
 /* sets all LEDs to the same hsv color and drives the updated color to the LEDs */
 void ws2812_set_all_hsv(uint8_t h, uint8_t s, uint8_t v) {
-  uint8_t i;
-  for (i = 0; i < NUM_LEDS; i++) {
+  uint16_t i;
+  for (i = 0; i < num_leds; i++) {
     ws2812_set_hsv(i, h, s, v);
   }
   ws2812_write();
@@ -204,18 +491,111 @@ void ws2812_set_all_hsv(uint8_t h, uint8_t s, uint8_t v) {
 
 /* sets the hsv values for COLOR_SHIFT */
 void ws2812_set_transition(uint8_t h1, uint8_t s1, uint8_t v1, uint8_t h2, uint8_t s2, uint8_t v2) {
-  shifting_colors[0] = (hsv_color_t){h1, s1, v1};
-  shifting_colors[1] = (hsv_color_t){h2, s2, v2};
+  effect_t* shift = &effects[WS2812_COLOR_SHIFT];
+  shift->hue.start = h1;
+  shift->hue.end = h2;
+  shift->saturation.start = s1;
+  shift->saturation.end = s2;
+  shift->value.start = v1;
+  shift->value.end = v2;
+  if (mode == WS2812_COLOR_SHIFT) {
+    request_tick();
+  }
 }
 
 /* shut off power to all LEDs */
+/* the frame being streamed is dropped and nothing is written or ticked until ws2812_on(), a
+   tick already scheduled returns without scheduling another */
 void ws2812_off(void) {
   nrf_gpio_pin_clear(NPVOUT);
+  powered = false;
+  CRITICAL_REGION_ENTER();
+  frame_pending = false;
+  CRITICAL_REGION_EXIT();
+  if (playback_active) {
+    nrf_drv_pwm_stop(&pwm_instance, false);
+  }
 }
 
 /* turn on power to all LEDs */
+/* LEDs come up dark, so the next ws2812_write() has to drive the frame again */
 void ws2812_on(void) {
   nrf_gpio_pin_set(NPVOUT);
+  frame_stale = true;
+  /* no tick is scheduled while off, start them again */
+  if (!powered) {
+    powered = true;
+    tick_step = 0;
+  }
+  request_tick();
+}
+
+/* set the most current the LEDs are allowed to draw, frames over it are dimmed to fit */
+void ws2812_set_power_budget(uint16_t milliamps) {
+  if (budget_ua == milliamps * 1000U) {
+    return;
+  }
+  budget_ua = milliamps * 1000U;
+  frame_dirty = true;
+  request_tick();
+}
+
+/* estimated current drawn by the LEDs for the last frame written */
+uint32_t ws2812_get_current_ua(void) {
+  return frame_current_ua;
+}
+
+/* set the number of LEDs in the chain, takes effect on the next ws2812_write() */
+void ws2812_set_num_leds(uint16_t n) {
+  if (n == 0 || n > WS2812_MAX_LEDS) {
+    NRF_LOG_INFO("invalid chain length %d", n);
+    return;
+  }
+  num_leds = n;
+  frame_stale = true;
+  request_tick();
+  NRF_LOG_INFO("chain length %d, frame time %dus", n, ws2812_frame_time_us());
+}
+
+uint16_t ws2812_get_num_leds(void) {
+  return num_leds;
+}
+
+/* time to stream out a frame for the current chain length, including the reset */
+uint32_t ws2812_frame_time_us(void) {
+  /* each cycle is 1.25us */
+  return ((uint32_t)stream_loops(num_leds * BYTES_PER_LED) * 2 * RING_CYCLES * 5) / 4;
+}
+
+/* number of frames driven to the LEDs and number skipped because nothing changed */
+void ws2812_get_frame_stats(uint32_t* encoded, uint32_t* skipped) {
+  *encoded = frames_encoded;
+  *skipped = frames_skipped;
+}
+
+/* ######################### EVENT HANDLERS ######################### */
+/* refill each half of the ring as soon as it has played, and swap in the back buffer if a new
+   frame is waiting once the front buffer has been streamed out */
+static void pwm_handler(nrf_drv_pwm_evt_type_t event_type) {
+  switch (event_type) {
+    case NRF_DRV_PWM_EVT_END_SEQ0:
+      ring_fill(pwm_ring_values[0]);
+      break;
+    case NRF_DRV_PWM_EVT_END_SEQ1:
+      ring_fill(pwm_ring_values[1]);
+      break;
+    case NRF_DRV_PWM_EVT_STOPPED:
+      if (frame_pending) {
+        frame_pending = false;
+        front_buffer ^= 1;
+        stream_start();
+      } else {
+        playback_active = false;
+      }
+      break;
+    default:
+      break;
+  }
 }
 
 /* ######################### INITIALIZATION ######################### */
@@ -224,16 +604,19 @@ void pwm_init(void) {
   uint16_t i;
   nrf_drv_pwm_config_t pwm_config;
 
-  pwm_sequence.values.p_common = pwm_sequence_values;
-  pwm_sequence.length = NRF_PWM_VALUES_LENGTH(pwm_sequence_values);
-  pwm_sequence.repeats = 0;
-  pwm_sequence.end_delay = 0;
+  for (i = 0; i < 2; i++) {
+    pwm_sequences[i].values.p_common = pwm_ring_values[i];
+    pwm_sequences[i].length = NRF_PWM_VALUES_LENGTH(pwm_ring_values[i]);
+    pwm_sequences[i].repeats = 0;
+    pwm_sequences[i].end_delay = 0;
+  }
 
   pwm_config.output_pins[0] = NPDOUT;
   pwm_config.output_pins[1] = NRF_DRV_PWM_PIN_NOT_USED;
   pwm_config.output_pins[2] = NRF_DRV_PWM_PIN_NOT_USED;
   pwm_config.output_pins[3] = NRF_DRV_PWM_PIN_NOT_USED;
-  pwm_config.irq_priority = APP_IRQ_PRIORITY_LOW;
+  /* ring refills have to keep up with playback */
+  pwm_config.irq_priority = APP_IRQ_PRIORITY_HIGH;
   pwm_config.base_clock = NRF_PWM_CLK_16MHz;
   pwm_config.count_mode = NRF_PWM_MODE_UP;
   pwm_config.top_value = CYCLE_TICKS;
@@ -241,13 +624,8 @@ void pwm_init(void) {
   pwm_config.step_mode = NRF_PWM_STEP_AUTO;
 
   nrf_gpio_cfg_output(NPDOUT);
-  ret_code = nrf_drv_pwm_init(&pwm_instance, &pwm_config, NULL);
+  ret_code = nrf_drv_pwm_init(&pwm_instance, &pwm_config, pwm_handler);
   APP_ERROR_CHECK(ret_code);
-
-  /* set reset bits to 0% duty cycle */
-  for (i = 0; i < RESET_CYCLES; i++) {
-    pwm_sequence_values[i] = PWM_FALLING_EDGE;
-  }
 }
 
 void ws2812_init(void) {
@@ -255,110 +633,3 @@ void ws2812_init(void) {
   ws2812_on();
   pwm_init();
 }
-
-/* ######################### COLOR CONVERSION ######################### */
-
-/* converts [hue, saturation, value] color to [red, green, blue] */
-/* algorithm from: https://stackoverflow.com/a/14733008 */
-rgb_color_t hsv_to_rgb(hsv_color_t hsv) {
-  rgb_color_t rgb;
-  uint8_t region, remainder, p, q, t, r, g, b, h, s, v;
-  h = hsv.hue;
-  s = hsv.saturation;
-  v = hsv.value;
-
-  if (s == 0) {
-    r = v;
-    g = v;
-    b = v;
-  } else {
-    region = h / 43;
-    remainder = (h - (region * 43)) * 6;
-
-    p = (v * (255 - s)) >> 8;
-    q = (v * (255 - ((s * remainder) >> 8))) >> 8;
-    t = (v * (255 - ((s * (255 - remainder)) >> 8))) >> 8;
-
-    switch (region) {
-      case 0:
-        r = v;
-        g = t;
-        b = p;
-        break;
-      case 1:
-        r = q;
-        g = v;
-        b = p;
-        break;
-      case 2:
-        r = p;
-        g = v;
-        b = t;
-        break;
-      case 3:
-        r = p;
-        g = q;
-        b = v;
-        break;
-      case 4:
-        r = t;
-        g = p;
-        b = v;
-        break;
-      default:
-        r = v;
-        g = p;
-        b = q;
-        break;
-    }
-  }
-  rgb.red = r;
-  rgb.green = g;
-  rgb.blue = b;
-
-  return rgb;
-}
-
-/* converts [red, green, blue] color to [hue, saturation, value] */
-/* algorithm from: https://stackoverflow.com/a/14733008 */
-hsv_color_t rgb_to_hsv(rgb_color_t rgb) {
-  hsv_color_t hsv;
-  uint8_t min, max, r, g, b, h, s, v;
-
-  r = rgb.red;
-  g = rgb.green;
-  b = rgb.blue;
-
-  min = r < g ? (r < b ? r : b) : (g < b ? g : b);
-  max = r > g ? (r > b ? r : b) : (g > b ? g : b);
-
-  v = max;
-  s = 255 * (int64_t)(max - min) / v;
-
-  if (v == 0) {
-    h = 0;
-    s = 0;
-  } else if (s == 0) {
-    h = 0;
-  } else if (max == r) {
-    h = 0 + 43 * (g - b) / (max - min);
-  } else if (max == g) {
-    h = 85 + 43 * (b - r) / (max - min);
-  } else {
-    h = 171 + 43 * (r - g) / (max - min);
-  }
-
-  hsv.hue = h;
-  hsv.saturation = s;
-  hsv.value = v;
-
-  return hsv;
-}
-
-uint8_t lerp_8 (uint8_t a, uint8_t b, uint8_t t){
-  if(a > b){
-    return b + ((((float)(a-b))/255.0)*t);
-  } else {
-    return a + ((((float)(b-a))/255.0)*t);
-  }
-}
\ No newline at end of file
@@ -2,6 +2,8 @@
 #ifndef WS2812_H
 #define WS2812_H
 
+#include "color.h"
+
 #define NPDOUT 20 /* pin driving data in of first ws2812B */
 #define NPVOUT 18 /* pin driving low-side driver to control power to LEDs */
 /*
@@ -26,6 +28,11 @@ period. The period is set by the PWM top value if we set the PWM top value to be
 the length of a single bit (1.25us) then set the PWM peripheral to have a falling
 edge polarity we can control whether the bit is high or low with the duty cycle
 value.
+Holding a duty cycle value for every bit of a long chain takes 48 bytes per LED,
+so instead the sequence is streamed through a small ring. The ring is split into
+two halves that are played back as the PWM peripheral's two sequences, looping
+back and forth. When one half finishes playing (SEQEND) it is refilled with the
+next LEDs of the frame while the other half plays.
 */
 
 /* Using 16MHz PWM clock, 1 tick = 62.5ns */
@@ -34,27 +41,31 @@ value.
 #define RESET_CYCLES (RESET_TICKS / CYCLE_TICKS)
 #define ONE_HIGH_TICKS 13 /* 0.8us/62.5ns  = 12.8. 13 ticks = 0.8125us */
 #define ZERO_HIGH_TICKS 6 /* 0.4us/62.5ns  = 6.4.   6 ticks = 0.0.375us */
-#define NUM_LEDS 3
+#define RESET_BYTES ((RESET_CYCLES + 7) / 8) /* reset length rounded up to whole bytes */
+#define NUM_LEDS 3          /* default chain length, the LEDs on the bracelet */
+#define WS2812_MAX_LEDS 300 /* longest chain that can be set with ws2812_set_num_leds() */
+#define WS2812_TICK_MS 25   /* effect frame period, ticks are skipped while nothing changes */
+/* levels under 16 output steps are dithered while an effect animates, above that a step is under
+   7% and they are rounded instead. Static effects round every level so they don't need a tick
+   every frame */
+#define WS2812_DITHER_LEVEL 0x1000
+/* LEDs in each half of the ring, each half has to be refilled within the time it takes the
+   other half to play (30us per LED) so this trades RAM for tolerance to interrupt latency */
+#define RING_LEDS 8
 #define CYCLES_PER_LED 24
-#define CYCLES_PER_SEQUENCE (CYCLES_PER_LED * NUM_LEDS)
-#define TOTAL_CYCLES (CYCLES_PER_SEQUENCE + RESET_CYCLES)
+#define BYTES_PER_LED 3
+#define RING_BYTES (RING_LEDS * BYTES_PER_LED)
+#define RING_CYCLES (RING_LEDS * CYCLES_PER_LED)
+/* current draw used to keep frames inside the power budget */
+#define WS2812_CHANNEL_UA 12000 /* one color channel fully on */
+#define WS2812_IDLE_UA 600      /* each LED with all channels off */
+#define WS2812_DEFAULT_BUDGET_MA 120
 /* top bit of 16 bit sequence value controls polarity */
-#define PWM_FALLING_EDGE 0x8000; /* 1 = falling edge, 0 is rising edge */
+#define PWM_FALLING_EDGE 0x8000 /* 1 = falling edge, 0 is rising edge */
+/* byte offset of each color in the 24 bit sequence of an LED */
 #define G_OFFSET 0
-#define R_OFFSET 8
-#define B_OFFSET 16
-
-typedef struct rgb_color {
-  uint8_t red;
-  uint8_t green;
-  uint8_t blue;
-} rgb_color_t;
-
-typedef struct hsv_color {
-  uint8_t hue;
-  uint8_t saturation;
-  uint8_t value;
-} hsv_color_t;
+#define R_OFFSET 1
+#define B_OFFSET 2
 
 typedef enum color_gen_mode {
   WS2812_STATIC,
@@ -65,47 +76,39 @@ typedef enum color_gen_mode {
   WS2812_CLAP_TOGGLE,
   WS2812_CLAP_PULSE,
   WS2812_WAVE_RAINBOW,
+  WS2812_TILT, /* hue follows the wrist roll and brightness the pitch */
   WS2812_NUM_MODES
 } color_gen_mode_e;
 
 void ws2812_cycle_mode(void);
 void ws2812_set_mode(color_gen_mode_e m);
 color_gen_mode_e ws2812_get_mode(void);
+bool ws2812_mode_uses_motion(color_gen_mode_e m);
 
 void ws2812_init(void);
 void ws2812_off(void);
 void ws2812_on(void);
 
 void ws2812_set_all_rgb(uint8_t red, uint8_t green, uint8_t blue);
-void ws2812_set_rgb(uint8_t index, uint8_t red, uint8_t green, uint8_t blue);
+void ws2812_set_rgb(uint16_t index, uint8_t red, uint8_t green, uint8_t blue);
 
 void ws2812_set_all_hsv(uint8_t hue, uint8_t saturation, uint8_t value);
-void ws2812_set_hsv(uint8_t index, uint8_t hue, uint8_t saturation, uint8_t value);
+void ws2812_set_hsv(uint16_t index, uint8_t hue, uint8_t saturation, uint8_t value);
 void ws2812_set_transition(uint8_t h1, uint8_t s1, uint8_t v1, uint8_t h2, uint8_t s2, uint8_t v2);
 
 void ws2812_write(void);
-void ws2812_tick(void);
-void ws2812_detect_motion(void);
+uint32_t ws2812_tick(void);
+uint32_t ws2812_take_tick_count(color_gen_mode_e m);
+void ws2812_get_frame_stats(uint32_t* encoded, uint32_t* skipped);
 
-static const uint8_t sine_lut[256] = {
-    0x0,  0x0,  0x0,  0x1,  0x1,  0x1,  0x2,  0x2,  0x3,  0x4,  0x5,  0x5,  0x6,  0x7,  0x9,  0xa,
-    0xb,  0xc,  0xe,  0xf,  0x11, 0x12, 0x14, 0x15, 0x17, 0x19, 0x1b, 0x1d, 0x1f, 0x21, 0x23, 0x25,
-    0x28, 0x2a, 0x2c, 0x2f, 0x31, 0x34, 0x36, 0x39, 0x3b, 0x3e, 0x41, 0x43, 0x46, 0x49, 0x4c, 0x4f,
-    0x52, 0x55, 0x58, 0x5a, 0x5d, 0x61, 0x64, 0x67, 0x6a, 0x6d, 0x70, 0x73, 0x76, 0x79, 0x7c, 0x80,
-    0x83, 0x86, 0x89, 0x8c, 0x8f, 0x92, 0x95, 0x98, 0x9b, 0x9e, 0xa2, 0xa5, 0xa7, 0xaa, 0xad, 0xb0,
-    0xb3, 0xb6, 0xb9, 0xbc, 0xbe, 0xc1, 0xc4, 0xc6, 0xc9, 0xcb, 0xce, 0xd0, 0xd3, 0xd5, 0xd7, 0xda,
-    0xdc, 0xde, 0xe0, 0xe2, 0xe4, 0xe6, 0xe8, 0xea, 0xeb, 0xed, 0xee, 0xf0, 0xf1, 0xf3, 0xf4, 0xf5,
-    0xf6, 0xf8, 0xf9, 0xfa, 0xfa, 0xfb, 0xfc, 0xfd, 0xfd, 0xfe, 0xfe, 0xfe, 0xff, 0xff, 0xff, 0xff,
-    0xff, 0xff, 0xff, 0xfe, 0xfe, 0xfe, 0xfd, 0xfd, 0xfc, 0xfb, 0xfa, 0xfa, 0xf9, 0xf8, 0xf6, 0xf5,
-    0xf4, 0xf3, 0xf1, 0xf0, 0xee, 0xed, 0xeb, 0xea, 0xe8, 0xe6, 0xe4, 0xe2, 0xe0, 0xde, 0xdc, 0xda,
-    0xd7, 0xd5, 0xd3, 0xd0, 0xce, 0xcb, 0xc9, 0xc6, 0xc4, 0xc1, 0xbe, 0xbc, 0xb9, 0xb6, 0xb3, 0xb0,
-    0xad, 0xaa, 0xa7, 0xa5, 0xa2, 0x9e, 0x9b, 0x98, 0x95, 0x92, 0x8f, 0x8c, 0x89, 0x86, 0x83, 0x80,
-    0x7c, 0x79, 0x76, 0x73, 0x70, 0x6d, 0x6a, 0x67, 0x64, 0x61, 0x5d, 0x5a, 0x58, 0x55, 0x52, 0x4f,
-    0x4c, 0x49, 0x46, 0x43, 0x41, 0x3e, 0x3b, 0x39, 0x36, 0x34, 0x31, 0x2f, 0x2c, 0x2a, 0x28, 0x25,
-    0x23, 0x21, 0x1f, 0x1d, 0x1b, 0x19, 0x17, 0x15, 0x14, 0x12, 0x11, 0xf,  0xe,  0xc,  0xb,  0xa,
-    0x9,  0x7,  0x6,  0x5,  0x5,  0x4,  0x3,  0x2,  0x2,  0x1,  0x1,  0x1,  0x0,  0x0,  0x0,  0x0,
-};
+void ws2812_set_power_budget(uint16_t milliamps);
+uint32_t ws2812_get_current_ua(void);
 
-extern bool ws2812_movement_flag;
+void ws2812_set_num_leds(uint16_t n);
+uint16_t ws2812_get_num_leds(void);
+uint32_t ws2812_frame_time_us(void);
+void ws2812_detect_motion(void);
+void ws2812_set_inputs(uint8_t roll, uint8_t pitch);
+void ws2812_set_show_time(bool valid, uint32_t time_ms);
 
 #endif /* WS2812_H */
\ No newline at end of file
@@ -10,12 +10,20 @@
 #define CHAN_PERIOD 1024  // The period in /32768
 #define RF_FREQ 66
 #define NUM_CHANNELS 2
-#define GROUPS_PER_CHANNEL 3
+// groups are sent a page at a time, see wire.h
+#define GROUPS_PER_PAGE 2
+#define PAGES_PER_CHANNEL 60
+#define GROUPS_PER_CHANNEL (GROUPS_PER_PAGE * PAGES_PER_CHANNEL)
+#define MAX_GROUPS (NUM_CHANNELS * GROUPS_PER_CHANNEL)  // group ids are stored in one byte
 
 #define GROUP_TO_CHANNEL(group_id) (group_id / GROUPS_PER_CHANNEL)
-#define GROUP_TO_INDEX(group_id) (group_id % GROUPS_PER_CHANNEL)
+#define GROUP_TO_PAGE(group_id) ((group_id % GROUPS_PER_CHANNEL) / GROUPS_PER_PAGE)
+#define GROUP_TO_INDEX(group_id) (group_id % GROUPS_PER_PAGE)
 
-#define VALID_GROUP(g) (g <= (NUM_CHANNELS * GROUPS_PER_CHANNEL) && g > 0)
+// cues waiting on each controller channel and on each bracelet, see wire.h
+#define MAX_CUES 8
+
+#define VALID_GROUP(g) ((g) < MAX_GROUPS)
 typedef struct group_data {
   uint32_t control;
   uint32_t red;
@@ -23,15 +31,6 @@ typedef struct group_data {
   uint32_t blue;
 } group_data_t;
 
-union payload {
-  uint8_t values[8];
-  uint64_t combined;
-};
-
-#define GROUP_A_DATA(payload) (payload & 0x1fffff)
-#define GROUP_B_DATA(payload) ((payload >> 21) & 0x1fffff)
-#define GROUP_C_DATA(payload) ((payload >> 42) & 0x1fffff)
-
 #define GROUP_CONTROL(data) ((uint8_t)((data & 0x1f0000) >> 16))
 #define GROUP_RED(data) ((uint8_t)((data & 0xf800) >> 11))
 #define GROUP_GREEN(data) ((uint8_t)((data & 0x7e0) >> 5))
@@ -1,7 +1,10 @@
+#include <stdbool.h>
 #include <stdint.h>
 #include <string.h>
 
 #include "app_error.h"
+#include "app_timer.h"
+#include "app_util_platform.h"
 
 #include "nrf_log.h"
 #include "nrf_pwr_mgmt.h"
@@ -18,15 +21,279 @@
 
 #include "common.h"
 #include "controller_ant.h"
+#include "wire.h"
 
 #define APP_ANT_OBSERVER_PRIO 1
 
-group_data_t groups[NUM_CHANNELS * GROUPS_PER_CHANNEL];
+#define DIRTY_BYTES ((GROUPS_PER_CHANNEL + 7) / 8)
+
+typedef struct cue_slot {
+  uint32_t time;  // show time the cue applies at
+  group_data_t data;
+  uint8_t index;  // group within the channel
+  uint8_t sends;  // repeats still to send
+} cue_slot_t;
+
+group_data_t groups[MAX_GROUPS];
+// groups changed but not sent yet, bit per group of each channel
+static uint8_t dirty[NUM_CHANNELS][DIRTY_BYTES];
+static uint8_t dirty_count[NUM_CHANNELS];
+static uint8_t dirty_scan[NUM_CHANNELS];  // dirty groups are taken round robin from here
+// keyframe page each channel's rotation is on
+static uint8_t rotation[NUM_CHANNELS];
+static uint8_t since_keyframe[NUM_CHANNELS];  // messages since the last keyframe
+// what the tx buffer of each channel holds
+static bool keyframe_pending[NUM_CHANNELS];   // a keyframe, rotation moves on once it is sent
+static bool idle_pending[NUM_CHANNELS];       // a keyframe only because nothing was dirty
+static uint8_t parity_pending[NUM_CHANNELS];  // parity covering this many changes, or 0
+static uint8_t seq[NUM_CHANNELS];
+static uint8_t since_time[NUM_CHANNELS];  // messages since the last time message
+// change messages in a row since anything else, up to WIRE_PARITY_SPAN, and the latest of them
+// round from parity_head, for the next parity message
+static uint8_t parity_run[NUM_CHANNELS];
+static uint8_t parity_head[NUM_CHANNELS];
+static uint8_t parity_last[NUM_CHANNELS][WIRE_PARITY_SPAN][WIRE_PAYLOAD_SIZE];
+static uint32_t tx_time[NUM_CHANNELS];    // show time of each channel's last EVENT_TX
+static uint32_t show_time;                // 1/32768s, shared by every channel
+static uint32_t show_time_ticks;          // app_timer counter at show_time
+// cues waiting for their time on each channel, unordered
+static cue_slot_t cues[NUM_CHANNELS][MAX_CUES];
+static uint8_t cue_count[NUM_CHANNELS];
+
+// show time now, from the app_timer which runs at half the rate
+static uint32_t show_time_get(void) {
+  uint32_t ticks, now;
+  CRITICAL_REGION_ENTER();
+  ticks = app_timer_cnt_get();
+  show_time += app_timer_cnt_diff_compute(ticks, show_time_ticks) * (32768 / APP_TIMER_CLOCK_FREQ);
+  show_time_ticks = ticks;
+  now = show_time;
+  CRITICAL_REGION_EXIT();
+  return now;
+}
+
+// set a group's data, false if it already had it
+static bool group_set(uint8_t group, const group_data_t* data) {
+  if (groups[group].control == data->control && groups[group].red == data->red &&
+      groups[group].green == data->green && groups[group].blue == data->blue) {
+    return false;
+  }
+  groups[group] = *data;
+  return true;
+}
+
+// group data from the 8 bit colors the host sends
+static group_data_t group_data(uint8_t control, uint8_t red, uint8_t green, uint8_t blue) {
+  group_data_t data = {
+      .control = control & 0x1F,  // 5 bits
+      .red = red >> 3,            // 8 bit to 5 bit
+      .green = green >> 2,
+      .blue = blue >> 3,
+  };
+  return data;
+}
+
+static bool dirty_get(uint8_t channel, uint8_t index) {
+  return dirty[channel][index / 8] & (1 << (index % 8));
+}
+
+static void dirty_set(uint8_t channel, uint8_t index) {
+  if (!dirty_get(channel, index)) {
+    dirty[channel][index / 8] |= 1 << (index % 8);
+    dirty_count[channel]++;
+  }
+}
+
+static void dirty_clear(uint8_t channel, uint8_t index) {
+  if (dirty_get(channel, index)) {
+    dirty[channel][index / 8] &= ~(1 << (index % 8));
+    dirty_count[channel]--;
+  }
+}
+
+// next dirty group after the last one taken, so one busy group can't hold up the rest
+static uint8_t dirty_take(uint8_t channel) {
+  uint8_t index = dirty_scan[channel];
+  while (!dirty_get(channel, index)) {
+    index = (index + 1) % GROUPS_PER_CHANNEL;
+  }
+  dirty_clear(channel, index);
+  dirty_scan[channel] = (index + 1) % GROUPS_PER_CHANNEL;
+  return index;
+}
+
+// full state of the next page of the rotation, dirty groups on it are sent with it
+static void keyframe_send(uint8_t channel) {
+  uint8_t payload[WIRE_PAYLOAD_SIZE];
+  uint8_t page = rotation[channel];
+  uint8_t first = page * GROUPS_PER_PAGE;
+  uint8_t changed = 0;
+
+  for (uint8_t i = 0; i < GROUPS_PER_PAGE; i++) {
+    if (dirty_get(channel, first + i)) {
+      dirty_clear(channel, first + i);
+      changed |= 1 << i;
+    }
+  }
+  wire_encode_page(payload, seq[channel]++, page, &groups[channel * GROUPS_PER_CHANNEL + first],
+                   changed);
+  ret_code_t ret_code = sd_ant_broadcast_message_tx(channel, WIRE_PAYLOAD_SIZE, payload);
+  APP_ERROR_CHECK(ret_code);
+}
+
+// change records for the next dirty groups
+static void changes_send(uint8_t channel) {
+  uint8_t payload[WIRE_PAYLOAD_SIZE];
+  uint8_t indexes[WIRE_CHANGES_PER_MESSAGE];
+  uint8_t count = 0;
+
+  while (count < WIRE_CHANGES_PER_MESSAGE && dirty_count[channel]) {
+    indexes[count++] = dirty_take(channel);
+  }
+  wire_encode_changes(payload, seq[channel]++, &groups[channel * GROUPS_PER_CHANNEL], indexes,
+                      count);
+  memcpy(parity_last[channel][parity_head[channel]], payload, WIRE_PAYLOAD_SIZE);
+  parity_head[channel] = (parity_head[channel] + 1) % WIRE_PARITY_SPAN;
+  if (parity_run[channel] < WIRE_PARITY_SPAN) {
+    parity_run[channel]++;
+  }
+  ret_code_t ret_code = sd_ant_broadcast_message_tx(channel, WIRE_PAYLOAD_SIZE, payload);
+  APP_ERROR_CHECK(ret_code);
+}
+
+// parity of the latest change messages of the run just sent, so a bracelet that missed one of
+// them can rebuild it
+static void parity_send(uint8_t channel) {
+  uint8_t payload[WIRE_PAYLOAD_SIZE];
+  uint8_t xor[WIRE_PAYLOAD_SIZE] = {0};
+  for (uint8_t i = 1; i <= parity_run[channel]; i++) {
+    uint8_t* last = parity_last[channel][(parity_head[channel] + WIRE_PARITY_SPAN - i) %
+                                         WIRE_PARITY_SPAN];
+    for (uint8_t j = 1; j < WIRE_PAYLOAD_SIZE; j++) {
+      xor[j] ^= last[j];
+    }
+  }
+  wire_encode_parity(payload, seq[channel]++, parity_run[channel], xor);
+  parity_pending[channel] = parity_run[channel];
+  parity_run[channel] = 0;
+  ret_code_t ret_code = sd_ant_broadcast_message_tx(channel, WIRE_PAYLOAD_SIZE, payload);
+  APP_ERROR_CHECK(ret_code);
+}
+
+// cue to send next, the one with the most repeats left so repeats of different cues are spread out
+// rather than lost to one burst of interference, NULL once every repeat has gone out
+static cue_slot_t* cue_next(uint8_t channel) {
+  cue_slot_t* next = NULL;
+  for (uint8_t i = 0; i < cue_count[channel]; i++) {
+    cue_slot_t* cue = &cues[channel][i];
+    if (cue->sends && (!next || cue->sends > next->sends ||
+                       (cue->sends == next->sends && (int32_t)(cue->time - next->time) < 0))) {
+      next = cue;
+    }
+  }
+  return next;
+}
+
+static void cue_send(uint8_t channel, cue_slot_t* cue) {
+  uint8_t payload[WIRE_PAYLOAD_SIZE];
+  wire_encode_cue(payload, seq[channel]++, cue->index, &cue->data, cue->time);
+  cue->sends--;
+  ret_code_t ret_code = sd_ant_broadcast_message_tx(channel, WIRE_PAYLOAD_SIZE, payload);
+  APP_ERROR_CHECK(ret_code);
+}
+
+// cues whose time has passed apply to the groups in the order they were due, and go out again as
+// changes for bracelets that missed every repeat
+static void cues_apply(uint8_t channel, uint32_t now) {
+  for (;;) {
+    cue_slot_t* due = NULL;
+    for (uint8_t i = 0; i < cue_count[channel]; i++) {
+      cue_slot_t* cue = &cues[channel][i];
+      if ((int32_t)(cue->time - now) <= 0 && (!due || (int32_t)(cue->time - due->time) < 0)) {
+        due = cue;
+      }
+    }
+    if (!due) {
+      return;
+    }
+    if (group_set(channel * GROUPS_PER_CHANNEL + due->index, &due->data)) {
+      dirty_set(channel, due->index);
+    }
+    *due = cues[channel][--cue_count[channel]];
+  }
+}
+
+// time message for bracelets to set their clocks by. The message goes out one channel period
+// after the last one did
+static void time_send(uint8_t channel) {
+  uint8_t payload[WIRE_PAYLOAD_SIZE];
+  wire_encode_time(payload, seq[channel]++, tx_time[channel] + CHAN_PERIOD);
+  ret_code_t ret_code = sd_ant_broadcast_message_tx(channel, WIRE_PAYLOAD_SIZE, payload);
+  APP_ERROR_CHECK(ret_code);
+}
+
+// true if the next message would be changes, see message_next()
+static bool changes_next(uint8_t channel) {
+  return since_time[channel] < WIRE_TIME_EVERY && !cue_next(channel) && dirty_count[channel] &&
+         since_keyframe[channel] + 1 < WIRE_KEYFRAME_EVERY;
+}
+
+// set the next message of a channel, a time message every WIRE_TIME_EVERY, then cues until every
+// repeat is out, changes while there are any but a keyframe at least every WIRE_KEYFRAME_EVERY
+// messages so bracelets that join late or miss a change still converge. Parity goes out after a
+// run of changes only once nothing is dirty, so it never holds a change back, and doesn't count
+// towards the keyframe
+static void message_next(uint8_t channel) {
+  cue_slot_t* cue;
+  since_time[channel]++;
+  parity_pending[channel] = 0;
+  if (since_time[channel] >= WIRE_TIME_EVERY) {
+    time_send(channel);
+    since_time[channel] = 0;
+    since_keyframe[channel]++;
+    parity_run[channel] = 0;
+    keyframe_pending[channel] = false;
+    idle_pending[channel] = false;
+  } else if ((cue = cue_next(channel)) != NULL) {
+    cue_send(channel, cue);
+    since_keyframe[channel]++;
+    parity_run[channel] = 0;
+    keyframe_pending[channel] = false;
+    idle_pending[channel] = false;
+  } else if (changes_next(channel)) {
+    changes_send(channel);
+    since_keyframe[channel]++;
+    keyframe_pending[channel] = false;
+    idle_pending[channel] = false;
+  } else if (WIRE_PARITY && parity_run[channel] && !dirty_count[channel]) {
+    parity_send(channel);
+    keyframe_pending[channel] = false;
+    idle_pending[channel] = false;
+  } else {
+    idle_pending[channel] = dirty_count[channel] == 0;
+    keyframe_send(channel);
+    since_keyframe[channel] = 0;
+    parity_run[channel] = 0;
+    keyframe_pending[channel] = true;
+  }
+}
 
 void ant_evt_handler(ant_evt_t* p_ant_evt, void* p_context) {
+  uint8_t channel = p_ant_evt->channel;
   nrf_pwr_mgmt_feed();  // indicate that there is activity
   switch (p_ant_evt->event) {
     case EVENT_TX:
+      if (channel >= NUM_CHANNELS) {
+        break;
+      }
+      tx_time[channel] = show_time_get();
+      // the message set now goes out a period later, it has to carry any cue due by then or it
+      // would undo the cue on bracelets that already applied it
+      cues_apply(channel, tx_time[channel] + CHAN_PERIOD);
+      if (keyframe_pending[channel]) {
+        rotation[channel] = (rotation[channel] + 1) % PAGES_PER_CHANNEL;
+      }
+      message_next(channel);
       break;
     default:
       break;
@@ -52,8 +319,8 @@ static void ant_tx_broadcast_setup(void) {
     APP_ERROR_CHECK(ret_code);
 
     // Fill tx buffer for the first frame.
-    NRF_LOG_INFO("ant_update_payload");
-    ant_update_payload(i, 0, 0, 10, 0);
+    tx_time[i] = show_time_get();
+    message_next(i);
 
     // Open channel.
     NRF_LOG_INFO("sd_ant_channel_open");
@@ -66,31 +333,80 @@ static void ant_tx_broadcast_setup(void) {
   }
 }
 
+// nothing was waiting to go out, send what just came in the next message rather than the one after.
+// Parity is only sent when nothing is dirty, so it gives way the same way and the change carries
+// on its run
+static void message_refresh(uint8_t channel) {
+  if (parity_pending[channel]) {
+    parity_run[channel] = parity_pending[channel];
+    seq[channel]--;
+    since_time[channel]--;
+    message_next(channel);
+  } else if (idle_pending[channel]) {
+    keyframe_pending[channel] = false;
+    // the keyframe never went out, its sequence number times the message that replaces it
+    seq[channel]--;
+    since_time[channel]--;
+    message_next(channel);
+  }
+}
+
 void ant_update_payload(uint8_t group, uint8_t control, uint8_t red, uint8_t green, uint8_t blue) {
+  group_data_t data;
   uint8_t channel;
-  union payload message;
-  message.combined = 0;
 
-  if (group >= NUM_CHANNELS * GROUPS_PER_CHANNEL) {
+  if (group >= MAX_GROUPS) {
     return;
   }
 
   channel = GROUP_TO_CHANNEL(group);
+  data = group_data(control, red, green, blue);
 
-  // update data for group
-  groups[group].control = control & 0x1F;  // 5 bits
-  groups[group].red = red >> 3;            // 8 bit to 5 bit
-  groups[group].green = green >> 2;
-  groups[group].blue = blue >> 3;
-
-  // build payload
-  message.combined |= (uint64_t) GROUP_PACKED(groups[(channel*GROUPS_PER_CHANNEL) + 0]);      
-  message.combined |= (uint64_t) GROUP_PACKED(groups[(channel*GROUPS_PER_CHANNEL) + 1]) << 21;
-  message.combined |= (uint64_t) GROUP_PACKED(groups[(channel*GROUPS_PER_CHANNEL) + 2]) << 42;
-  // Broadcast the data.
-  ret_code_t ret_code =
-      sd_ant_broadcast_message_tx(channel, ANT_STANDARD_DATA_PAYLOAD_SIZE, message.values);
-  APP_ERROR_CHECK(ret_code);
+  // called from the main loop, the EVENT_TX handler reads and loads the same state
+  CRITICAL_REGION_ENTER();
+  // only changes are sent, repeating a group's state is left to the keyframes
+  if (group_set(group, &data)) {
+    dirty_set(channel, group % GROUPS_PER_CHANNEL);
+    message_refresh(channel);
+  }
+  CRITICAL_REGION_EXIT();
+}
+
+// set a group's data delay_ms from now instead of straight away, every bracelet of the group
+// switches at the same time whatever it has missed. Delays under WIRE_CUE_MIN_LEAD are stretched
+// to it, and with MAX_CUES waiting on the channel the data is set straight away instead
+void ant_cue_payload(uint8_t group, uint8_t control, uint8_t red, uint8_t green, uint8_t blue,
+                     uint16_t delay_ms) {
+  uint32_t delay = ((uint32_t)delay_ms * 32768) / 1000;
+  uint8_t channel;
+  cue_slot_t cue;
+  bool full;
+
+  if (group >= MAX_GROUPS) {
+    return;
+  }
+  channel = GROUP_TO_CHANNEL(group);
+  if (delay < WIRE_CUE_MIN_LEAD) {
+    delay = WIRE_CUE_MIN_LEAD;
+  }
+  cue.time = show_time_get() + delay;
+  cue.data = group_data(control, red, green, blue);
+  cue.index = group % GROUPS_PER_CHANNEL;
+  cue.sends = WIRE_CUE_REPEATS;
+
+  // the EVENT_TX handler sends and removes cues, one only goes on the table once it is complete
+  CRITICAL_REGION_ENTER();
+  full = cue_count[channel] >= MAX_CUES;
+  if (!full) {
+    cues[channel][cue_count[channel]] = cue;
+    cue_count[channel]++;
+    message_refresh(channel);
+  }
+  CRITICAL_REGION_EXIT();
+  if (full) {
+    NRF_LOG_INFO("cues full on channel %d", channel);
+    ant_update_payload(group, control, red, green, blue);
+  }
 }
 
 void ant_init(void) {
@@ -4,5 +4,7 @@
 void ant_init(void);
 void ant_start(void);
 void ant_update_payload(uint8_t group, uint8_t control, uint8_t red, uint8_t green, uint8_t blue);
+void ant_cue_payload(uint8_t group, uint8_t control, uint8_t red, uint8_t green, uint8_t blue,
+                     uint16_t delay_ms);
 
 #endif  // CONTROLLER_ANT_H
\ No newline at end of file
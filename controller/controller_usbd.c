@@ -29,6 +29,8 @@
 #define CDC_DATA_ARRAY_LEN 256
 
 #define ENDLINE_STRING "\r\n"
+// group, control, red, green, blue, then a delay in ms little endian for a cue
+#define CUE_LINE_LEN 7
 
 // PRIVATE FUNCTION PROTOTYPES ------------
 static void cdc_acm_user_ev_handler(app_usbd_class_inst_t const* p_inst,
@@ -88,9 +90,15 @@ static void cdc_acm_user_ev_handler(app_usbd_class_inst_t const* p_inst,
               // write back
               ret_code_t ret =
                   app_usbd_cdc_acm_write(&m_app_cdc_acm, m_cdc_data_array, CDC_DATA_ARRAY_LEN);
-              // write to ant
-              ant_update_payload(m_cdc_data_array[0], m_cdc_data_array[1], m_cdc_data_array[2],
-                                 m_cdc_data_array[3], m_cdc_data_array[4]);
+              // write to ant, two more bytes are a delay in ms to cue the change for
+              if (index - 1 >= CUE_LINE_LEN) {
+                ant_cue_payload(m_cdc_data_array[0], m_cdc_data_array[1], m_cdc_data_array[2],
+                                m_cdc_data_array[3], m_cdc_data_array[4],
+                                (uint8_t)m_cdc_data_array[5] | ((uint8_t)m_cdc_data_array[6] << 8));
+              } else {
+                ant_update_payload(m_cdc_data_array[0], m_cdc_data_array[1], m_cdc_data_array[2],
+                                   m_cdc_data_array[3], m_cdc_data_array[4]);
+              }
               if (ret != NRF_SUCCESS) {
                 NRF_LOG_INFO("CDC ACM unavailable, data received: %s", m_cdc_data_array);
               }
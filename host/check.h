@@ -0,0 +1,47 @@
+/* Copyright (c) 2023  Hunter Whyte */
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+/*
+Helpers shared by the host tests and benchmarks. A test counts its failed checks and returns the
+count from main, so make check stops on the first test with a failure. Benchmarks time with the
+host's monotonic clock, the figures only compare implementations against each other on the same
+machine and say nothing about cycles on the nRF52.
+*/
+
+static int check_failures = 0;
+
+#define CHECK(cond, ...)                                    \
+  do {                                                      \
+    if (!(cond)) {                                          \
+      printf("FAIL %s:%d: ", __FILE__, __LINE__);           \
+      printf(__VA_ARGS__);                                  \
+      printf("\n");                                         \
+      check_failures++;                                     \
+    }                                                       \
+  } while (0)
+
+/* results are added into this so benchmarked calls can't be optimised away */
+static volatile uint32_t bench_sink;
+
+static inline uint64_t bench_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+/* pseudo random numbers that are the same on every run, xorshift32 */
+static inline uint32_t check_rand(uint32_t* state) {
+  uint32_t x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  *state = x;
+  return x;
+}
+
+#endif /* CHECK_H */
@@ -0,0 +1,249 @@
+/* Copyright (c) 2023  Hunter Whyte */
+/* the show clock across a crowd: the controller's scheduler (ctrl.h) broadcasts to 1000 show
+   clocks fed the way bracelet_ant.c feeds them, each with its own crystal drift, receive latency
+   and packet loss. Reports how long the crowd takes to come into phase and the phase error once
+   it has, at several loss rates and through a dropout. Then the whole firmware in the simulation
+   switches channel, where the sequence numbers of the new channel must not be timed from the
+   anchor of the old one */
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "check.h"
+#include "nrf_drv_gpiote.h"
+#include "nrf_sdh_ant.h"
+
+#include "bracelet.h"
+#include "bracelet_ant.h"
+#include "common.h"
+#include "ctrl.h"
+#include "showclock.h"
+#include "sim.h"
+#include "wire.h"
+
+#define BRACELETS 1000
+#define MAX_DRIFT_PPM 100         /* crystal error of each bracelet against the controller's */
+#define MAX_LATENCY_NS 500000     /* from the message on the air to the handler reading the time */
+#define RUN_NS (120 * SIM_S)
+#define SETTLED_NS (30 * SIM_S)   /* phase errors are only counted after this */
+#define SAMPLE_NS (100 * SIM_MS)
+#define DROPOUT_START_NS (90 * SIM_S) /* the dropout crowd receives nothing for DROPOUT_NS */
+#define DROPOUT_NS (10 * SIM_S)
+#define IN_PHASE_US 1000 /* a clock this close to the controller's counts as in phase */
+
+typedef struct bracelet {
+  showclock_t clock;
+  double rate;     /* local ticks per ns */
+  uint32_t offset; /* local ticks at time 0 */
+  uint64_t last_out_ns; /* last sample more than IN_PHASE_US out */
+} bracelet_t;
+
+typedef struct crowd {
+  const char* name;
+  uint32_t loss_percent;
+  bool dropout;
+  bracelet_t bracelets[BRACELETS];
+  double max_error_us;  /* after SETTLED_NS */
+  double sum_sq_error_us;
+  uint32_t samples;
+  double max_spread_us; /* widest range of errors across the crowd at one time */
+} crowd_t;
+
+static crowd_t crowds[] = {
+    {.name = "no loss", .loss_percent = 0},
+    {.name = "10% loss", .loss_percent = 10},
+    {.name = "30% loss", .loss_percent = 30},
+    {.name = "50% loss", .loss_percent = 50},
+    {.name = "10% + dropout", .loss_percent = 10, .dropout = true},
+};
+#define CROWDS (sizeof(crowds) / sizeof(crowds[0]))
+
+static uint32_t state = 1;
+
+static uint32_t local_ticks(const bracelet_t* bracelet, uint64_t time_ns) {
+  return bracelet->offset + (uint32_t)(uint64_t)(time_ns * bracelet->rate);
+}
+
+/* controller show time in 1/32768s */
+static double show_ticks(uint64_t time_ns) {
+  return time_ns * 32768.0 / SIM_S;
+}
+
+/* error of a bracelet's show time in us */
+static double error_us(const bracelet_t* bracelet, uint64_t time_ns) {
+  int32_t error = showclock_now(&bracelet->clock, local_ticks(bracelet, time_ns)) -
+                  (uint32_t)floor(show_ticks(time_ns));
+  return error * 1e6 / 32768;
+}
+
+/* ######################### CROWD ######################### */
+static void crowd_rx(uint8_t channel, const uint8_t payload[WIRE_PAYLOAD_SIZE], uint64_t time_ns,
+                     void* ctx) {
+  crowd_t* crowd;
+  bracelet_t* bracelet;
+  uint32_t i, show_time, local;
+
+  for (crowd = crowds; crowd < crowds + CROWDS; crowd++) {
+    if (crowd->dropout && time_ns >= DROPOUT_START_NS && time_ns < DROPOUT_START_NS + DROPOUT_NS) {
+      continue;
+    }
+    for (i = channel; i < BRACELETS; i += NUM_CHANNELS) {
+      if (check_rand(&state) % 100 < crowd->loss_percent) {
+        continue;
+      }
+      bracelet = &crowd->bracelets[i];
+      local = local_ticks(bracelet, time_ns + check_rand(&state) % MAX_LATENCY_NS);
+      /* as ant_evt_handler() */
+      if (wire_decode_time(payload, &show_time)) {
+        showclock_time(&bracelet->clock, local, WIRE_SEQ(payload), show_time);
+      } else {
+        showclock_message(&bracelet->clock, local, WIRE_SEQ(payload));
+      }
+    }
+  }
+}
+
+static void crowd_sample(uint64_t time_ns) {
+  crowd_t* crowd;
+  bracelet_t* bracelet;
+  double error, low, high;
+  uint32_t i;
+
+  for (crowd = crowds; crowd < crowds + CROWDS; crowd++) {
+    low = INFINITY;
+    high = -INFINITY;
+    for (i = 0; i < BRACELETS; i++) {
+      bracelet = &crowd->bracelets[i];
+      error = showclock_locked(&bracelet->clock) ? error_us(bracelet, time_ns) : INFINITY;
+      if (fabs(error) > IN_PHASE_US) {
+        bracelet->last_out_ns = time_ns;
+      }
+      if (time_ns < SETTLED_NS) {
+        continue;
+      }
+      low = fmin(low, error);
+      high = fmax(high, error);
+      crowd->max_error_us = fmax(crowd->max_error_us, fabs(error));
+      crowd->sum_sq_error_us += error * error;
+      crowd->samples++;
+    }
+    if (time_ns >= SETTLED_NS) {
+      crowd->max_spread_us = fmax(crowd->max_spread_us, high - low);
+    }
+  }
+}
+
+static void crowd_phase(void) {
+  crowd_t* crowd;
+  uint64_t time, in_phase_ns;
+  uint32_t i;
+  double drift;
+
+  for (crowd = crowds; crowd < crowds + CROWDS; crowd++) {
+    for (i = 0; i < BRACELETS; i++) {
+      drift = ((double)(check_rand(&state) % (2 * MAX_DRIFT_PPM * 100 + 1)) / 100 -
+               MAX_DRIFT_PPM) / 1e6;
+      crowd->bracelets[i].rate = SHOWCLOCK_LOCAL_HZ * (1 + drift) / SIM_S;
+      crowd->bracelets[i].offset = check_rand(&state);
+      showclock_reset(&crowd->bracelets[i].clock);
+    }
+  }
+
+  ctrl_start();
+  /* a sample is taken once everything sent before it has been received */
+  for (time = SAMPLE_NS; time <= RUN_NS; time += SAMPLE_NS) {
+    ctrl_run_until(time - MAX_LATENCY_NS, crowd_rx, NULL);
+    crowd_sample(time);
+  }
+
+  printf("%d show clocks over %ds, up to %dppm drift and %dus latency, phase error after %ds:\n",
+         BRACELETS, (int)(RUN_NS / SIM_S), MAX_DRIFT_PPM, MAX_LATENCY_NS / 1000,
+         (int)(SETTLED_NS / SIM_S));
+  printf("  %-14s %9s %9s %9s %9s\n", "crowd", "in phase", "rms", "max", "spread");
+  for (crowd = crowds; crowd < crowds + CROWDS; crowd++) {
+    in_phase_ns = 0;
+    for (i = 0; i < BRACELETS; i++) {
+      if (crowd->bracelets[i].last_out_ns > in_phase_ns) {
+        in_phase_ns = crowd->bracelets[i].last_out_ns;
+      }
+    }
+    printf("  %-14s %7.1fs %6.0fus %6.0fus %6.0fus\n", crowd->name, (double)in_phase_ns / SIM_S,
+           sqrt(crowd->sum_sq_error_us / crowd->samples), crowd->max_error_us,
+           crowd->max_spread_us);
+    CHECK(crowd->max_error_us < IN_PHASE_US, "%s: %.0fus out of phase", crowd->name,
+          crowd->max_error_us);
+    CHECK(in_phase_ns < SETTLED_NS, "%s: in phase after %.1fs", crowd->name,
+          (double)in_phase_ns / SIM_S);
+  }
+}
+
+/* ######################### CHANNEL SWITCH ######################### */
+static double max_error_us;
+
+/* messages reach the bracelet on whichever channel it has open */
+static void sim_rx(uint8_t channel, const uint8_t payload[WIRE_PAYLOAD_SIZE], uint64_t time_ns,
+                   void* ctx) {
+  sim_ant_rx(channel, payload);
+}
+
+/* the controller and the firmware side by side until time_ns, the bracelet's show time is
+   compared before each message */
+static void run_together(uint64_t time_ns) {
+  uint64_t next;
+  uint32_t show_time;
+  double error;
+
+  while ((next = ctrl_next_ns()) <= time_ns) {
+    sim_run_until(next);
+    if (ant_show_ticks(&show_time)) {
+      error = ((int32_t)(show_time - (uint32_t)floor(show_ticks(next)))) * 1e6 / 32768;
+      max_error_us = fmax(max_error_us, fabs(error));
+    }
+    ctrl_run_until(next, sim_rx, NULL);
+  }
+  sim_run_until(time_ns);
+}
+
+/* group 5 on channel 0 moves to group 130 on channel 1, whose sequence numbers are a part of a
+   period off channel 0's */
+static void channel_switch(void) {
+  uint32_t show_time;
+
+  sim_flash_group(5);
+  sim_boot();
+  ctrl_start();
+  /* halfway between time messages, so messages on channel 1 arrive before its next one */
+  run_together(10 * SIM_S + 100 * SIM_MS);
+  CHECK(ant_show_ticks(&show_time), "show clock not locked");
+  printf("channel switch: %.0fus out of phase on channel 0", max_error_us);
+  max_error_us = 0;
+  CHECK(sim_nfc_write("131"), "NFC write refused");
+  run_together(20 * SIM_S);
+  printf(", %.0fus after switching to channel 1\n", max_error_us);
+  CHECK(sim_ant_open(1) && !sim_ant_open(0), "channel not switched");
+  CHECK(max_error_us < IN_PHASE_US, "%.0fus out of phase after switching channel",
+        max_error_us);
+}
+
+int main(void) {
+  int status;
+  pid_t pid;
+
+  /* the controller can only start once in a process */
+  fflush(stdout);
+  pid = fork();
+  if (pid == 0) {
+    channel_switch();
+    fflush(stdout);
+    _exit(check_failures ? 1 : 0);
+  }
+  waitpid(pid, &status, 0);
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    printf("FAIL channel switch\n");
+    check_failures++;
+  }
+  crowd_phase();
+  return check_failures;
+}
@@ -0,0 +1,211 @@
+/* Copyright (c) 2023  Hunter Whyte */
+/* sweeps every input of the color conversions in color.c against the original floating point and
+   dividing versions that used to live in ws2812.c, and times both */
+#include <stdint.h>
+#include <stdio.h>
+
+#include "check.h"
+#include "color.h"
+
+/* ######################### ORIGINAL VERSIONS ######################### */
+static rgb_color_t old_hsv_to_rgb(hsv_color_t hsv) {
+  rgb_color_t rgb;
+  uint8_t region, remainder, p, q, t, r, g, b, h, s, v;
+  h = hsv.hue;
+  s = hsv.saturation;
+  v = hsv.value;
+  if (s == 0) {
+    r = v;
+    g = v;
+    b = v;
+  } else {
+    region = h / 43;
+    remainder = (h - (region * 43)) * 6;
+    p = (v * (255 - s)) >> 8;
+    q = (v * (255 - ((s * remainder) >> 8))) >> 8;
+    t = (v * (255 - ((s * (255 - remainder)) >> 8))) >> 8;
+    switch (region) {
+      case 0:
+        r = v, g = t, b = p;
+        break;
+      case 1:
+        r = q, g = v, b = p;
+        break;
+      case 2:
+        r = p, g = v, b = t;
+        break;
+      case 3:
+        r = p, g = q, b = v;
+        break;
+      case 4:
+        r = t, g = p, b = v;
+        break;
+      default:
+        r = v, g = p, b = q;
+        break;
+    }
+  }
+  rgb.red = r;
+  rgb.green = g;
+  rgb.blue = b;
+  return rgb;
+}
+
+static hsv_color_t old_rgb_to_hsv(rgb_color_t rgb) {
+  hsv_color_t hsv;
+  uint8_t min, max, r, g, b, h, s, v;
+  r = rgb.red;
+  g = rgb.green;
+  b = rgb.blue;
+  min = r < g ? (r < b ? r : b) : (g < b ? g : b);
+  max = r > g ? (r > b ? r : b) : (g > b ? g : b);
+  v = max;
+  s = v ? 255 * (int64_t)(max - min) / v : 0;
+  if (v == 0) {
+    h = 0;
+    s = 0;
+  } else if (s == 0) {
+    h = 0;
+  } else if (max == r) {
+    h = 0 + 43 * (g - b) / (max - min);
+  } else if (max == g) {
+    h = 85 + 43 * (b - r) / (max - min);
+  } else {
+    h = 171 + 43 * (r - g) / (max - min);
+  }
+  hsv.hue = h;
+  hsv.saturation = s;
+  hsv.value = v;
+  return hsv;
+}
+
+static uint8_t old_lerp_8(uint8_t a, uint8_t b, uint8_t t) {
+  if (a > b) {
+    return b + ((((float)(a - b)) / 255.0) * t);
+  } else {
+    return a + ((((float)(b - a)) / 255.0) * t);
+  }
+}
+
+/* ######################### SWEEPS ######################### */
+#define ALL_INPUTS (1u << 24)
+
+static void rgb_to_hsv_sweep(void) {
+  uint32_t i, mismatches = 0;
+  for (i = 0; i < ALL_INPUTS; i++) {
+    rgb_color_t rgb = {i >> 16, (i >> 8) & 0xFF, i & 0xFF};
+    hsv_color_t want = old_rgb_to_hsv(rgb);
+    hsv_color_t got = rgb_to_hsv(rgb);
+    if (want.hue != got.hue || want.saturation != got.saturation || want.value != got.value) {
+      if (mismatches++ < 5) {
+        printf("rgb_to_hsv(%d, %d, %d) = %d %d %d, expected %d %d %d\n", rgb.red, rgb.green,
+               rgb.blue, got.hue, got.saturation, got.value, want.hue, want.saturation,
+               want.value);
+      }
+    }
+  }
+  printf("rgb_to_hsv: %u of %u inputs differ\n", mismatches, ALL_INPUTS);
+  CHECK(mismatches == 0, "rgb_to_hsv isn't exact");
+}
+
+static void hsv_to_rgb_sweep(void) {
+  uint32_t i, mismatches = 0;
+  for (i = 0; i < ALL_INPUTS; i++) {
+    hsv_color_t hsv = {i >> 16, (i >> 8) & 0xFF, i & 0xFF};
+    rgb_color_t want = old_hsv_to_rgb(hsv);
+    rgb_color_t got = hsv_to_rgb(hsv);
+    if (want.red != got.red || want.green != got.green || want.blue != got.blue) {
+      if (mismatches++ < 5) {
+        printf("hsv_to_rgb(%d, %d, %d) = %d %d %d, expected %d %d %d\n", hsv.hue, hsv.saturation,
+               hsv.value, got.red, got.green, got.blue, want.red, want.green, want.blue);
+      }
+    }
+  }
+  printf("hsv_to_rgb: %u of %u inputs differ\n", mismatches, ALL_INPUTS);
+  CHECK(mismatches == 0, "hsv_to_rgb isn't exact");
+}
+
+/* lerp_8 has to match the exact integer result everywhere. The float version truncated some
+   exact multiples down by one, those differences are counted but expected */
+static void lerp_8_sweep(void) {
+  uint32_t i, wrong = 0, float_diffs = 0;
+  int max_float_diff = 0;
+  for (i = 0; i < ALL_INPUTS; i++) {
+    uint8_t a = i >> 16, b = (i >> 8) & 0xFF, t = i & 0xFF;
+    uint8_t low = a < b ? a : b;
+    uint8_t high = a < b ? b : a;
+    uint8_t exact = low + ((high - low) * t) / 255;
+    uint8_t got = lerp_8(a, b, t);
+    int diff = got - old_lerp_8(a, b, t);
+    if (got != exact && wrong++ < 5) {
+      printf("lerp_8(%d, %d, %d) = %d, expected %d\n", a, b, t, got, exact);
+    }
+    if (diff) {
+      float_diffs++;
+      diff = diff < 0 ? -diff : diff;
+      max_float_diff = diff > max_float_diff ? diff : max_float_diff;
+    }
+  }
+  printf("lerp_8: %u of %u inputs inexact, %u differ from the float version by at most %d\n",
+         wrong, ALL_INPUTS, float_diffs, max_float_diff);
+  CHECK(wrong == 0, "lerp_8 isn't exact");
+  CHECK(max_float_diff <= 1, "lerp_8 is more than 1 off the float version");
+}
+
+/* how far a color moves going to hsv and back, for information only since hsv loses precision */
+static void round_trip_sweep(void) {
+  uint32_t i;
+  int max_error = 0;
+  uint64_t total_error = 0;
+  for (i = 0; i < ALL_INPUTS; i++) {
+    rgb_color_t rgb = {i >> 16, (i >> 8) & 0xFF, i & 0xFF};
+    rgb_color_t back = hsv_to_rgb(rgb_to_hsv(rgb));
+    int e[3] = {back.red - rgb.red, back.green - rgb.green, back.blue - rgb.blue};
+    for (int c = 0; c < 3; c++) {
+      int error = e[c] < 0 ? -e[c] : e[c];
+      max_error = error > max_error ? error : max_error;
+      total_error += error;
+    }
+  }
+  printf("rgb -> hsv -> rgb: max channel error %d, mean %.2f\n", max_error,
+         (double)total_error / (3.0 * ALL_INPUTS));
+}
+
+/* ######################### BENCHMARKS ######################### */
+#define BENCH(name, expr)                                                     \
+  do {                                                                        \
+    uint32_t i, sum = 0;                                                      \
+    uint64_t start = bench_ns();                                              \
+    for (i = 0; i < ALL_INPUTS; i++) {                                        \
+      sum += (expr);                                                          \
+    }                                                                         \
+    bench_sink += sum;                                                        \
+    printf("  %-14s %5.2f ns\n", name, (double)(bench_ns() - start) / ALL_INPUTS); \
+  } while (0)
+
+static uint32_t hsv_sum(hsv_color_t hsv) {
+  return hsv.hue + hsv.saturation + hsv.value;
+}
+
+static uint32_t rgb_sum(rgb_color_t rgb) {
+  return rgb.red + rgb.green + rgb.blue;
+}
+
+static void benchmarks(void) {
+  printf("time per call over every input:\n");
+  BENCH("old rgb_to_hsv", hsv_sum(old_rgb_to_hsv((rgb_color_t){i >> 16, i >> 8, i})));
+  BENCH("rgb_to_hsv", hsv_sum(rgb_to_hsv((rgb_color_t){i >> 16, i >> 8, i})));
+  BENCH("old hsv_to_rgb", rgb_sum(old_hsv_to_rgb((hsv_color_t){i >> 16, i >> 8, i})));
+  BENCH("hsv_to_rgb", rgb_sum(hsv_to_rgb((hsv_color_t){i >> 16, i >> 8, i})));
+  BENCH("old lerp_8", old_lerp_8(i >> 16, i >> 8, i));
+  BENCH("lerp_8", lerp_8(i >> 16, i >> 8, i));
+}
+
+int main(void) {
+  rgb_to_hsv_sweep();
+  hsv_to_rgb_sweep();
+  lerp_8_sweep();
+  round_trip_sweep();
+  benchmarks();
+  return check_failures;
+}
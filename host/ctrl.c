@@ -0,0 +1,165 @@
+/* Copyright (c) 2023  Hunter Whyte */
+/* controller_ant.c on the host, see ctrl.h */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ctrl.h"
+#include "sim.h"
+
+/* the controller's own symbols */
+#define groups ctrl_groups
+#define ant_init ctrl_ant_init
+#define ant_start ctrl_ant_start
+#define ant_evt_handler ctrl_ant_evt_handler
+#define ant_update_payload ctrl_update_payload
+#define ant_cue_payload ctrl_cue_payload
+/* the SDK calls it makes, some of which the bracelet's fakes define too */
+#define ant_channel_init ctrl_channel_init
+#define sd_ant_channel_open ctrl_channel_open
+#define sd_ant_channel_radio_tx_power_set ctrl_tx_power_set
+#define sd_ant_broadcast_message_tx ctrl_broadcast_message_tx
+#define nrf_sdh_enable_request ctrl_sdh_enable_request
+#define nrf_sdh_is_enabled ctrl_sdh_is_enabled
+#define nrf_sdh_ant_enable ctrl_sdh_ant_enable
+#define fake_ant_observer_set ctrl_ant_observer_set
+#define nrf_pwr_mgmt_feed ctrl_pwr_mgmt_feed
+#define app_timer_cnt_get ctrl_timer_cnt_get
+#define app_timer_cnt_diff_compute ctrl_timer_cnt_diff_compute
+#define app_error_handler ctrl_error_handler
+#define fake_log ctrl_log
+#define fake_log_hexdump ctrl_log_hexdump
+
+#include "../controller/controller_ant.c"
+
+#define PERIOD_NS(n) ((uint64_t)(n) * CHAN_PERIOD * SIM_S / 32768)
+
+static uint64_t now;
+static nrf_sdh_ant_evt_handler_t handler;
+static void* handler_context;
+static bool assigned[NUM_CHANNELS];
+static bool running[NUM_CHANNELS];
+static uint64_t opened[NUM_CHANNELS]; /* time of the channel's first period */
+static uint32_t sent[NUM_CHANNELS];
+static uint8_t tx_buffer[NUM_CHANNELS][WIRE_PAYLOAD_SIZE];
+
+/* ######################### SDK ######################### */
+ret_code_t ctrl_channel_init(ant_channel_config_t const* p_config) {
+  if (p_config->channel_number >= NUM_CHANNELS ||
+      p_config->channel_type != CHANNEL_TYPE_MASTER || p_config->channel_period != CHAN_PERIOD) {
+    return NRF_ERROR_INVALID_PARAM;
+  }
+  assigned[p_config->channel_number] = true;
+  return NRF_SUCCESS;
+}
+
+/* channels are spread over the period so they don't all send at once */
+uint32_t ctrl_channel_open(uint8_t ucChannel) {
+  if (ucChannel >= NUM_CHANNELS || !assigned[ucChannel] || running[ucChannel]) {
+    return NRF_ANT_ERROR_CHANNEL_IN_WRONG_STATE;
+  }
+  running[ucChannel] = true;
+  opened[ucChannel] = now + PERIOD_NS(ucChannel) / NUM_CHANNELS;
+  sent[ucChannel] = 0;
+  return NRF_SUCCESS;
+}
+
+uint32_t ctrl_tx_power_set(uint8_t ucChannel, uint8_t ucTxPower, uint8_t ucCustomTxPower) {
+  return ucChannel < NUM_CHANNELS ? NRF_SUCCESS : NRF_ERROR_INVALID_PARAM;
+}
+
+/* the softdevice sends whatever was set last at the channel's next period */
+uint32_t ctrl_broadcast_message_tx(uint8_t ucChannel, uint8_t ucSize, uint8_t* aucMesg) {
+  if (ucChannel >= NUM_CHANNELS || !assigned[ucChannel] || ucSize != WIRE_PAYLOAD_SIZE) {
+    return NRF_ERROR_INVALID_PARAM;
+  }
+  memcpy(tx_buffer[ucChannel], aucMesg, WIRE_PAYLOAD_SIZE);
+  return NRF_SUCCESS;
+}
+
+ret_code_t ctrl_sdh_enable_request(void) {
+  return NRF_SUCCESS;
+}
+
+bool ctrl_sdh_is_enabled(void) {
+  return true;
+}
+
+ret_code_t ctrl_sdh_ant_enable(void) {
+  return NRF_SUCCESS;
+}
+
+void ctrl_ant_observer_set(nrf_sdh_ant_evt_handler_t p_handler, void* p_context) {
+  handler = p_handler;
+  handler_context = p_context;
+}
+
+void ctrl_pwr_mgmt_feed(void) {}
+
+uint32_t ctrl_timer_cnt_get(void) {
+  return (now * APP_TIMER_CLOCK_FREQ / SIM_S) & APP_TIMER_MAX_CNT_VAL;
+}
+
+uint32_t ctrl_timer_cnt_diff_compute(uint32_t ticks_to, uint32_t ticks_from) {
+  return (ticks_to - ticks_from) & APP_TIMER_MAX_CNT_VAL;
+}
+
+void ctrl_error_handler(ret_code_t error_code, uint32_t line_num, const char* p_file_name) {
+  fprintf(stderr, "ctrl: error 0x%x at %s:%u, %.3fms\n", error_code, p_file_name, line_num,
+          (double)now / SIM_MS);
+  exit(2);
+}
+
+void ctrl_log(const char* format, ...) {}
+
+void ctrl_log_hexdump(const void* p_data, uint32_t length) {}
+
+/* ######################### CONTROLLER ######################### */
+void ctrl_start(void) {
+  now = 0;
+  ctrl_ant_init();
+  ctrl_ant_start();
+}
+
+/* time of a channel's next message */
+static uint64_t tx_due(uint8_t channel) {
+  return opened[channel] + PERIOD_NS(sent[channel] + 1);
+}
+
+/* channel with the next message, NUM_CHANNELS if none is open */
+static uint8_t next_channel(void) {
+  uint8_t channel, next = NUM_CHANNELS;
+  for (channel = 0; channel < NUM_CHANNELS; channel++) {
+    if (running[channel] && (next == NUM_CHANNELS || tx_due(channel) < tx_due(next))) {
+      next = channel;
+    }
+  }
+  return next;
+}
+
+uint64_t ctrl_next_ns(void) {
+  uint8_t channel = next_channel();
+  return channel < NUM_CHANNELS ? tx_due(channel) : UINT64_MAX;
+}
+
+void ctrl_run_until(uint64_t time_ns, ctrl_tx_fn_t fn, void* ctx) {
+  uint8_t channel, payload[WIRE_PAYLOAD_SIZE];
+  ant_evt_t evt = {.event = EVENT_TX};
+
+  while (ctrl_next_ns() <= time_ns) {
+    channel = next_channel();
+    now = tx_due(channel);
+    sent[channel]++;
+    /* EVENT_TX loads the next message over this one */
+    memcpy(payload, tx_buffer[channel], WIRE_PAYLOAD_SIZE);
+    evt.channel = channel;
+    handler(&evt, handler_context);
+    if (fn) {
+      fn(channel, payload, now, ctx);
+    }
+  }
+  now = time_ns;
+}
+
+uint32_t ctrl_show_time(void) {
+  return show_time_get();
+}
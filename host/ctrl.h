@@ -0,0 +1,38 @@
+/* Copyright (c) 2023  Hunter Whyte */
+#ifndef CTRL_H
+#define CTRL_H
+/*
+The controller's channel scheduler on the host, controller_ant.c built unmodified against
+stand-ins for the softdevice calls it makes. Every symbol it defines or calls is renamed with a
+ctrl_ prefix, so it links on its own or next to the bracelet simulation's fakes of the same
+calls, see sim.h.
+Time is in ns like the simulation's and only moves in ctrl_run_until(). Each channel sends the
+message in its buffer exactly CHAN_PERIOD apart, the channels a fraction of a period apart from
+each other, and the EVENT_TX that follows loads the next one, as on the nRF.
+Statics in controller_ant.c can't be reset, so it can only be started once in a process.
+*/
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "common.h"
+#include "wire.h"
+
+/* a message on the air, time_ns is when it was sent */
+typedef void (*ctrl_tx_fn_t)(uint8_t channel, const uint8_t payload[WIRE_PAYLOAD_SIZE],
+                             uint64_t time_ns, void* ctx);
+
+/* ant_init() and ant_start() at time 0 */
+void ctrl_start(void);
+/* send every message due up to time_ns through fn, which may be NULL */
+void ctrl_run_until(uint64_t time_ns, ctrl_tx_fn_t fn, void* ctx);
+uint64_t ctrl_next_ns(void); /* time of the next message on any channel */
+uint32_t ctrl_show_time(void);
+
+/* controller_ant.h, as the host's USB commands call them */
+void ctrl_update_payload(uint8_t group, uint8_t control, uint8_t red, uint8_t green,
+                         uint8_t blue);
+void ctrl_cue_payload(uint8_t group, uint8_t control, uint8_t red, uint8_t green, uint8_t blue,
+                      uint16_t delay_ms);
+
+#endif /* CTRL_H */
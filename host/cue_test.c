@@ -0,0 +1,200 @@
+/* Copyright (c) 2023  Hunter Whyte */
+/* cues, see cue.h. The ring's ordering first, then the round trip: the controller's scheduler
+   (ctrl.h) cues color changes for a group and the whole bracelet firmware in the simulation
+   receives them with packet loss. Reports how far from its show time each change reaches the LEDs
+   on either channel, a late one is waited for until the next cue. The controller can only start
+   once in a process, so each round trip runs in a child process */
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "check.h"
+#include "nrf_drv_gpiote.h"
+#include "sim.h"
+
+#include "bracelet.h"
+#include "common.h"
+#include "ctrl.h"
+#include "cue.h"
+#include "mma865.h"
+#include "wire.h"
+#include "ws2812.h"
+
+#define GRAVITY_MG 1000
+#define CUES 40
+#define CUE_EVERY_NS (2 * SIM_S)
+#define CUE_DELAY_MS 500
+#define STEP_NS SIM_MS /* LEDs are checked this often */
+/* a change within an effect frame is on time */
+#define ON_TIME_NS ((int64_t)(WS2812_TICK_MS * SIM_MS))
+
+/* ######################### RING ######################### */
+static cue_t cue_at(uint32_t time, uint8_t red) {
+  return (cue_t){.time = time, .red = red};
+}
+
+/* every cue comes out in time order, ties in the order they were pushed */
+static bool pops_in_order(cue_queue_t* queue, const uint8_t* reds, uint8_t count) {
+  uint8_t i;
+  for (i = 0; i < count; i++) {
+    if (!cue_peek(queue) || cue_peek(queue)->red != reds[i]) {
+      return false;
+    }
+    cue_pop(queue);
+  }
+  return cue_peek(queue) == NULL;
+}
+
+static void ring(void) {
+  static const uint32_t times[] = {500, 100, 400, 100, 300, 200, 400, 0};
+  static const uint8_t sorted[] = {7, 1, 3, 5, 4, 2, 6, 0};
+  cue_queue_t queue;
+  cue_t cue;
+  uint8_t i, round;
+
+  /* pushed out of order and repeated, several rounds so the head wraps round the ring */
+  cue_reset(&queue);
+  for (round = 0; round < 3; round++) {
+    cue_push(&queue, &(cue_t){.time = 0});
+    cue_pop(&queue);
+    for (i = 0; i < MAX_CUES; i++) {
+      cue = cue_at(times[i], i);
+      CHECK(cue_push(&queue, &cue), "cue %u refused", i);
+      CHECK(cue_push(&queue, &cue), "repeat of cue %u refused", i);
+    }
+    CHECK(queue.count == MAX_CUES, "%u cues after repeats", queue.count);
+    cue = cue_at(50, MAX_CUES);
+    CHECK(!cue_push(&queue, &cue), "cue pushed past MAX_CUES");
+    CHECK(pops_in_order(&queue, sorted, MAX_CUES), "cues out of order, head %u", queue.head);
+  }
+
+  /* show time wraps, a cue just past the wrap is due after one just before it */
+  cue_reset(&queue);
+  cue = cue_at(5, 1);
+  cue_push(&queue, &cue);
+  cue = cue_at(UINT32_MAX - 5, 0);
+  cue_push(&queue, &cue);
+  CHECK(pops_in_order(&queue, (const uint8_t[]){0, 1}, 2), "cues out of order across the wrap");
+}
+
+/* ######################### ROUND TRIP ######################### */
+typedef struct round_trip {
+  const char* name;
+  uint8_t group;
+  uint32_t loss_percent;
+} round_trip_t;
+
+static const round_trip_t round_trips[] = {
+    {"channel 0", 5, 0},
+    {"channel 1", 130, 0},
+    {"channel 0, 30% loss", 5, 30},
+    {"channel 1, 30% loss", 130, 30},
+};
+
+static uint32_t state = 1;
+
+static void lossy_rx(uint8_t channel, const uint8_t payload[WIRE_PAYLOAD_SIZE], uint64_t time_ns,
+                     void* ctx) {
+  const round_trip_t* round_trip = ctx;
+  if (check_rand(&state) % 100 >= round_trip->loss_percent) {
+    sim_ant_rx(channel, payload);
+  }
+}
+
+/* the controller and the firmware side by side until time_ns */
+static void run_together(uint64_t time_ns, const round_trip_t* round_trip) {
+  uint64_t next;
+  while ((next = ctrl_next_ns()) <= time_ns) {
+    sim_run_until(next);
+    ctrl_run_until(next, lossy_rx, (void*)round_trip);
+  }
+  sim_run_until(time_ns);
+  ctrl_run_until(time_ns, lossy_rx, (void*)round_trip);
+}
+
+/* each cue is a different color from the last two, so one that never arrives can't be mistaken
+   for the next */
+static const sim_rgb_t colors[] = {{255, 0, 0}, {0, 255, 0}, {0, 0, 255}};
+#define COLORS (sizeof(colors) / sizeof(colors[0]))
+
+/* colors go through gamma and dithering on the way out, so only the rough level is checked */
+static bool led_is(sim_rgb_t color) {
+  sim_rgb_t led = sim_led(0);
+  return abs(led.red - color.red) <= 24 && abs(led.green - color.green) <= 24 &&
+         abs(led.blue - color.blue) <= 24;
+}
+
+static void round_trip(const round_trip_t* round_trip) {
+  uint64_t start, cue_ns, time;
+  int64_t error, on_time_max = 0, late_max = 0;
+  uint32_t i, cue_time, late = 0;
+  sim_rgb_t color;
+
+  sim_flash_group(round_trip->group);
+  sim_acc_model(MMA8653_ID);
+  sim_acc_set(0, 0, GRAVITY_MG);
+  sim_boot();
+  ctrl_start();
+  run_together(5 * SIM_S, round_trip);
+
+  for (i = 0; i < CUES; i++) {
+    start = 5 * SIM_S + i * CUE_EVERY_NS;
+    color = colors[i % COLORS];
+    run_together(start, round_trip);
+    cue_time = ctrl_show_time() + ((uint32_t)CUE_DELAY_MS * 32768) / 1000;
+    cue_ns = (uint64_t)cue_time * SIM_S / 32768;
+    ctrl_cue_payload(round_trip->group, 0, color.red, color.green, color.blue, CUE_DELAY_MS);
+    for (time = start; !led_is(color) && time < start + CUE_EVERY_NS; time += STEP_NS) {
+      run_together(time + STEP_NS, round_trip);
+    }
+    error = (int64_t)time - (int64_t)cue_ns;
+    CHECK(error >= 0, "%s: cue %u applied %.1fms early", round_trip->name, i,
+          (double)-error / SIM_MS);
+    if (error > ON_TIME_NS) {
+      late++;
+      late_max = error > late_max ? error : late_max;
+    } else if (error > on_time_max) {
+      on_time_max = error;
+    }
+  }
+  printf("  %-20s %6.1fms %5u of %u %8.1fms\n", round_trip->name,
+         (double)on_time_max / SIM_MS, late, CUES, (double)late_max / SIM_MS);
+  /* a cue is only late if every repeat of it was lost, the change then follows in the pages.
+     Allows three times the share expected to lose every repeat */
+  CHECK(late <= CUES * pow(round_trip->loss_percent / 100.0, WIRE_CUE_REPEATS) * 3,
+        "%s: %u cues late", round_trip->name, late);
+}
+
+static void round_trips_run(void) {
+  uint32_t i;
+  int status;
+  pid_t pid;
+
+  printf("cues %dms ahead, the LEDs checked every %.0fms, on time within %dms:\n", CUE_DELAY_MS,
+         (double)STEP_NS / SIM_MS, WS2812_TICK_MS);
+  printf("  %-20s %8s %10s %10s\n", "", "on time", "late", "latest");
+  for (i = 0; i < sizeof(round_trips) / sizeof(round_trips[0]); i++) {
+    fflush(stdout);
+    pid = fork();
+    if (pid == 0) {
+      check_failures = 0; /* counts the parent's failures so far */
+      round_trip(&round_trips[i]);
+      fflush(stdout);
+      _exit(check_failures ? 1 : 0);
+    }
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      printf("FAIL %s\n", round_trips[i].name);
+      check_failures++;
+    }
+  }
+}
+
+int main(void) {
+  ring();
+  round_trips_run();
+  return check_failures;
+}
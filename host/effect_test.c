@@ -0,0 +1,102 @@
+/* Copyright (c) 2023  Hunter Whyte */
+/* times the effect interpreter per LED and frame for every mode, both the evaluation alone and a
+   whole ws2812_tick() with the frame written, and checks a few modes still follow the waveforms
+   of the switch they replaced. ws2812.c is included to get at its effect table, the rest of the
+   firmware comes from the simulation build */
+#include <stdint.h>
+#include <stdio.h>
+
+#include "../bracelet/ws2812.c"
+#include "check.h"
+#include "sim.h"
+
+#define BENCH_LEDS WS2812_MAX_LEDS
+#define BENCH_FRAMES 500
+
+static const char* mode_names[WS2812_NUM_MODES] = {
+    [WS2812_STATIC] = "static",
+    [WS2812_BLINK] = "blink",
+    [WS2812_PULSE] = "pulse",
+    [WS2812_RAINBOW] = "rainbow",
+    [WS2812_COLOR_SHIFT] = "color shift",
+    [WS2812_CLAP_TOGGLE] = "clap toggle",
+    [WS2812_CLAP_PULSE] = "clap pulse",
+    [WS2812_WAVE_RAINBOW] = "wave rainbow",
+    [WS2812_TILT] = "tilt",
+};
+
+/* ######################### CHECKS ######################### */
+static void waveform_checks(void) {
+  uint16_t p;
+  hsv_color_t color = {100, 200, 150}, hsv;
+  effect_inputs_t none = {0, 0};
+
+  for (p = 0; p < 256; p++) {
+    hsv = effect_eval(&effects[WS2812_PULSE], p, color, &none);
+    CHECK(hsv.hue == color.hue && hsv.saturation == color.saturation && hsv.value == sine_lut[p],
+          "pulse at phase %d: %d %d %d", p, hsv.hue, hsv.saturation, hsv.value);
+    hsv = effect_eval(&effects[WS2812_BLINK], p, color, &none);
+    CHECK(hsv.value == (p < 128 ? 255 : 0), "blink at phase %d: %d", p, hsv.value);
+    hsv = effect_eval(&effects[WS2812_RAINBOW], p, color, &none);
+    CHECK(hsv.hue == p && hsv.saturation == 250 && hsv.value == 250, "rainbow at phase %d: %d",
+          p, hsv.hue);
+    hsv = effect_eval(&effects[WS2812_STATIC], p, color, &none);
+    CHECK(hsv.hue == color.hue && hsv.saturation == color.saturation && hsv.value == color.value,
+          "static at phase %d", p);
+  }
+  CHECK(effect_is_static(&effects[WS2812_STATIC]), "static effect not static");
+  CHECK(effect_uses_motion(&effects[WS2812_CLAP_PULSE]), "clap pulse ignores motion");
+}
+
+/* ######################### BENCHMARKS ######################### */
+/* the loop ws2812_tick() runs over the LEDs */
+static uint32_t eval_frame(const effect_t* effect, uint8_t phase) {
+  uint16_t i;
+  uint32_t sum = 0;
+  rgb_color_t rgb;
+  for (i = 0; i < BENCH_LEDS; i++) {
+    rgb = hsv_to_rgb(
+        effect_eval(effect, phase + (effect->spread * i) / BENCH_LEDS, hsv_colors[i], &inputs));
+    sum += rgb.red + rgb.green + rgb.blue;
+  }
+  return sum;
+}
+
+static void benchmarks(void) {
+  color_gen_mode_e m;
+  uint32_t frame, sum;
+  uint64_t start;
+  double eval_ns, tick_ns;
+
+  ws2812_init();
+  ws2812_set_num_leds(BENCH_LEDS);
+  for (frame = 0; frame < BENCH_LEDS; frame++) {
+    ws2812_set_rgb(frame, frame, 255 - frame, 128);
+  }
+  printf("time per LED and frame over %d frames of %d LEDs:\n", BENCH_FRAMES, BENCH_LEDS);
+  printf("  %-14s %8s %8s\n", "mode", "eval", "tick");
+  for (m = 0; m < WS2812_NUM_MODES; m++) {
+    start = bench_ns();
+    for (frame = 0, sum = 0; frame < BENCH_FRAMES; frame++) {
+      sum += eval_frame(&effects[m], frame);
+    }
+    eval_ns = (double)(bench_ns() - start) / BENCH_FRAMES / BENCH_LEDS;
+    bench_sink += sum;
+
+    /* whole ticks, the evaluation when the effect isn't static and the frame written */
+    ws2812_set_mode(m);
+    start = bench_ns();
+    for (frame = 0; frame < BENCH_FRAMES; frame++) {
+      movement_flag = true;
+      ws2812_tick();
+    }
+    tick_ns = (double)(bench_ns() - start) / BENCH_FRAMES / BENCH_LEDS;
+    printf("  %-14s %5.2f ns %5.2f ns\n", mode_names[m], eval_ns, tick_ns);
+  }
+}
+
+int main(void) {
+  waveform_checks();
+  benchmarks();
+  return check_failures;
+}
@@ -0,0 +1,149 @@
+/* Copyright (c) 2023  Hunter Whyte */
+/* checks the byte expansion table ws2812.c encodes frames with against the original per bit
+   encoder, bit for bit, and times both. Then streams random frames through the ring in the
+   simulation and checks the chain decodes every byte. ws2812.c is included to get at its table,
+   the rest of the firmware comes from the simulation build */
+#include <stdint.h>
+#include <stdio.h>
+
+#include "../bracelet/ws2812.c"
+#include "check.h"
+#include "sim.h"
+
+#define BENCH_FRAMES 2000
+
+static nrf_pwm_values_common_t old_values[WS2812_MAX_LEDS * CYCLES_PER_LED];
+static nrf_pwm_values_common_t new_values[WS2812_MAX_LEDS * CYCLES_PER_LED];
+static uint8_t bench_bytes[WS2812_MAX_LEDS * BYTES_PER_LED];
+static rgb_color_t bench_colors[WS2812_MAX_LEDS];
+
+/* ######################### ORIGINAL VERSION ######################### */
+/* ws2812_write() before the table, less the reset and the playback */
+static void old_encode(const rgb_color_t* colors, uint16_t count,
+                       nrf_pwm_values_common_t* values) {
+  uint16_t i, j;
+  uint16_t seq_offset; /* offset for current sequence */
+
+  for (i = 0; i < count; i++) {
+    seq_offset = i * CYCLES_PER_LED;
+    for (j = 0; j < 8; j++) {
+      values[seq_offset + j + G_OFFSET * 8] = PWM_FALLING_EDGE;
+      values[seq_offset + j + R_OFFSET * 8] = PWM_FALLING_EDGE;
+      values[seq_offset + j + B_OFFSET * 8] = PWM_FALLING_EDGE;
+      values[seq_offset + j + G_OFFSET * 8] |=
+          ((colors[i].green & (0x80 >> j)) ? ONE_HIGH_TICKS : ZERO_HIGH_TICKS);
+      values[seq_offset + j + R_OFFSET * 8] |=
+          ((colors[i].red & (0x80 >> j)) ? ONE_HIGH_TICKS : ZERO_HIGH_TICKS);
+      values[seq_offset + j + B_OFFSET * 8] |=
+          ((colors[i].blue & (0x80 >> j)) ? ONE_HIGH_TICKS : ZERO_HIGH_TICKS);
+    }
+  }
+}
+
+/* the copy ring_fill() does for each byte */
+static void new_encode(const uint8_t* bytes, uint16_t length, nrf_pwm_values_common_t* values) {
+  uint16_t i;
+  for (i = 0; i < length; i++) {
+    memcpy(&values[i * 8], byte_lut[bytes[i]], sizeof(byte_lut[0]));
+  }
+}
+
+static void random_frame(uint32_t* seed) {
+  uint16_t i;
+  for (i = 0; i < WS2812_MAX_LEDS; i++) {
+    bench_colors[i].red = check_rand(seed);
+    bench_colors[i].green = check_rand(seed);
+    bench_colors[i].blue = check_rand(seed);
+    bench_bytes[i * BYTES_PER_LED + G_OFFSET] = bench_colors[i].green;
+    bench_bytes[i * BYTES_PER_LED + R_OFFSET] = bench_colors[i].red;
+    bench_bytes[i * BYTES_PER_LED + B_OFFSET] = bench_colors[i].blue;
+  }
+}
+
+/* ######################### CHECKS ######################### */
+static void table_sweep(void) {
+  uint16_t b;
+  rgb_color_t color;
+  uint8_t bytes[BYTES_PER_LED];
+  for (b = 0; b < 256; b++) {
+    color = (rgb_color_t){b, b, b};
+    memset(bytes, b, sizeof(bytes));
+    old_encode(&color, 1, old_values);
+    new_encode(bytes, BYTES_PER_LED, new_values);
+    CHECK(memcmp(old_values, new_values, CYCLES_PER_LED * sizeof(old_values[0])) == 0,
+          "byte %d encodes differently", b);
+  }
+}
+
+static void frame_compare(void) {
+  uint32_t seed = 1, frame;
+  for (frame = 0; frame < 100; frame++) {
+    random_frame(&seed);
+    old_encode(bench_colors, WS2812_MAX_LEDS, old_values);
+    new_encode(bench_bytes, sizeof(bench_bytes), new_values);
+    CHECK(memcmp(old_values, new_values, sizeof(old_values)) == 0, "frame %u encodes differently",
+          frame);
+  }
+}
+
+/* frames streamed through the ring halves come out of the chain as the bytes encoded */
+static void stream_compare(void) {
+  uint32_t seed = 2, frame, frames;
+  uint16_t i, n, wrong;
+  const uint8_t* bytes;
+  ws2812_init();
+  for (frame = 0; frame < 20; frame++) {
+    n = 1 + check_rand(&seed) % WS2812_MAX_LEDS;
+    ws2812_set_num_leds(n);
+    for (i = 0; i < n; i++) {
+      ws2812_set_rgb(i, check_rand(&seed), check_rand(&seed), check_rand(&seed));
+    }
+    frames = sim_led_frames();
+    ws2812_write();
+    sim_run(2 * ws2812_frame_time_us() * SIM_US);
+    CHECK(sim_led_frames() == frames + 1, "frame %u latched %u times", frame,
+          sim_led_frames() - frames);
+    bytes = frame_bytes[front_buffer];
+    for (i = 0, wrong = 0; i < n; i++) {
+      wrong += sim_led(i).green != bytes[i * BYTES_PER_LED + G_OFFSET] ||
+               sim_led(i).red != bytes[i * BYTES_PER_LED + R_OFFSET] ||
+               sim_led(i).blue != bytes[i * BYTES_PER_LED + B_OFFSET];
+    }
+    CHECK(wrong == 0, "frame %u of %d LEDs, %d wrong", frame, n, wrong);
+  }
+  CHECK(sim_led_errors() == 0, "%u bad PWM values", sim_led_errors());
+}
+
+/* ######################### BENCHMARKS ######################### */
+static void benchmarks(void) {
+  uint32_t seed = 3, i;
+  uint64_t start;
+  double old_ns, new_ns;
+  random_frame(&seed);
+
+  start = bench_ns();
+  for (i = 0; i < BENCH_FRAMES; i++) {
+    old_encode(bench_colors, WS2812_MAX_LEDS, old_values);
+    bench_sink += old_values[i % (sizeof(old_values) / sizeof(old_values[0]))];
+  }
+  old_ns = (double)(bench_ns() - start) / BENCH_FRAMES / WS2812_MAX_LEDS;
+
+  start = bench_ns();
+  for (i = 0; i < BENCH_FRAMES; i++) {
+    new_encode(bench_bytes, sizeof(bench_bytes), new_values);
+    bench_sink += new_values[i % (sizeof(new_values) / sizeof(new_values[0]))];
+  }
+  new_ns = (double)(bench_ns() - start) / BENCH_FRAMES / WS2812_MAX_LEDS;
+
+  printf("time per LED over %d frames of %d LEDs:\n", BENCH_FRAMES, WS2812_MAX_LEDS);
+  printf("  %-14s %5.2f ns\n", "old encoder", old_ns);
+  printf("  %-14s %5.2f ns\n", "byte table", new_ns);
+}
+
+int main(void) {
+  table_sweep();
+  frame_compare();
+  stream_compare();
+  benchmarks();
+  return check_failures;
+}
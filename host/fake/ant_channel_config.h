@@ -0,0 +1,21 @@
+/* Copyright (c) 2023  Hunter Whyte */
+#ifndef ANT_CHANNEL_CONFIG_H
+#define ANT_CHANNEL_CONFIG_H
+
+#include "nordic_common.h"
+
+typedef struct {
+  uint8_t channel_number;
+  uint8_t channel_type;
+  uint8_t ext_assign;
+  uint8_t rf_freq;
+  uint8_t transmission_type;
+  uint8_t device_type;
+  uint16_t device_number;
+  uint16_t channel_period;
+  uint8_t network_number;
+} ant_channel_config_t;
+
+ret_code_t ant_channel_init(ant_channel_config_t const* p_config);
+
+#endif /* ANT_CHANNEL_CONFIG_H */
@@ -0,0 +1,8 @@
+/* Copyright (c) 2023  Hunter Whyte */
+#ifndef ANT_ERROR_H
+#define ANT_ERROR_H
+
+#define NRF_ANT_ERROR_CHANNEL_IN_WRONG_STATE 0x4015
+#define NRF_ANT_ERROR_CHANNEL_NOT_OPENED 0x4016
+
+#endif /* ANT_ERROR_H */
@@ -0,0 +1,17 @@
+/* Copyright (c) 2023  Hunter Whyte */
+#ifndef ANT_INTERFACE_H
+#define ANT_INTERFACE_H
+/* channels are assigned by ant_channel_init(), open ones receive what the simulation injects
+   with sim_ant_rx(). Closing takes effect at the channel's next period like the softdevice.
+   The transmit calls are only for the controller, see ctrl.h */
+
+#include "nordic_common.h"
+
+uint32_t sd_ant_channel_open(uint8_t ucChannel);
+uint32_t sd_ant_channel_close(uint8_t ucChannel);
+uint32_t sd_ant_channel_search_timeout_set(uint8_t ucChannel, uint8_t ucTimeout);
+uint32_t sd_ant_broadcast_message_tx(uint8_t ucChannel, uint8_t ucSize, uint8_t* aucMesg);
+uint32_t sd_ant_channel_radio_tx_power_set(uint8_t ucChannel, uint8_t ucTxPower,
+                                           uint8_t ucCustomTxPower);
+
+#endif /* ANT_INTERFACE_H */
@@ -0,0 +1,18 @@
+/* Copyright (c) 2023  Hunter Whyte */
+#ifndef ANT_PARAMETERS_H
+#define ANT_PARAMETERS_H
+
+#define CHANNEL_TYPE_SLAVE 0x00
+#define CHANNEL_TYPE_MASTER 0x10
+#define CHANNEL_TYPE_SLAVE_RX_ONLY 0x40
+
+#define RADIO_TX_POWER_LVL_5 0x05
+
+#define EVENT_RX_SEARCH_TIMEOUT 0x01
+#define EVENT_RX_FAIL 0x02
+#define EVENT_TX 0x03
+#define EVENT_CHANNEL_CLOSED 0x07
+#define EVENT_RX_FAIL_GO_TO_SEARCH 0x08
+#define EVENT_RX 0x80
+
+#endif /* ANT_PARAMETERS_H */
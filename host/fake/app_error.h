@@ -0,0 +1,25 @@
+/* Copyright (c) 2023  Hunter Whyte */
+#ifndef APP_ERROR_H
+#define APP_ERROR_H
+/* errors end the simulation with the failing call's location, where the bracelet would reset */
+
+#include "nordic_common.h"
+
+void app_error_handler(ret_code_t error_code, uint32_t line_num, const char* p_file_name);
+
+#define APP_ERROR_CHECK(err_code)                             \
+  do {                                                        \
+    const ret_code_t _err = (err_code);                       \
+    if (_err != NRF_SUCCESS) {                                \
+      app_error_handler(_err, __LINE__, __FILE__);            \
+    }                                                         \
+  } while (0)
+
+#define ASSERT(expr)                                          \
+  do {                                                        \
+    if (!(expr)) {                                            \
+      app_error_handler(NRF_ERROR_INTERNAL, __LINE__, __FILE__); \
+    }                                                         \
+  } while (0)
+
+#endif /* APP_ERROR_H */
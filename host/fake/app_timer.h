@@ -0,0 +1,45 @@
+/* Copyright (c) 2023  Hunter Whyte */
+#ifndef APP_TIMER_H
+#define APP_TIMER_H
+/* app_timer v2 on the simulation's virtual clock. The RTC frequency comes from the bracelet's
+   sdk_config.h so tick conversions match the firmware build */
+
+#include "nordic_common.h"
+#include "sdk_config.h"
+
+#define APP_TIMER_CLOCK_FREQ (32768 / (APP_TIMER_CONFIG_RTC_FREQUENCY + 1))
+#define APP_TIMER_MIN_TIMEOUT_TICKS 5
+#define APP_TIMER_MAX_CNT_VAL 0x00FFFFFF
+#define APP_TIMER_TICKS(MS) ((uint32_t)ROUNDED_DIV((MS) * (uint64_t)APP_TIMER_CLOCK_FREQ, 1000))
+
+typedef void (*app_timer_timeout_handler_t)(void* p_context);
+
+typedef enum {
+  APP_TIMER_MODE_SINGLE_SHOT,
+  APP_TIMER_MODE_REPEATED
+} app_timer_mode_t;
+
+typedef struct app_timer {
+  app_timer_timeout_handler_t handler;
+  app_timer_mode_t mode;
+  void* p_context;
+  uint32_t interval;
+  int event; /* simulation event of the next expiry, -1 while stopped */
+  bool active;
+} app_timer_t;
+
+typedef app_timer_t* app_timer_id_t;
+
+#define APP_TIMER_DEF(timer_id)                  \
+  static app_timer_t timer_id##_data = {.event = -1}; \
+  static const app_timer_id_t timer_id = &timer_id##_data
+
+ret_code_t app_timer_init(void);
+ret_code_t app_timer_create(app_timer_id_t const* p_timer_id, app_timer_mode_t mode,
+                            app_timer_timeout_handler_t timeout_handler);
+ret_code_t app_timer_start(app_timer_id_t timer_id, uint32_t timeout_ticks, void* p_context);
+ret_code_t app_timer_stop(app_timer_id_t timer_id);
+uint32_t app_timer_cnt_get(void);
+uint32_t app_timer_cnt_diff_compute(uint32_t ticks_to, uint32_t ticks_from);
+
+#endif /* APP_TIMER_H */
@@ -0,0 +1,16 @@
+/* Copyright (c) 2023  Hunter Whyte */
+#ifndef APP_UTIL_PLATFORM_H
+#define APP_UTIL_PLATFORM_H
+/* the simulation runs every interrupt handler to completion between main loop passes, so
+   critical regions have nothing to keep out */
+
+#include "app_error.h"
+#include "nordic_common.h"
+
+#define APP_IRQ_PRIORITY_HIGH 2
+#define APP_IRQ_PRIORITY_LOW 6
+
+#define CRITICAL_REGION_ENTER() {
+#define CRITICAL_REGION_EXIT() }
+
+#endif /* APP_UTIL_PLATFORM_H */
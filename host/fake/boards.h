@@ -0,0 +1,6 @@
+/* Copyright (c) 2023  Hunter Whyte */
+#ifndef BOARDS_H
+#define BOARDS_H
+/* included by the controller's controller_ant.c, which uses nothing from it */
+
+#endif /* BOARDS_H */
@@ -0,0 +1,6 @@
+/* Copyright (c) 2023  Hunter Whyte */
+#ifndef BSP_H
+#define BSP_H
+/* included by the controller's controller_ant.c, which uses nothing from it */
+
+#endif /* BSP_H */
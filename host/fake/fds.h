@@ -0,0 +1,68 @@
+/* Copyright (c) 2023  Hunter Whyte */
+#ifndef FDS_H
+#define FDS_H
+/* flash data storage kept in RAM. Initialization completes inside fds_init() since nfc.c spins
+   on it before the main loop runs, writes and updates complete with an event later on */
+
+#include "nordic_common.h"
+
+#define FDS_ERR_BASE 0x8600
+#define FDS_ERR_NOT_FOUND (FDS_ERR_BASE + 10)
+#define FDS_ERR_NO_SPACE_IN_FLASH (FDS_ERR_BASE + 11)
+#define FDS_ERR_NO_SPACE_IN_QUEUES (FDS_ERR_BASE + 12)
+
+typedef enum {
+  FDS_EVT_INIT,
+  FDS_EVT_WRITE,
+  FDS_EVT_UPDATE,
+  FDS_EVT_DEL_RECORD,
+  FDS_EVT_DEL_FILE,
+  FDS_EVT_GC
+} fds_evt_id_t;
+
+typedef struct {
+  fds_evt_id_t id;
+  ret_code_t result;
+} fds_evt_t;
+
+typedef void (*fds_cb_t)(fds_evt_t const* p_evt);
+
+typedef struct {
+  uint32_t record_id;
+} fds_record_desc_t;
+
+typedef struct {
+  uint32_t index;
+} fds_find_token_t;
+
+typedef struct {
+  uint16_t file_id;
+  uint16_t record_key;
+  uint16_t length_words;
+} fds_header_t;
+
+typedef struct {
+  uint16_t file_id;
+  uint16_t key;
+  struct {
+    void const* p_data;
+    uint32_t length_words;
+  } data;
+} fds_record_t;
+
+typedef struct {
+  fds_header_t const* p_header;
+  void const* p_data;
+} fds_flash_record_t;
+
+ret_code_t fds_register(fds_cb_t cb);
+ret_code_t fds_init(void);
+ret_code_t fds_record_find(uint16_t file_id, uint16_t record_key, fds_record_desc_t* p_desc,
+                           fds_find_token_t* p_token);
+ret_code_t fds_record_open(fds_record_desc_t* p_desc, fds_flash_record_t* p_flash_record);
+ret_code_t fds_record_close(fds_record_desc_t* p_desc);
+ret_code_t fds_record_write(fds_record_desc_t* p_desc, fds_record_t const* p_record);
+ret_code_t fds_record_update(fds_record_desc_t* p_desc, fds_record_t const* p_record);
+ret_code_t fds_gc(void);
+
+#endif /* FDS_H */
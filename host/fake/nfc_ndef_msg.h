@@ -0,0 +1,7 @@
+/* Copyright (c) 2023  Hunter Whyte */
+#ifndef NFC_NDEF_MSG_H
+#define NFC_NDEF_MSG_H
+
+#include "nordic_common.h"
+
+#endif /* NFC_NDEF_MSG_H */
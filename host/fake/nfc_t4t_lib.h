@@ -0,0 +1,27 @@
+/* Copyright (c) 2023  Hunter Whyte */
+#ifndef NFC_T4T_LIB_H
+#define NFC_T4T_LIB_H
+/* type 4 tag emulation, sim_nfc_write() plays a phone writing a text record to the tag */
+
+#include "nordic_common.h"
+
+#define NLEN_FIELD_SIZE 2
+
+typedef enum {
+  NFC_T4T_EVENT_NONE,
+  NFC_T4T_EVENT_FIELD_ON,
+  NFC_T4T_EVENT_FIELD_OFF,
+  NFC_T4T_EVENT_NDEF_READ,
+  NFC_T4T_EVENT_NDEF_UPDATED,
+  NFC_T4T_EVENT_DATA_TRANSMITTED,
+  NFC_T4T_EVENT_DATA_IND
+} nfc_t4t_event_t;
+
+typedef void (*nfc_t4t_callback_t)(void* p_context, nfc_t4t_event_t event, const uint8_t* p_data,
+                                   size_t data_length, uint32_t flags);
+
+ret_code_t nfc_t4t_setup(nfc_t4t_callback_t callback, void* p_context);
+ret_code_t nfc_t4t_ndef_rwpayload_set(uint8_t* p_emulation_buffer, size_t buffer_length);
+ret_code_t nfc_t4t_emulation_start(void);
+
+#endif /* NFC_T4T_LIB_H */
@@ -0,0 +1,39 @@
+/* Copyright (c) 2023  Hunter Whyte */
+#ifndef NORDIC_COMMON_H
+#define NORDIC_COMMON_H
+/* host stand-in for the SDK's common definitions, only what the bracelet firmware uses */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+typedef uint32_t ret_code_t;
+
+#define NRF_SUCCESS 0
+#define NRF_ERROR_INTERNAL 3
+#define NRF_ERROR_NO_MEM 4
+#define NRF_ERROR_NOT_FOUND 5
+#define NRF_ERROR_INVALID_PARAM 7
+#define NRF_ERROR_INVALID_STATE 8
+#define NRF_ERROR_BUSY 17
+#define NRF_ERROR_RESOURCES 19
+
+#define ARRAY_SIZE(arr) (sizeof(arr) / sizeof((arr)[0]))
+#define BYTES_TO_WORDS(n_bytes) (((n_bytes) + 3) >> 2)
+#define ROUNDED_DIV(a, b) (((a) + ((b) / 2)) / (b))
+#define MSEC_TO_UNITS(TIME, RESOLUTION) (((TIME) * 1000) / (RESOLUTION))
+#define UNIT_1_25_MS 1250
+#define UNIT_10_MS 10000
+#define UNUSED_PARAMETER(x) (void)(x)
+#define __ALIGN(n) __attribute__((aligned(n)))
+
+#define VERIFY_SUCCESS(statement)      \
+  do {                                 \
+    ret_code_t _err = (statement);     \
+    if (_err != NRF_SUCCESS) {         \
+      return _err;                     \
+    }                                  \
+  } while (0)
+
+#endif /* NORDIC_COMMON_H */
@@ -0,0 +1,27 @@
+/* Copyright (c) 2023  Hunter Whyte */
+#ifndef NRF_H
+#define NRF_H
+/* the core debug registers the firmware touches, the cycle counter follows the virtual clock at
+   the nRF52's 64MHz so it only counts busy waits, not the time code takes on the host */
+
+#include "nordic_common.h"
+
+typedef struct {
+  volatile uint32_t CTRL;
+  volatile uint32_t CYCCNT;
+} fake_dwt_t;
+
+typedef struct {
+  volatile uint32_t DEMCR;
+} fake_core_debug_t;
+
+extern fake_core_debug_t fake_core_debug;
+
+fake_dwt_t* fake_dwt_get(void); /* with CYCCNT brought up to the virtual clock */
+
+#define DWT (fake_dwt_get())
+#define CoreDebug (&fake_core_debug)
+#define DWT_CTRL_CYCCNTENA_Msk 0x1U
+#define CoreDebug_DEMCR_TRCENA_Msk (1U << 24)
+
+#endif /* NRF_H */
@@ -0,0 +1,9 @@
+/* Copyright (c) 2023  Hunter Whyte */
+#ifndef NRF_BLE_LESC_H
+#define NRF_BLE_LESC_H
+
+#include "nordic_common.h"
+
+ret_code_t nrf_ble_lesc_request_handler(void);
+
+#endif /* NRF_BLE_LESC_H */
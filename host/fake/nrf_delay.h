@@ -0,0 +1,11 @@
+/* Copyright (c) 2023  Hunter Whyte */
+#ifndef NRF_DELAY_H
+#define NRF_DELAY_H
+/* busy waits move the virtual clock, interrupts that come due meanwhile run once main sleeps */
+
+#include "nordic_common.h"
+
+void nrf_delay_us(uint32_t us_time);
+void nrf_delay_ms(uint32_t ms_time);
+
+#endif /* NRF_DELAY_H */
@@ -0,0 +1,50 @@
+/* Copyright (c) 2023  Hunter Whyte */
+#ifndef NRF_DRV_GPIOTE_H
+#define NRF_DRV_GPIOTE_H
+/* input pins call their handler as an interrupt when the simulation changes their level in the
+   sensed direction */
+
+#include "nrf_gpio.h"
+
+typedef uint32_t nrf_drv_gpiote_pin_t;
+
+typedef enum {
+  NRF_GPIOTE_POLARITY_LOTOHI = 1,
+  NRF_GPIOTE_POLARITY_HITOLO = 2,
+  NRF_GPIOTE_POLARITY_TOGGLE = 3
+} nrf_gpiote_polarity_t;
+
+typedef struct {
+  nrf_gpiote_polarity_t sense;
+  nrf_gpio_pin_pull_t pull;
+  bool is_watcher;
+  bool hi_accuracy;
+  bool skip_gpio_setup;
+} nrf_drv_gpiote_in_config_t;
+
+typedef void (*nrf_drv_gpiote_evt_handler_t)(nrf_drv_gpiote_pin_t pin,
+                                             nrf_gpiote_polarity_t action);
+
+#define GPIOTE_CONFIG_IN_SENSE(s, hi_accu)                                            \
+  {                                                                                   \
+    .sense = (s), .pull = NRF_GPIO_PIN_NOPULL, .is_watcher = false,                   \
+    .hi_accuracy = (hi_accu), .skip_gpio_setup = false                                \
+  }
+#define GPIOTE_CONFIG_IN_SENSE_LOTOHI(hi_accu) \
+  GPIOTE_CONFIG_IN_SENSE(NRF_GPIOTE_POLARITY_LOTOHI, hi_accu)
+#define GPIOTE_CONFIG_IN_SENSE_HITOLO(hi_accu) \
+  GPIOTE_CONFIG_IN_SENSE(NRF_GPIOTE_POLARITY_HITOLO, hi_accu)
+#define GPIOTE_CONFIG_IN_SENSE_TOGGLE(hi_accu) \
+  GPIOTE_CONFIG_IN_SENSE(NRF_GPIOTE_POLARITY_TOGGLE, hi_accu)
+
+ret_code_t nrf_drv_gpiote_init(void);
+void nrf_drv_gpiote_uninit(void);
+ret_code_t nrf_drv_gpiote_in_init(nrf_drv_gpiote_pin_t pin,
+                                  nrf_drv_gpiote_in_config_t const* p_config,
+                                  nrf_drv_gpiote_evt_handler_t evt_handler);
+void nrf_drv_gpiote_in_uninit(nrf_drv_gpiote_pin_t pin);
+void nrf_drv_gpiote_in_event_enable(nrf_drv_gpiote_pin_t pin, bool int_enable);
+void nrf_drv_gpiote_in_event_disable(nrf_drv_gpiote_pin_t pin);
+bool nrf_drv_gpiote_in_is_set(nrf_drv_gpiote_pin_t pin);
+
+#endif /* NRF_DRV_GPIOTE_H */
@@ -0,0 +1,71 @@
+/* Copyright (c) 2023  Hunter Whyte */
+#ifndef NRF_DRV_PWM_H
+#define NRF_DRV_PWM_H
+/* PWM playback on the virtual clock. Each sequence is captured as it starts playing and decoded
+   by a model of the WS2812 chain, see sim_led() */
+
+#include "nordic_common.h"
+
+#define NRF_DRV_PWM_PIN_NOT_USED 0xFF
+#define NRF_DRV_PWM_PIN_INVERTED 0x80
+
+#define NRF_DRV_PWM_FLAG_STOP 0x01
+#define NRF_DRV_PWM_FLAG_LOOP 0x02
+#define NRF_DRV_PWM_FLAG_SIGNAL_END_SEQ0 0x04
+#define NRF_DRV_PWM_FLAG_SIGNAL_END_SEQ1 0x08
+#define NRF_DRV_PWM_FLAG_NO_EVT_FINISHED 0x10
+
+typedef uint16_t nrf_pwm_values_common_t;
+
+typedef enum { NRF_PWM_CLK_16MHz = 0 } nrf_pwm_clk_t;
+typedef enum { NRF_PWM_MODE_UP = 0 } nrf_pwm_mode_t;
+typedef enum { NRF_PWM_LOAD_COMMON = 0 } nrf_pwm_dec_load_t;
+typedef enum { NRF_PWM_STEP_AUTO = 0 } nrf_pwm_dec_step_t;
+
+typedef struct {
+  union {
+    nrf_pwm_values_common_t const* p_common;
+    uint16_t const* p_raw;
+  } values;
+  uint16_t length;
+  uint32_t repeats;
+  uint32_t end_delay;
+} nrf_pwm_sequence_t;
+
+#define NRF_PWM_VALUES_LENGTH(array) (sizeof(array) / sizeof(uint16_t))
+
+typedef struct {
+  uint8_t output_pins[4];
+  uint8_t irq_priority;
+  nrf_pwm_clk_t base_clock;
+  nrf_pwm_mode_t count_mode;
+  uint16_t top_value;
+  nrf_pwm_dec_load_t load_mode;
+  nrf_pwm_dec_step_t step_mode;
+} nrf_drv_pwm_config_t;
+
+typedef enum {
+  NRF_DRV_PWM_EVT_FINISHED,
+  NRF_DRV_PWM_EVT_END_SEQ0,
+  NRF_DRV_PWM_EVT_END_SEQ1,
+  NRF_DRV_PWM_EVT_STOPPED
+} nrf_drv_pwm_evt_type_t;
+
+typedef void (*nrf_drv_pwm_handler_t)(nrf_drv_pwm_evt_type_t event_type);
+
+typedef struct {
+  uint8_t drv_inst_idx;
+} nrf_drv_pwm_t;
+
+#define NRF_DRV_PWM_INSTANCE(id) \
+  { .drv_inst_idx = (id) }
+
+ret_code_t nrf_drv_pwm_init(nrf_drv_pwm_t const* p_instance, nrf_drv_pwm_config_t const* p_config,
+                            nrf_drv_pwm_handler_t handler);
+uint32_t nrf_drv_pwm_complex_playback(nrf_drv_pwm_t const* p_instance,
+                                      nrf_pwm_sequence_t const* p_sequence_0,
+                                      nrf_pwm_sequence_t const* p_sequence_1,
+                                      uint16_t playback_count, uint32_t flags);
+bool nrf_drv_pwm_stop(nrf_drv_pwm_t const* p_instance, bool wait_until_stopped);
+
+#endif /* NRF_DRV_PWM_H */
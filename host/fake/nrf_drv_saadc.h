@@ -0,0 +1,30 @@
+/* Copyright (c) 2023  Hunter Whyte */
+#ifndef NRF_DRV_SAADC_H
+#define NRF_DRV_SAADC_H
+/* blocking conversions return the battery reading set with sim_battery() */
+
+#include "nordic_common.h"
+
+typedef int16_t nrf_saadc_value_t;
+
+typedef enum { NRF_SAADC_INPUT_DISABLED, NRF_SAADC_INPUT_AIN0 } nrf_saadc_input_t;
+
+typedef struct {
+  nrf_saadc_input_t pin_p;
+} nrf_saadc_channel_config_t;
+
+typedef struct {
+  int type;
+} nrf_drv_saadc_evt_t;
+
+typedef void (*nrf_drv_saadc_event_handler_t)(nrf_drv_saadc_evt_t const* p_event);
+
+#define NRF_DRV_SAADC_DEFAULT_CHANNEL_CONFIG_SE(PIN_P) \
+  { .pin_p = (PIN_P) }
+
+ret_code_t nrf_drv_saadc_init(void const* p_config, nrf_drv_saadc_event_handler_t event_handler);
+ret_code_t nrf_drv_saadc_channel_init(uint8_t channel,
+                                      nrf_saadc_channel_config_t const* p_config);
+ret_code_t nrf_drv_saadc_sample_convert(uint8_t channel, nrf_saadc_value_t* p_value);
+
+#endif /* NRF_DRV_SAADC_H */
@@ -0,0 +1,22 @@
+/* Copyright (c) 2023  Hunter Whyte */
+#ifndef NRF_DRV_TWI_H
+#define NRF_DRV_TWI_H
+
+#include "nordic_common.h"
+
+typedef enum {
+  NRF_DRV_TWI_FREQ_100K = 100000,
+  NRF_DRV_TWI_FREQ_250K = 250000,
+  NRF_DRV_TWI_FREQ_400K = 400000
+} nrf_drv_twi_frequency_t;
+
+typedef struct {
+  uint32_t scl;
+  uint32_t sda;
+  nrf_drv_twi_frequency_t frequency;
+  uint8_t interrupt_priority;
+  bool clear_bus_init;
+  bool hold_bus_uninit;
+} nrf_drv_twi_config_t;
+
+#endif /* NRF_DRV_TWI_H */
@@ -0,0 +1,18 @@
+/* Copyright (c) 2023  Hunter Whyte */
+#ifndef NRF_GPIO_H
+#define NRF_GPIO_H
+/* output pins only record their level, see sim_pin() */
+
+#include "nordic_common.h"
+
+typedef enum {
+  NRF_GPIO_PIN_NOPULL = 0,
+  NRF_GPIO_PIN_PULLDOWN = 1,
+  NRF_GPIO_PIN_PULLUP = 3
+} nrf_gpio_pin_pull_t;
+
+void nrf_gpio_cfg_output(uint32_t pin_number);
+void nrf_gpio_pin_set(uint32_t pin_number);
+void nrf_gpio_pin_clear(uint32_t pin_number);
+
+#endif /* NRF_GPIO_H */
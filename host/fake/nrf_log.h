@@ -0,0 +1,18 @@
+/* Copyright (c) 2023  Hunter Whyte */
+#ifndef NRF_LOG_H
+#define NRF_LOG_H
+/* log lines are printed with the virtual time when the simulation is verbose, see
+   sim_set_verbose(). Arguments go through printf so they have to be ints, as with the SDK */
+
+#include "nordic_common.h"
+
+void fake_log(const char* format, ...);
+void fake_log_hexdump(const void* p_data, uint32_t length);
+
+#define NRF_LOG_INFO(...) fake_log(__VA_ARGS__)
+#define NRF_LOG_DEBUG(...) fake_log(__VA_ARGS__)
+#define NRF_LOG_WARNING(...) fake_log(__VA_ARGS__)
+#define NRF_LOG_ERROR(...) fake_log(__VA_ARGS__)
+#define NRF_LOG_HEXDUMP_INFO(p_data, len) fake_log_hexdump((p_data), (len))
+
+#endif /* NRF_LOG_H */
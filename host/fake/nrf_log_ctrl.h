@@ -0,0 +1,14 @@
+/* Copyright (c) 2023  Hunter Whyte */
+#ifndef NRF_LOG_CTRL_H
+#define NRF_LOG_CTRL_H
+/* logs are printed straight away, nothing is ever left to process */
+
+#include "nrf_log.h"
+
+#define NRF_LOG_INIT(timestamp_func) NRF_SUCCESS
+#define NRF_LOG_PROCESS() false
+#define NRF_LOG_FLUSH() \
+  do {                  \
+  } while (0)
+
+#endif /* NRF_LOG_CTRL_H */
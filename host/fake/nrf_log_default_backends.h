@@ -0,0 +1,9 @@
+/* Copyright (c) 2023  Hunter Whyte */
+#ifndef NRF_LOG_DEFAULT_BACKENDS_H
+#define NRF_LOG_DEFAULT_BACKENDS_H
+
+#define NRF_LOG_DEFAULT_BACKENDS_INIT() \
+  do {                                  \
+  } while (0)
+
+#endif /* NRF_LOG_DEFAULT_BACKENDS_H */
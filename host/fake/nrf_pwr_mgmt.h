@@ -0,0 +1,13 @@
+/* Copyright (c) 2023  Hunter Whyte */
+#ifndef NRF_PWR_MGMT_H
+#define NRF_PWR_MGMT_H
+/* nrf_pwr_mgmt_run() is where main() hands control back to the simulation, it returns once an
+   interrupt has been dispatched */
+
+#include "nordic_common.h"
+
+ret_code_t nrf_pwr_mgmt_init(void);
+void nrf_pwr_mgmt_run(void);
+void nrf_pwr_mgmt_feed(void);
+
+#endif /* NRF_PWR_MGMT_H */
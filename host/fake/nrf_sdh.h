@@ -0,0 +1,10 @@
+/* Copyright (c) 2023  Hunter Whyte */
+#ifndef NRF_SDH_H
+#define NRF_SDH_H
+
+#include "nordic_common.h"
+
+ret_code_t nrf_sdh_enable_request(void);
+bool nrf_sdh_is_enabled(void);
+
+#endif /* NRF_SDH_H */
@@ -0,0 +1,26 @@
+/* Copyright (c) 2023  Hunter Whyte */
+#ifndef NRF_SDH_ANT_H
+#define NRF_SDH_ANT_H
+/* the observer is registered when the macro runs, rather than placed in a section */
+
+#include "nordic_common.h"
+
+typedef struct {
+  uint8_t ANT_MESSAGE_aucPayload[8];
+} ANT_MESSAGE;
+
+typedef struct {
+  ANT_MESSAGE message;
+  uint8_t channel;
+  uint8_t event;
+} ant_evt_t;
+
+typedef void (*nrf_sdh_ant_evt_handler_t)(ant_evt_t* p_ant_evt, void* p_context);
+
+ret_code_t nrf_sdh_ant_enable(void);
+void fake_ant_observer_set(nrf_sdh_ant_evt_handler_t handler, void* p_context);
+
+#define NRF_SDH_ANT_OBSERVER(_name, _prio, _handler, _context) \
+  fake_ant_observer_set((_handler), (_context))
+
+#endif /* NRF_SDH_ANT_H */
@@ -0,0 +1,24 @@
+/* Copyright (c) 2023  Hunter Whyte */
+#ifndef NRF_SDH_BLE_H
+#define NRF_SDH_BLE_H
+/* BLE is simulated at the level of bracelet_ble.h, connections and NUS writes are injected
+   straight into its handlers so no stack events are ever observed */
+
+#include "nordic_common.h"
+
+typedef struct {
+  uint16_t evt_id;
+} ble_evt_t;
+
+typedef void (*nrf_sdh_ble_evt_handler_t)(ble_evt_t const* p_ble_evt, void* p_context);
+
+ret_code_t nrf_sdh_ble_default_cfg_set(uint8_t conn_cfg_tag, uint32_t* p_ram_start);
+ret_code_t nrf_sdh_ble_enable(uint32_t* p_app_ram_start);
+
+#define NRF_SDH_BLE_OBSERVER(_name, _prio, _handler, _context) \
+  do {                                                         \
+    (void)(_handler);                                          \
+    (void)(_context);                                          \
+  } while (0)
+
+#endif /* NRF_SDH_BLE_H */
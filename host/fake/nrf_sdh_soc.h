@@ -0,0 +1,10 @@
+/* Copyright (c) 2023  Hunter Whyte */
+#ifndef NRF_SDH_SOC_H
+#define NRF_SDH_SOC_H
+
+#include "nordic_common.h"
+
+/* ends the simulation's main loop, see sim_off() */
+uint32_t sd_power_system_off(void);
+
+#endif /* NRF_SDH_SOC_H */
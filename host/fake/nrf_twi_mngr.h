@@ -0,0 +1,60 @@
+/* Copyright (c) 2023  Hunter Whyte */
+#ifndef NRF_TWI_MNGR_H
+#define NRF_TWI_MNGR_H
+/* TWI transaction manager with the SDK's queueing: one transaction runs while up to queue_size
+   wait, scheduling more fails with NRF_ERROR_NO_MEM. The bus is timed at the configured
+   frequency and transfers go to a model of the MMA8652/MMA8653 */
+
+#include "nordic_common.h"
+#include "nrf_drv_twi.h"
+
+#define NRF_TWI_MNGR_NO_STOP 0x01
+#define NRF_TWI_MNGR_WRITE_OP(address) (((address) << 1) | 0)
+#define NRF_TWI_MNGR_READ_OP(address) (((address) << 1) | 1)
+#define NRF_TWI_MNGR_IS_READ_OP(operation) ((operation) & 1)
+#define NRF_TWI_MNGR_OP_ADDRESS(operation) ((operation) >> 1)
+
+typedef void (*nrf_twi_mngr_callback_t)(ret_code_t result, void* p_user_data);
+
+typedef struct {
+  uint8_t* p_data;
+  uint8_t length;
+  uint8_t operation;
+  uint8_t flags;
+} nrf_twi_mngr_transfer_t;
+
+typedef struct {
+  nrf_twi_mngr_callback_t callback;
+  void* p_user_data;
+  nrf_twi_mngr_transfer_t const* p_transfers;
+  uint8_t number_of_transfers;
+  nrf_drv_twi_config_t const* p_required_twi_cfg;
+} nrf_twi_mngr_transaction_t;
+
+#define NRF_TWI_MNGR_TRANSFER(_operation, _p_data, _length, _flags)                     \
+  {                                                                                     \
+    .p_data = (uint8_t*)(_p_data), .length = (_length), .operation = (_operation),      \
+    .flags = (_flags)                                                                   \
+  }
+#define NRF_TWI_MNGR_WRITE(address, p_data, length, flags) \
+  NRF_TWI_MNGR_TRANSFER(NRF_TWI_MNGR_WRITE_OP(address), p_data, length, flags)
+#define NRF_TWI_MNGR_READ(address, p_data, length, flags) \
+  NRF_TWI_MNGR_TRANSFER(NRF_TWI_MNGR_READ_OP(address), p_data, length, flags)
+
+typedef struct {
+  uint8_t queue_size;
+} nrf_twi_mngr_t;
+
+#define NRF_TWI_MNGR_DEF(_nrf_twi_mngr_name, _queue_size, _twi_idx) \
+  static const nrf_twi_mngr_t _nrf_twi_mngr_name = {(_queue_size)}
+
+ret_code_t nrf_twi_mngr_init(nrf_twi_mngr_t const* p_nrf_twi_mngr,
+                             nrf_drv_twi_config_t const* p_default_twi_config);
+ret_code_t nrf_twi_mngr_schedule(nrf_twi_mngr_t const* p_nrf_twi_mngr,
+                                 nrf_twi_mngr_transaction_t const* p_transaction);
+ret_code_t nrf_twi_mngr_perform(nrf_twi_mngr_t const* p_nrf_twi_mngr,
+                                nrf_drv_twi_config_t const* p_config,
+                                nrf_twi_mngr_transfer_t const* p_transfers,
+                                uint8_t number_of_transfers, void (*user_function)(void));
+
+#endif /* NRF_TWI_MNGR_H */
@@ -0,0 +1,491 @@
+/* Copyright (c) 2023  Hunter Whyte */
+/* virtual clock, events and the main() coroutine, with the small SDK fakes that only need them:
+   app_timer, GPIO and GPIOTE, power management, SAADC, softdevice enable and logging */
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <ucontext.h>
+
+#include "app_error.h"
+#include "app_timer.h"
+#include "nrf.h"
+#include "nrf_ble_lesc.h"
+#include "nrf_delay.h"
+#include "nrf_drv_gpiote.h"
+#include "nrf_drv_saadc.h"
+#include "nrf_log.h"
+#include "nrf_pwr_mgmt.h"
+#include "nrf_sdh.h"
+#include "nrf_sdh_ant.h"
+#include "nrf_sdh_ble.h"
+#include "nrf_sdh_soc.h"
+
+#include "bracelet.h"
+#include "sim.h"
+#include "sim_fake.h"
+#include "ws2812.h"
+
+int bracelet_main(void);
+
+#define MAX_EVENTS 256
+#define MAX_PINS 32
+#define FIRMWARE_STACK_BYTES (256 * 1024)
+#define CPU_HZ 64000000ULL
+
+typedef struct {
+  uint64_t time;
+  uint64_t order; /* events at the same time run in the order they were added */
+  sim_fn_t fn;
+  void* arg;
+  uint16_t generation;
+  bool used;
+} event_t;
+
+static event_t events[MAX_EVENTS];
+static uint64_t event_order;
+static uint64_t now;
+static uint32_t rtc_start;
+static bool verbose = false;
+static bool booted = false;
+static bool system_off = false;
+static uint32_t wakeups;
+static uint64_t max_isr_ns;     /* longest an event ran, since the last sim_take_max_isr_ns() */
+static uint64_t max_latency_ns; /* latest an event started, since sim_take_max_latency_ns() */
+static ucontext_t sim_context, firmware_context;
+static uint8_t firmware_stack[FIRMWARE_STACK_BYTES];
+
+static fake_dwt_t fake_dwt;
+fake_core_debug_t fake_core_debug;
+
+fake_dwt_t* fake_dwt_get(void) {
+  fake_dwt.CYCCNT = now * CPU_HZ / SIM_S;
+  return &fake_dwt;
+}
+
+/* ######################### CLOCK ######################### */
+uint64_t sim_now(void) {
+  return now;
+}
+
+void sim_set_verbose(bool v) {
+  verbose = v;
+}
+
+int sim_at(uint64_t time_ns, sim_fn_t fn, void* arg) {
+  int i;
+  for (i = 0; i < MAX_EVENTS; i++) {
+    if (!events[i].used) {
+      events[i].used = true;
+      events[i].time = time_ns < now ? now : time_ns;
+      events[i].order = event_order++;
+      events[i].fn = fn;
+      events[i].arg = arg;
+      events[i].generation = (events[i].generation + 1) & 0x7FFF;
+      return i | (events[i].generation << 16);
+    }
+  }
+  fprintf(stderr, "sim: more than %d events pending\n", MAX_EVENTS);
+  exit(2);
+}
+
+void sim_cancel(int event) {
+  int i = event & 0xFFFF;
+  if (event < 0 || i >= MAX_EVENTS) {
+    return;
+  }
+  if (events[i].used && events[i].generation == (event >> 16)) {
+    events[i].used = false;
+  }
+}
+
+static int next_event(void) {
+  int i, next = -1;
+  for (i = 0; i < MAX_EVENTS; i++) {
+    if (!events[i].used) {
+      continue;
+    }
+    if (next < 0 || events[i].time < events[next].time ||
+        (events[i].time == events[next].time && events[i].order < events[next].order)) {
+      next = i;
+    }
+  }
+  return next;
+}
+
+static void firmware_entry(void) {
+  bracelet_main();
+  fprintf(stderr, "sim: main returned\n");
+  exit(2);
+}
+
+/* one pass of the main loop, until it sleeps again */
+static void firmware_resume(void) {
+  if (system_off) {
+    return;
+  }
+  wakeups++;
+  swapcontext(&sim_context, &firmware_context);
+}
+
+void sim_boot(void) {
+  getcontext(&firmware_context);
+  firmware_context.uc_stack.ss_sp = firmware_stack;
+  firmware_context.uc_stack.ss_size = sizeof(firmware_stack);
+  firmware_context.uc_link = NULL;
+  makecontext(&firmware_context, firmware_entry, 0);
+  booted = true;
+  swapcontext(&sim_context, &firmware_context);
+}
+
+void sim_run_until(uint64_t time_ns) {
+  event_t event;
+  uint64_t start;
+  int i;
+  while ((i = next_event()) >= 0 && events[i].time <= time_ns) {
+    event = events[i];
+    events[i].used = false;
+    if (now < event.time) {
+      now = event.time;
+    } else if (now - event.time > max_latency_ns) {
+      /* a busy wait ran the clock past it */
+      max_latency_ns = now - event.time;
+    }
+    start = now;
+    event.fn(event.arg);
+    if (now - start > max_isr_ns) {
+      max_isr_ns = now - start;
+    }
+    if (booted) {
+      firmware_resume();
+    }
+  }
+  if (now < time_ns) {
+    now = time_ns;
+  }
+}
+
+void sim_run(uint64_t duration_ns) {
+  sim_run_until(now + duration_ns);
+}
+
+bool sim_off(void) {
+  return system_off;
+}
+
+uint32_t sim_wakeups(void) {
+  return wakeups;
+}
+
+uint64_t sim_take_max_isr_ns(void) {
+  uint64_t ns = max_isr_ns;
+  max_isr_ns = 0;
+  return ns;
+}
+
+uint64_t sim_take_max_latency_ns(void) {
+  uint64_t ns = max_latency_ns;
+  max_latency_ns = 0;
+  return ns;
+}
+
+void nrf_pwr_mgmt_run(void) {
+  swapcontext(&firmware_context, &sim_context);
+}
+
+ret_code_t nrf_pwr_mgmt_init(void) {
+  return NRF_SUCCESS;
+}
+
+void nrf_pwr_mgmt_feed(void) {}
+
+uint32_t sd_power_system_off(void) {
+  system_off = true;
+  /* never resumed */
+  swapcontext(&firmware_context, &sim_context);
+  return NRF_SUCCESS;
+}
+
+void fake_busy_until(uint64_t time_ns) {
+  if (now < time_ns) {
+    now = time_ns;
+  }
+}
+
+void nrf_delay_us(uint32_t us_time) {
+  now += us_time * SIM_US;
+}
+
+void nrf_delay_ms(uint32_t ms_time) {
+  now += ms_time * SIM_MS;
+}
+
+void app_error_handler(ret_code_t error_code, uint32_t line_num, const char* p_file_name) {
+  fprintf(stderr, "sim: error 0x%x at %s:%u, %.3fms\n", error_code, p_file_name, line_num,
+          (double)now / SIM_MS);
+  exit(2);
+}
+
+/* ######################### LOGGING ######################### */
+void fake_log(const char* format, ...) {
+  va_list args;
+  if (!verbose) {
+    return;
+  }
+  va_start(args, format);
+  printf("%10.3f ", (double)now / SIM_MS);
+  vprintf(format, args);
+  printf("\n");
+  va_end(args);
+}
+
+void fake_log_hexdump(const void* p_data, uint32_t length) {
+  const uint8_t* bytes = p_data;
+  uint32_t i;
+  if (!verbose) {
+    return;
+  }
+  printf("%10.3f", (double)now / SIM_MS);
+  for (i = 0; i < length; i++) {
+    printf(" %02x", bytes[i]);
+  }
+  printf("\n");
+}
+
+/* ######################### APP TIMER ######################### */
+#define MAX_TIMERS 16
+
+static app_timer_t* timers[MAX_TIMERS];
+static uint8_t timer_count;
+
+void sim_rtc_start(uint32_t ticks) {
+  rtc_start = ticks & APP_TIMER_MAX_CNT_VAL;
+}
+
+/* RTC ticks since boot, not wrapped */
+static uint64_t ticks_now(void) {
+  return rtc_start + (now * APP_TIMER_CLOCK_FREQ) / SIM_S;
+}
+
+/* time of the start of a tick */
+static uint64_t tick_time(uint64_t ticks) {
+  return ((ticks - rtc_start) * SIM_S + APP_TIMER_CLOCK_FREQ - 1) / APP_TIMER_CLOCK_FREQ;
+}
+
+static void timer_expired(void* arg) {
+  app_timer_t* timer = arg;
+  timer->event = -1;
+  if (timer->mode == APP_TIMER_MODE_REPEATED) {
+    timer->event = sim_at(tick_time(ticks_now() + timer->interval), timer_expired, timer);
+  } else {
+    timer->active = false;
+  }
+  timer->handler(timer->p_context);
+}
+
+ret_code_t app_timer_init(void) {
+  return NRF_SUCCESS;
+}
+
+ret_code_t app_timer_create(app_timer_id_t const* p_timer_id, app_timer_mode_t mode,
+                            app_timer_timeout_handler_t timeout_handler) {
+  app_timer_t* timer = *p_timer_id;
+  if (timeout_handler == NULL) {
+    return NRF_ERROR_INVALID_PARAM;
+  }
+  if (timer_count >= MAX_TIMERS) {
+    return NRF_ERROR_NO_MEM;
+  }
+  timer->handler = timeout_handler;
+  timer->mode = mode;
+  timer->active = false;
+  timer->event = -1;
+  timers[timer_count++] = timer;
+  return NRF_SUCCESS;
+}
+
+/* as app_timer v2, starting a timer that is already running is ignored */
+ret_code_t app_timer_start(app_timer_id_t timer_id, uint32_t timeout_ticks, void* p_context) {
+  if (timeout_ticks < APP_TIMER_MIN_TIMEOUT_TICKS || timeout_ticks > APP_TIMER_MAX_CNT_VAL) {
+    return NRF_ERROR_INVALID_PARAM;
+  }
+  if (timer_id->handler == NULL) {
+    return NRF_ERROR_INVALID_STATE;
+  }
+  if (timer_id->active) {
+    return NRF_SUCCESS;
+  }
+  timer_id->active = true;
+  timer_id->p_context = p_context;
+  timer_id->interval = timeout_ticks;
+  timer_id->event = sim_at(tick_time(ticks_now() + timeout_ticks), timer_expired, timer_id);
+  return NRF_SUCCESS;
+}
+
+ret_code_t app_timer_stop(app_timer_id_t timer_id) {
+  sim_cancel(timer_id->event);
+  timer_id->event = -1;
+  timer_id->active = false;
+  return NRF_SUCCESS;
+}
+
+uint32_t app_timer_cnt_get(void) {
+  return ticks_now() & APP_TIMER_MAX_CNT_VAL;
+}
+
+uint32_t app_timer_cnt_diff_compute(uint32_t ticks_to, uint32_t ticks_from) {
+  return (ticks_to - ticks_from) & APP_TIMER_MAX_CNT_VAL;
+}
+
+uint32_t sim_timers_active(void) {
+  uint32_t i, count = 0;
+  for (i = 0; i < timer_count; i++) {
+    count += timers[i]->active;
+  }
+  return count;
+}
+
+/* ######################### GPIO ######################### */
+static struct {
+  int8_t output; /* level driven, -1 if never driven */
+  bool level;    /* level seen by GPIOTE */
+  bool enabled;
+  nrf_gpiote_polarity_t sense;
+  nrf_drv_gpiote_evt_handler_t handler;
+} pins[MAX_PINS] = {[0 ...(MAX_PINS - 1)] = {.output = -1, .level = true}};
+
+int sim_pin(uint32_t pin) {
+  return pin < MAX_PINS ? pins[pin].output : -1;
+}
+
+void nrf_gpio_cfg_output(uint32_t pin_number) {}
+
+void nrf_gpio_pin_set(uint32_t pin_number) {
+  pins[pin_number].output = 1;
+  if (pin_number == NPVOUT) {
+    fake_led_power(true);
+  }
+}
+
+void nrf_gpio_pin_clear(uint32_t pin_number) {
+  pins[pin_number].output = 0;
+  if (pin_number == NPVOUT) {
+    fake_led_power(false);
+  }
+}
+
+static void gpiote_event(void* arg) {
+  uint32_t pin = (uintptr_t)arg;
+  if (pins[pin].enabled) {
+    pins[pin].handler(pin, pins[pin].sense);
+  }
+}
+
+/* an interrupt if the edge is the one sensed */
+void fake_pin_input(uint32_t pin, bool level) {
+  bool rising = level && !pins[pin].level;
+  bool falling = !level && pins[pin].level;
+  pins[pin].level = level;
+  if (!pins[pin].enabled) {
+    return;
+  }
+  if ((rising && pins[pin].sense != NRF_GPIOTE_POLARITY_HITOLO) ||
+      (falling && pins[pin].sense != NRF_GPIOTE_POLARITY_LOTOHI)) {
+    sim_at(now, gpiote_event, (void*)(uintptr_t)pin);
+  }
+}
+
+void sim_button(bool down) {
+  fake_pin_input(BTN_PIN, !down);
+}
+
+ret_code_t nrf_drv_gpiote_init(void) {
+  return NRF_SUCCESS;
+}
+
+void nrf_drv_gpiote_uninit(void) {
+  int i;
+  for (i = 0; i < MAX_PINS; i++) {
+    pins[i].enabled = false;
+    pins[i].handler = NULL;
+  }
+}
+
+ret_code_t nrf_drv_gpiote_in_init(nrf_drv_gpiote_pin_t pin,
+                                  nrf_drv_gpiote_in_config_t const* p_config,
+                                  nrf_drv_gpiote_evt_handler_t evt_handler) {
+  if (pin >= MAX_PINS || pins[pin].handler) {
+    return NRF_ERROR_INVALID_STATE;
+  }
+  pins[pin].sense = p_config->sense;
+  pins[pin].handler = evt_handler;
+  return NRF_SUCCESS;
+}
+
+void nrf_drv_gpiote_in_uninit(nrf_drv_gpiote_pin_t pin) {
+  pins[pin].enabled = false;
+  pins[pin].handler = NULL;
+}
+
+void nrf_drv_gpiote_in_event_enable(nrf_drv_gpiote_pin_t pin, bool int_enable) {
+  pins[pin].enabled = int_enable;
+}
+
+void nrf_drv_gpiote_in_event_disable(nrf_drv_gpiote_pin_t pin) {
+  pins[pin].enabled = false;
+}
+
+bool nrf_drv_gpiote_in_is_set(nrf_drv_gpiote_pin_t pin) {
+  return pins[pin].level;
+}
+
+/* ######################### SAADC ######################### */
+static nrf_saadc_value_t battery = (MIN_BATTERY_VOLTAGE + MAX_BATTERY_VOLTAGE) / 2;
+
+void sim_battery(int16_t sample) {
+  battery = sample;
+}
+
+ret_code_t nrf_drv_saadc_init(void const* p_config, nrf_drv_saadc_event_handler_t event_handler) {
+  return NRF_SUCCESS;
+}
+
+ret_code_t nrf_drv_saadc_channel_init(uint8_t channel,
+                                      nrf_saadc_channel_config_t const* p_config) {
+  return NRF_SUCCESS;
+}
+
+ret_code_t nrf_drv_saadc_sample_convert(uint8_t channel, nrf_saadc_value_t* p_value) {
+  *p_value = battery;
+  return NRF_SUCCESS;
+}
+
+/* ######################### SOFTDEVICE ######################### */
+static bool sdh_enabled = false;
+
+ret_code_t nrf_sdh_enable_request(void) {
+  if (sdh_enabled) {
+    return NRF_ERROR_INVALID_STATE;
+  }
+  sdh_enabled = true;
+  return NRF_SUCCESS;
+}
+
+bool nrf_sdh_is_enabled(void) {
+  return sdh_enabled;
+}
+
+ret_code_t nrf_sdh_ble_default_cfg_set(uint8_t conn_cfg_tag, uint32_t* p_ram_start) {
+  return NRF_SUCCESS;
+}
+
+ret_code_t nrf_sdh_ble_enable(uint32_t* p_app_ram_start) {
+  return NRF_SUCCESS;
+}
+
+ret_code_t nrf_sdh_ant_enable(void) {
+  return NRF_SUCCESS;
+}
+
+ret_code_t nrf_ble_lesc_request_handler(void) {
+  return NRF_SUCCESS;
+}
@@ -0,0 +1,16 @@
+/* Copyright (c) 2023  Hunter Whyte */
+#ifndef SIM_FAKE_H
+#define SIM_FAKE_H
+/* shared between the fakes, not for tests */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* level of an input pin driven from outside the nRF */
+void fake_pin_input(uint32_t pin, bool level);
+/* main waits in a busy loop, the clock moves on without running interrupts */
+void fake_busy_until(uint64_t time_ns);
+/* NPVOUT switched */
+void fake_led_power(bool on);
+
+#endif /* SIM_FAKE_H */
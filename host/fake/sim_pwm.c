@@ -0,0 +1,237 @@
+/* Copyright (c) 2023  Hunter Whyte */
+/* PWM playback and the WS2812 chain it drives. A sequence's values are captured when it starts
+   playing, the PWM reads them with EasyDMA as it goes so a half of the ring refilled late shows
+   up as the old values. The chain decodes the values as a WS2812 would, a value high for at
+   least half the bit is a one, and latches once the line has been low for the reset time */
+#include <stdlib.h>
+
+#include "nrf_drv_pwm.h"
+
+#include "sim.h"
+#include "sim_fake.h"
+#include "ws2812.h"
+
+#define PWM_CLOCK_HZ 16000000
+#define ONE_THRESHOLD_TICKS (CYCLE_TICKS / 2)
+
+static nrf_drv_pwm_handler_t handler;
+static uint64_t cycle_ns;
+static nrf_pwm_sequence_t const* sequences[2];
+static uint16_t loops_left;
+static uint32_t playback_flags;
+static uint8_t playing; /* sequence playing */
+static bool running = false;
+static int end_event = -1;
+static uint32_t playbacks;
+static uint64_t latency_max_ns;
+static uint32_t latency_state;
+static uint64_t handler_last; /* time the last interrupt was scheduled for */
+
+/* chain of WS2812s */
+static bool powered = false;
+static sim_rgb_t shown[SIM_MAX_LEDS];
+static uint8_t received[SIM_MAX_LEDS * BYTES_PER_LED]; /* G R B as sent since the last reset */
+static uint32_t bits_received;
+static uint32_t low_cycles;
+static uint32_t frames;
+static uint32_t errors;
+static sim_frame_fn_t frame_fn;
+
+/* ######################### CHAIN ######################### */
+static void chain_latch(void) {
+  uint16_t i, count = bits_received / (8 * BYTES_PER_LED);
+  if (count > SIM_MAX_LEDS) {
+    count = SIM_MAX_LEDS;
+  }
+  bits_received = 0;
+  if (!powered || count == 0) {
+    return;
+  }
+  for (i = 0; i < count; i++) {
+    shown[i].green = received[i * BYTES_PER_LED + G_OFFSET];
+    shown[i].red = received[i * BYTES_PER_LED + R_OFFSET];
+    shown[i].blue = received[i * BYTES_PER_LED + B_OFFSET];
+  }
+  frames++;
+  if (frame_fn) {
+    frame_fn(shown, count);
+  }
+}
+
+static void chain_value(uint16_t value) {
+  uint16_t duty = value & ~PWM_FALLING_EDGE;
+  uint32_t byte;
+  if (duty == 0) {
+    if (++low_cycles == RESET_CYCLES) {
+      chain_latch();
+    }
+    return;
+  }
+  if (!(value & PWM_FALLING_EDGE) || (duty != ONE_HIGH_TICKS && duty != ZERO_HIGH_TICKS) ||
+      (low_cycles && bits_received)) {
+    errors++;
+  }
+  low_cycles = 0;
+  byte = bits_received / 8;
+  if (byte < sizeof(received)) {
+    received[byte] = (received[byte] << 1) | (duty >= ONE_THRESHOLD_TICKS);
+  }
+  bits_received++;
+}
+
+/* line held low once the PWM stops */
+static void chain_idle(void) {
+  if (low_cycles < RESET_CYCLES) {
+    low_cycles = RESET_CYCLES;
+    chain_latch();
+  }
+}
+
+/* NPVOUT switched, the LEDs come up dark */
+void fake_led_power(bool on) {
+  if (on == powered) {
+    return;
+  }
+  powered = on;
+  memset(shown, 0, sizeof(shown));
+  bits_received = 0;
+}
+
+sim_rgb_t sim_led(uint16_t index) {
+  sim_rgb_t dark = {0, 0, 0};
+  return powered && index < SIM_MAX_LEDS ? shown[index] : dark;
+}
+
+uint32_t sim_led_frames(void) {
+  return frames;
+}
+
+uint32_t sim_led_errors(void) {
+  return errors;
+}
+
+void sim_on_frame(sim_frame_fn_t fn) {
+  frame_fn = fn;
+}
+
+/* ######################### PWM ######################### */
+static void handler_event(void* arg) {
+  handler((nrf_drv_pwm_evt_type_t)(uintptr_t)arg);
+}
+
+/* the interrupt runs after a random latency when one is set. The driver handles every event
+   pending in one interrupt in the order they happened, so a later event never overtakes one
+   still waiting */
+static void handler_call(nrf_drv_pwm_evt_type_t event) {
+  uint64_t time = sim_now();
+  if (latency_max_ns) {
+    latency_state ^= latency_state << 13;
+    latency_state ^= latency_state >> 17;
+    latency_state ^= latency_state << 5;
+    time += latency_state % (latency_max_ns + 1);
+  }
+  if (time < handler_last) {
+    time = handler_last;
+  }
+  handler_last = time;
+  sim_at(time, handler_event, (void*)(uintptr_t)event);
+}
+
+static void sequence_end(void* arg);
+
+static void sequence_start(uint8_t index) {
+  nrf_pwm_sequence_t const* sequence = sequences[index];
+  uint32_t i, r;
+  playing = index;
+  for (i = 0; i < sequence->length; i++) {
+    for (r = 0; r <= sequence->repeats; r++) {
+      chain_value(sequence->values.p_common[i]);
+    }
+  }
+  end_event = sim_at(sim_now() + (uint64_t)sequence->length * (sequence->repeats + 1) * cycle_ns +
+                         sequence->end_delay * cycle_ns,
+                     sequence_end, NULL);
+}
+
+static void stopped(void) {
+  running = false;
+  end_event = -1;
+  chain_idle();
+  handler_call(NRF_DRV_PWM_EVT_STOPPED);
+}
+
+static void sequence_end(void* arg) {
+  end_event = -1;
+  if (playing == 0) {
+    sequence_start(1);
+    if (playback_flags & NRF_DRV_PWM_FLAG_SIGNAL_END_SEQ0) {
+      handler_call(NRF_DRV_PWM_EVT_END_SEQ0);
+    }
+    return;
+  }
+  if (--loops_left) {
+    sequence_start(0);
+  }
+  if (playback_flags & NRF_DRV_PWM_FLAG_SIGNAL_END_SEQ1) {
+    handler_call(NRF_DRV_PWM_EVT_END_SEQ1);
+  }
+  if (loops_left) {
+    return;
+  }
+  if (!(playback_flags & NRF_DRV_PWM_FLAG_NO_EVT_FINISHED)) {
+    handler_call(NRF_DRV_PWM_EVT_FINISHED);
+  }
+  if (playback_flags & NRF_DRV_PWM_FLAG_STOP) {
+    stopped();
+  } else {
+    /* last value is held */
+    running = false;
+  }
+}
+
+ret_code_t nrf_drv_pwm_init(nrf_drv_pwm_t const* p_instance, nrf_drv_pwm_config_t const* p_config,
+                            nrf_drv_pwm_handler_t pwm_handler) {
+  if (handler) {
+    return NRF_ERROR_INVALID_STATE;
+  }
+  handler = pwm_handler;
+  cycle_ns = ((uint64_t)p_config->top_value * SIM_S) / PWM_CLOCK_HZ;
+  return NRF_SUCCESS;
+}
+
+uint32_t nrf_drv_pwm_complex_playback(nrf_drv_pwm_t const* p_instance,
+                                      nrf_pwm_sequence_t const* p_sequence_0,
+                                      nrf_pwm_sequence_t const* p_sequence_1,
+                                      uint16_t playback_count, uint32_t flags) {
+  sim_cancel(end_event);
+  sequences[0] = p_sequence_0;
+  sequences[1] = p_sequence_1;
+  loops_left = playback_count;
+  playback_flags = flags;
+  running = true;
+  playbacks++;
+  sequence_start(0);
+  return 0;
+}
+
+bool nrf_drv_pwm_stop(nrf_drv_pwm_t const* p_instance, bool wait_until_stopped) {
+  if (!running) {
+    return true;
+  }
+  sim_cancel(end_event);
+  stopped();
+  return true;
+}
+
+bool sim_pwm_running(void) {
+  return running;
+}
+
+uint32_t sim_pwm_playbacks(void) {
+  return playbacks;
+}
+
+void sim_pwm_latency(uint64_t max_ns, uint32_t seed) {
+  latency_max_ns = max_ns;
+  latency_state = seed ? seed : 1;
+}
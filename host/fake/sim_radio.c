@@ -0,0 +1,407 @@
+/* Copyright (c) 2023  Hunter Whyte */
+/* ANT channels, BLE at the level of bracelet_ble.h, the NFC tag and flash storage. Calls the
+   softdevice would reject with an error fail the same way here, so the firmware's
+   APP_ERROR_CHECKs catch them */
+#include <stdio.h>
+
+#include "ant_channel_config.h"
+#include "ant_error.h"
+#include "ant_interface.h"
+#include "ant_parameters.h"
+#include "app_error.h"
+#include "fds.h"
+#include "nfc_t4t_lib.h"
+#include "nrf_sdh_ant.h"
+#include "nrf_sdh_ble.h"
+
+#include "bracelet.h"
+#include "bracelet_ble.h"
+#include "common.h"
+#include "sim.h"
+
+/* ######################### ANT ######################### */
+#define MAX_RX 32
+
+typedef enum {
+  CHANNEL_UNASSIGNED,
+  CHANNEL_ASSIGNED,
+  CHANNEL_OPEN,
+  CHANNEL_CLOSING
+} channel_state_e;
+
+static channel_state_e channels[NUM_CHANNELS];
+static uint16_t channel_periods[NUM_CHANNELS];
+static nrf_sdh_ant_evt_handler_t ant_handler;
+static void* ant_context;
+static ant_evt_t rx_events[MAX_RX];
+static uint8_t rx_next;
+
+void fake_ant_observer_set(nrf_sdh_ant_evt_handler_t handler, void* p_context) {
+  ant_handler = handler;
+  ant_context = p_context;
+}
+
+static void ant_event(void* arg) {
+  ant_evt_t* evt = arg;
+  if (ant_handler) {
+    ant_handler(evt, ant_context);
+  }
+}
+
+ret_code_t ant_channel_init(ant_channel_config_t const* p_config) {
+  if (p_config->channel_number >= NUM_CHANNELS) {
+    return NRF_ERROR_INVALID_PARAM;
+  }
+  channels[p_config->channel_number] = CHANNEL_ASSIGNED;
+  channel_periods[p_config->channel_number] = p_config->channel_period;
+  return NRF_SUCCESS;
+}
+
+uint32_t sd_ant_channel_search_timeout_set(uint8_t ucChannel, uint8_t ucTimeout) {
+  return ucChannel < NUM_CHANNELS ? NRF_SUCCESS : NRF_ERROR_INVALID_PARAM;
+}
+
+uint32_t sd_ant_channel_open(uint8_t ucChannel) {
+  if (ucChannel >= NUM_CHANNELS || channels[ucChannel] != CHANNEL_ASSIGNED) {
+    return NRF_ANT_ERROR_CHANNEL_IN_WRONG_STATE;
+  }
+  channels[ucChannel] = CHANNEL_OPEN;
+  return NRF_SUCCESS;
+}
+
+static void channel_closed(void* arg) {
+  ant_evt_t* evt = &rx_events[rx_next++ % MAX_RX];
+  evt->channel = (uintptr_t)arg;
+  evt->event = EVENT_CHANNEL_CLOSED;
+  channels[evt->channel] = CHANNEL_ASSIGNED;
+  ant_event(evt);
+}
+
+/* the channel closes at its next period */
+uint32_t sd_ant_channel_close(uint8_t ucChannel) {
+  if (ucChannel >= NUM_CHANNELS || channels[ucChannel] != CHANNEL_OPEN) {
+    return NRF_ANT_ERROR_CHANNEL_IN_WRONG_STATE;
+  }
+  channels[ucChannel] = CHANNEL_CLOSING;
+  sim_at(sim_now() + (channel_periods[ucChannel] * SIM_S) / 32768, channel_closed,
+         (void*)(uintptr_t)ucChannel);
+  return NRF_SUCCESS;
+}
+
+bool sim_ant_open(uint8_t channel) {
+  return channel < NUM_CHANNELS && channels[channel] == CHANNEL_OPEN;
+}
+
+bool sim_ant_rx(uint8_t channel, const uint8_t payload[8]) {
+  ant_evt_t* evt;
+  if (!sim_ant_open(channel)) {
+    return false;
+  }
+  evt = &rx_events[rx_next++ % MAX_RX];
+  evt->channel = channel;
+  evt->event = EVENT_RX;
+  memcpy(evt->message.ANT_MESSAGE_aucPayload, payload, 8);
+  sim_at(sim_now(), ant_event, evt);
+  return true;
+}
+
+/* ######################### BLE ######################### */
+#define ADVERTISING_S (APP_ADV_DURATION / 100) /* fast advertising timeout in 10ms units */
+
+static bool advertising = false;
+static bool connected = false;
+static int advertising_event = -1;
+
+static void advertising_timeout(void* arg) {
+  advertising_event = -1;
+  advertising = false;
+}
+
+static void advertising_begin(void) {
+  advertising = true;
+  advertising_event = sim_at(sim_now() + ADVERTISING_S * SIM_S, advertising_timeout, NULL);
+}
+
+static void advertising_end(void) {
+  advertising = false;
+  sim_cancel(advertising_event);
+  advertising_event = -1;
+}
+
+void ble_init(void) {}
+
+void ble_evt_handler(ble_evt_t const* p_ble_evt, void* p_context) {}
+
+void advertising_start(void) {
+  if (advertising) {
+    app_error_handler(NRF_ERROR_INVALID_STATE, __LINE__, __FILE__);
+  }
+  advertising_begin();
+}
+
+void advertising_stop(void) {
+  if (!advertising) {
+    app_error_handler(NRF_ERROR_INVALID_STATE, __LINE__, __FILE__);
+  }
+  advertising_end();
+}
+
+static void disconnected(void* arg) {
+  connected = false;
+  ble_disconnect_handler();
+  /* the advertising module starts again on disconnect */
+  advertising_begin();
+}
+
+void ble_disconnect(void) {
+  if (!connected) {
+    app_error_handler(NRF_ERROR_INVALID_STATE, __LINE__, __FILE__);
+  }
+  sim_at(sim_now(), disconnected, NULL);
+}
+
+void ble_send(char* data_array, uint8_t length) {}
+
+static void ble_connected(void* arg) {
+  advertising_end();
+  connected = true;
+  ble_connect_handler();
+  check_battery();
+}
+
+bool sim_ble_advertising(void) {
+  return advertising;
+}
+
+bool sim_ble_connected(void) {
+  return connected;
+}
+
+bool sim_ble_connect(void) {
+  if (!advertising) {
+    return false;
+  }
+  sim_at(sim_now(), ble_connected, NULL);
+  return true;
+}
+
+void sim_ble_disconnect(void) {
+  if (connected) {
+    sim_at(sim_now(), disconnected, NULL);
+  }
+}
+
+static uint8_t nus_data[4];
+
+static void nus_rx(void* arg) {
+  ble_data_handler(nus_data[0], nus_data[1], nus_data[2], nus_data[3]);
+}
+
+/* writes of 3 bytes or less are dropped by the NUS handler */
+bool sim_nus_rx(const uint8_t* data, uint16_t length) {
+  if (!connected) {
+    return false;
+  }
+  if (length > 3) {
+    memcpy(nus_data, data, sizeof(nus_data));
+    sim_at(sim_now(), nus_rx, NULL);
+  }
+  return true;
+}
+
+/* ######################### FLASH ######################### */
+#define MAX_RECORDS 8
+#define RECORD_WORDS 4
+#define FLASH_WRITE_NS (2 * SIM_MS)
+#define NDEF_FILE_ID 0x1111 /* FILE_ID and REC_KEY in nfc.c */
+#define NDEF_REC_KEY 0x2222
+
+typedef struct {
+  fds_header_t header;
+  uint32_t words[RECORD_WORDS];
+  bool valid;
+  bool dirty; /* deleted, space is only reclaimed by fds_gc() */
+} record_t;
+
+static record_t records[MAX_RECORDS];
+static fds_cb_t fds_handler;
+static fds_evt_t fds_events[8];
+static uint8_t fds_next;
+
+static void fds_event(void* arg) {
+  if (fds_handler) {
+    fds_handler(arg);
+  }
+}
+
+static void fds_complete(fds_evt_id_t id, uint64_t delay) {
+  fds_evt_t* evt = &fds_events[fds_next++ % ARRAY_SIZE(fds_events)];
+  evt->id = id;
+  evt->result = NRF_SUCCESS;
+  sim_at(sim_now() + delay, fds_event, evt);
+}
+
+static record_t* record_store(uint16_t file_id, uint16_t key, void const* p_data,
+                              uint32_t length_words) {
+  uint32_t i;
+  if (length_words > RECORD_WORDS) {
+    return NULL;
+  }
+  for (i = 0; i < MAX_RECORDS; i++) {
+    if (!records[i].valid && !records[i].dirty) {
+      records[i].header.file_id = file_id;
+      records[i].header.record_key = key;
+      records[i].header.length_words = length_words;
+      memset(records[i].words, 0, sizeof(records[i].words));
+      memcpy(records[i].words, p_data, length_words * sizeof(uint32_t));
+      records[i].valid = true;
+      return &records[i];
+    }
+  }
+  return NULL;
+}
+
+ret_code_t fds_register(fds_cb_t cb) {
+  fds_handler = cb;
+  return NRF_SUCCESS;
+}
+
+ret_code_t fds_init(void) {
+  fds_evt_t evt = {FDS_EVT_INIT, NRF_SUCCESS};
+  fds_handler(&evt);
+  return NRF_SUCCESS;
+}
+
+ret_code_t fds_record_find(uint16_t file_id, uint16_t record_key, fds_record_desc_t* p_desc,
+                           fds_find_token_t* p_token) {
+  uint32_t i;
+  for (i = p_token->index; i < MAX_RECORDS; i++) {
+    if (records[i].valid && records[i].header.file_id == file_id &&
+        records[i].header.record_key == record_key) {
+      p_desc->record_id = i + 1;
+      p_token->index = i + 1;
+      return NRF_SUCCESS;
+    }
+  }
+  return FDS_ERR_NOT_FOUND;
+}
+
+ret_code_t fds_record_open(fds_record_desc_t* p_desc, fds_flash_record_t* p_flash_record) {
+  record_t* record;
+  if (p_desc->record_id == 0 || !records[p_desc->record_id - 1].valid) {
+    return FDS_ERR_NOT_FOUND;
+  }
+  record = &records[p_desc->record_id - 1];
+  p_flash_record->p_header = &record->header;
+  p_flash_record->p_data = record->words;
+  return NRF_SUCCESS;
+}
+
+ret_code_t fds_record_close(fds_record_desc_t* p_desc) {
+  return NRF_SUCCESS;
+}
+
+ret_code_t fds_record_write(fds_record_desc_t* p_desc, fds_record_t const* p_record) {
+  record_t* record = record_store(p_record->file_id, p_record->key, p_record->data.p_data,
+                                  p_record->data.length_words);
+  if (!record) {
+    return FDS_ERR_NO_SPACE_IN_FLASH;
+  }
+  if (p_desc) {
+    p_desc->record_id = record - records + 1;
+  }
+  fds_complete(FDS_EVT_WRITE, FLASH_WRITE_NS);
+  return NRF_SUCCESS;
+}
+
+ret_code_t fds_record_update(fds_record_desc_t* p_desc, fds_record_t const* p_record) {
+  record_t* record = record_store(p_record->file_id, p_record->key, p_record->data.p_data,
+                                  p_record->data.length_words);
+  if (!record) {
+    return FDS_ERR_NO_SPACE_IN_FLASH;
+  }
+  if (p_desc->record_id) {
+    records[p_desc->record_id - 1].valid = false;
+    records[p_desc->record_id - 1].dirty = true;
+  }
+  p_desc->record_id = record - records + 1;
+  fds_complete(FDS_EVT_UPDATE, FLASH_WRITE_NS);
+  return NRF_SUCCESS;
+}
+
+ret_code_t fds_gc(void) {
+  uint32_t i;
+  for (i = 0; i < MAX_RECORDS; i++) {
+    records[i].dirty = false;
+  }
+  fds_complete(FDS_EVT_GC, 10 * FLASH_WRITE_NS);
+  return NRF_SUCCESS;
+}
+
+void sim_flash_group(uint8_t group) {
+  uint32_t word = group;
+  record_store(NDEF_FILE_ID, NDEF_REC_KEY, &word, 1);
+}
+
+int sim_flash_group_stored(void) {
+  fds_find_token_t token = {0};
+  fds_record_desc_t desc;
+  if (fds_record_find(NDEF_FILE_ID, NDEF_REC_KEY, &desc, &token) != NRF_SUCCESS) {
+    return -1;
+  }
+  return records[desc.record_id - 1].words[0] & 0xFF;
+}
+
+/* ######################### NFC ######################### */
+static nfc_t4t_callback_t nfc_handler;
+static void* nfc_context;
+static uint8_t* nfc_buffer;
+static size_t nfc_buffer_length;
+static size_t nfc_length; /* NLEN of the last write */
+static bool emulating = false;
+
+static void nfc_event(void* arg) {
+  nfc_handler(nfc_context, (nfc_t4t_event_t)(uintptr_t)arg, nfc_buffer, nfc_length, 0);
+}
+
+ret_code_t nfc_t4t_setup(nfc_t4t_callback_t callback, void* p_context) {
+  nfc_handler = callback;
+  nfc_context = p_context;
+  return NRF_SUCCESS;
+}
+
+ret_code_t nfc_t4t_ndef_rwpayload_set(uint8_t* p_emulation_buffer, size_t buffer_length) {
+  nfc_buffer = p_emulation_buffer;
+  nfc_buffer_length = buffer_length;
+  return NRF_SUCCESS;
+}
+
+ret_code_t nfc_t4t_emulation_start(void) {
+  emulating = true;
+  return NRF_SUCCESS;
+}
+
+/* a well known text record in English: NLEN, header, type length, payload length, 'T', status
+   byte with the language code length, "en" and the text */
+bool sim_nfc_write(const char* text) {
+  size_t text_length = strlen(text);
+  size_t message_length = 7 + text_length;
+  if (!emulating || NLEN_FIELD_SIZE + message_length > nfc_buffer_length) {
+    return false;
+  }
+  nfc_buffer[0] = message_length >> 8;
+  nfc_buffer[1] = message_length & 0xFF;
+  nfc_buffer[2] = 0xD1;
+  nfc_buffer[3] = 0x01;
+  nfc_buffer[4] = 3 + text_length;
+  nfc_buffer[5] = 'T';
+  nfc_buffer[6] = 0x02;
+  nfc_buffer[7] = 'e';
+  nfc_buffer[8] = 'n';
+  memcpy(&nfc_buffer[9], text, text_length);
+  nfc_length = message_length;
+  sim_at(sim_now(), nfc_event, (void*)(uintptr_t)NFC_T4T_EVENT_FIELD_ON);
+  sim_at(sim_now(), nfc_event, (void*)(uintptr_t)NFC_T4T_EVENT_NDEF_UPDATED);
+  sim_at(sim_now() + SIM_MS, nfc_event, (void*)(uintptr_t)NFC_T4T_EVENT_FIELD_OFF);
+  return true;
+}
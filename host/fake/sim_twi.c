@@ -0,0 +1,462 @@
+/* Copyright (c) 2023  Hunter Whyte */
+/* TWI transaction manager and the accelerometer on the bus. Transactions take the time their
+   bytes need at the bus frequency and act on the sensor when they complete.
+   The sensor model covers what the firmware uses of the MMA8652 and MMA8653:
+   - registers written in standby only, while active CTRL_REG1's active bit is the only change
+   - auto-increment through the output registers, skipping the LSBs with F_READ and wrapping to
+     OUT_X_MSB with the FIFO on, where each wrap moves to the next sample
+   - 10 bit samples on the MMA8653 and 12 bit on the MMA8652, left justified, at the data rate
+   - the MMA8652's 32 sample FIFO with its watermark
+   - data ready, FIFO, motion and (MMA8652 only) transient interrupts, routed by CTRL_REG4 and
+     CTRL_REG5 to INT1, open drain and active low. Events latch until the source is read
+   The transient engine's high pass filter is a single pole following 1/8 of each sample, close
+   to the sensor's at 50Hz but not its exact response */
+#include <stdlib.h>
+
+#include "nrf_drv_gpiote.h"
+#include "nrf_twi_mngr.h"
+
+#include "bracelet.h"
+#include "mma865.h"
+#include "sim.h"
+#include "sim_fake.h"
+
+#define MAX_QUEUE 16
+
+#define REG_F_STATUS 0x00U
+#define REG_INT_SOURCE 0x0CU
+#define REG_HP_FILTER_CUTOFF 0x0FU
+#define REG_FF_MT_SRC 0x16U
+#define REG_FF_MT_THS 0x17U
+#define REG_FF_MT_COUNT 0x18U
+#define REG_TRANSIENT_SRC 0x1EU
+#define REG_TRANSIENT_THS 0x1FU
+#define REG_TRANSIENT_COUNT 0x20U
+#define NUM_REGS 0x32U
+#define STATUS_ZYXDR 0x08U
+#define STATUS_ZYXOW 0x80U
+#define THS_MG 63 /* detection threshold step */
+
+/* ######################### SENSOR ######################### */
+static uint8_t who_am_i = MMA8653_ID;
+static uint8_t regs[NUM_REGS];
+static uint8_t pointer;
+static uint8_t status;
+static uint8_t int_source;
+static uint8_t ff_mt_src;
+static uint8_t transient_src;
+static int16_t sample[3]; /* last sample, left justified */
+static int16_t fifo_samples[MMA865_FIFO_SIZE][3];
+static uint8_t fifo_count;
+static bool fifo_overflow;
+static int32_t high_pass[3]; /* low pass state of the transient filter in mg << 3 */
+static int16_t constant_mg[3] = {0, 0, 1000};
+static sim_acc_fn_t source_fn;
+static void* source_ctx;
+static int sample_event = -1;
+static uint32_t samples;
+static uint32_t ignored_writes;
+static bool initialized = false;
+
+/* output data rate of each CTRL_REG1 DR setting */
+static const uint64_t sample_period_ns[8] = {
+    1250 * SIM_US, 2500 * SIM_US, 5 * SIM_MS, 10 * SIM_MS,
+    20 * SIM_MS,   80 * SIM_MS,   160 * SIM_MS, 640 * SIM_MS};
+
+static bool has_fifo(void) {
+  return who_am_i == MMA8652_ID;
+}
+
+static bool fifo_on(void) {
+  return has_fifo() && (regs[MMA865_REG_F_SETUP] >> 6);
+}
+
+static void sensor_init(void) {
+  if (initialized) {
+    return;
+  }
+  initialized = true;
+  regs[MMA865_REG_WHO_AM_I] = who_am_i;
+}
+
+static void interrupt_update(void) {
+  bool asserted = int_source & regs[MMA865_CTRL_REG4] & regs[MMA865_CTRL_REG5];
+  bool active_high = regs[MMA865_CTRL_REG3] & 0x2;
+  fake_pin_input(ACC_INT1, active_high ? asserted : !asserted);
+}
+
+static int16_t sample_value(int16_t mg) {
+  uint8_t fs = regs[MMA865_XYZ_DATA_CFG] & 0x3;
+  int32_t v = ((int32_t)mg * (16384 >> fs)) / 1000;
+  if (v > INT16_MAX) {
+    v = INT16_MAX;
+  } else if (v < INT16_MIN) {
+    v = INT16_MIN;
+  }
+  return v & (has_fifo() ? 0xFFF0 : 0xFFC0);
+}
+
+static void sample_detect(const int16_t* mg) {
+  uint8_t cfg = regs[MMA865_REG_FF_MT_CFG];
+  int32_t ths = (regs[REG_FF_MT_THS] & 0x7F) * THS_MG;
+  int32_t hp;
+  uint8_t axis, src = 0;
+  bool all_under = true;
+
+  /* motion on raw acceleration, freefall if OAE is clear */
+  if (cfg & 0x38) {
+    for (axis = 0; axis < 3; axis++) {
+      if (!(cfg & (0x08 << axis))) {
+        continue;
+      }
+      if (abs(mg[axis]) > ths) {
+        src |= 0x02 << (axis * 2);
+        all_under = false;
+      }
+    }
+    if ((cfg & 0x40) ? src != 0 : all_under) {
+      ff_mt_src = 0x80 | src;
+      int_source |= MMA865_INT_FF_MT;
+    } else if (!(cfg & 0x80)) {
+      ff_mt_src = 0;
+      int_source &= ~MMA865_INT_FF_MT;
+    }
+  }
+  if (!has_fifo()) {
+    return;
+  }
+  /* transient through the high pass filter */
+  cfg = regs[MMA865_REG_TRANSIENT_CFG];
+  ths = (regs[REG_TRANSIENT_THS] & 0x7F) * THS_MG;
+  src = 0;
+  for (axis = 0; axis < 3; axis++) {
+    hp = mg[axis] - (high_pass[axis] >> 3);
+    high_pass[axis] += hp;
+    if (cfg & 0x1) {
+      hp = mg[axis];
+    }
+    if ((cfg & (0x02 << axis)) && abs(hp) > ths) {
+      src |= 0x02 << (axis * 2);
+    }
+  }
+  if (src) {
+    transient_src = 0x40 | src;
+    int_source |= MMA865_INT_TRANS;
+  } else if (!(cfg & 0x10)) {
+    transient_src = 0;
+    int_source &= ~MMA865_INT_TRANS;
+  }
+}
+
+static void sample_take(void* arg) {
+  int16_t mg[3], value[3];
+  uint8_t axis, watermark;
+
+  sample_event = sim_at(sim_now() + sample_period_ns[(regs[MMA865_CTRL_REG1] >> 3) & 0x7],
+                        sample_take, NULL);
+  samples++;
+  memcpy(mg, constant_mg, sizeof(mg));
+  if (source_fn) {
+    source_fn(sim_now(), mg, source_ctx);
+  }
+  for (axis = 0; axis < 3; axis++) {
+    value[axis] = sample_value(mg[axis]);
+  }
+  if (fifo_on()) {
+    if (fifo_count == MMA865_FIFO_SIZE) {
+      fifo_overflow = true;
+      if ((regs[MMA865_REG_F_SETUP] >> 6) == 1) {
+        /* circular, the oldest sample is dropped */
+        memmove(fifo_samples[0], fifo_samples[1], sizeof(fifo_samples[0]) * --fifo_count);
+      }
+    }
+    if (fifo_count < MMA865_FIFO_SIZE) {
+      memcpy(fifo_samples[fifo_count++], value, sizeof(value));
+    }
+    watermark = regs[MMA865_REG_F_SETUP] & MMA865_F_CNT_MASK;
+    if (watermark && fifo_count >= watermark) {
+      int_source |= MMA865_INT_FIFO;
+    }
+  } else {
+    memcpy(sample, value, sizeof(value));
+    status |= (status & STATUS_ZYXDR) ? STATUS_ZYXOW : STATUS_ZYXDR;
+    int_source |= MMA865_INT_DRDY;
+  }
+  sample_detect(mg);
+  interrupt_update();
+}
+
+static void ctrl_reg1_write(uint8_t value) {
+  bool was_active = regs[MMA865_CTRL_REG1] & 0x1;
+  regs[MMA865_CTRL_REG1] = value;
+  if (!was_active && (value & 0x1)) {
+    sample_event = sim_at(sim_now() + sample_period_ns[(value >> 3) & 0x7], sample_take, NULL);
+  } else if (was_active && !(value & 0x1)) {
+    sim_cancel(sample_event);
+    sample_event = -1;
+  }
+}
+
+static bool writable(uint8_t reg) {
+  switch (reg) {
+    case MMA865_REG_F_SETUP:
+    case MMA865_REG_TRANSIENT_CFG:
+    case REG_TRANSIENT_THS:
+    case REG_TRANSIENT_COUNT:
+      return has_fifo();
+    case MMA865_XYZ_DATA_CFG:
+    case REG_HP_FILTER_CUTOFF:
+    case MMA865_REG_FF_MT_CFG:
+    case REG_FF_MT_THS:
+    case REG_FF_MT_COUNT:
+      return true;
+    default:
+      return reg >= MMA865_CTRL_REG1 && reg <= MMA865_CTRL_REG5;
+  }
+}
+
+static void register_write(uint8_t value) {
+  uint8_t reg = pointer++;
+  bool active = regs[MMA865_CTRL_REG1] & 0x1;
+  if (reg == MMA865_CTRL_REG1) {
+    ctrl_reg1_write(active ? (regs[reg] & ~0x1) | (value & 0x1) : value);
+  } else if (active) {
+    ignored_writes++;
+  } else if (reg < NUM_REGS && writable(reg)) {
+    regs[reg] = value;
+  }
+}
+
+static uint8_t register_read(void) {
+  uint8_t reg = pointer;
+  uint8_t value, last_out;
+  int16_t* out;
+  bool fifo = fifo_on();
+  bool fast = regs[MMA865_CTRL_REG1] & 0x2;
+
+  if (reg == REG_F_STATUS) {
+    if (fifo) {
+      uint8_t watermark = regs[MMA865_REG_F_SETUP] & MMA865_F_CNT_MASK;
+      value = (fifo_overflow << 7) | ((watermark && fifo_count >= watermark) << 6) | fifo_count;
+      fifo_overflow = false;
+      int_source &= ~MMA865_INT_FIFO;
+      interrupt_update();
+    } else {
+      value = status;
+    }
+    pointer = MMA865_REG_OUT_X_MSB;
+    return value;
+  }
+  if (reg >= MMA865_REG_OUT_X_MSB && reg <= MMA865_REG_OUT_Z_LSB) {
+    out = fifo ? fifo_samples[0] : sample;
+    value = (reg & 1) ? (uint16_t)out[(reg - 1) / 2] >> 8 : out[(reg - 1) / 2] & 0xFF;
+    if (!fifo && reg == MMA865_REG_OUT_Z_MSB) {
+      status &= ~(STATUS_ZYXDR | STATUS_ZYXOW);
+      int_source &= ~MMA865_INT_DRDY;
+      interrupt_update();
+    }
+    last_out = fast ? MMA865_REG_OUT_Z_MSB : MMA865_REG_OUT_Z_LSB;
+    if (reg < last_out) {
+      pointer = reg + (fast ? 2 : 1);
+    } else if (fifo) {
+      /* next sample */
+      if (fifo_count) {
+        memmove(fifo_samples[0], fifo_samples[1], sizeof(fifo_samples[0]) * --fifo_count);
+      }
+      pointer = MMA865_REG_OUT_X_MSB;
+    } else {
+      pointer = REG_F_STATUS;
+    }
+    return value;
+  }
+  switch (reg) {
+    case REG_INT_SOURCE:
+      value = int_source;
+      break;
+    case REG_FF_MT_SRC:
+      value = ff_mt_src;
+      ff_mt_src = 0;
+      int_source &= ~MMA865_INT_FF_MT;
+      interrupt_update();
+      break;
+    case REG_TRANSIENT_SRC:
+      value = has_fifo() ? transient_src : 0;
+      transient_src = 0;
+      int_source &= ~MMA865_INT_TRANS;
+      interrupt_update();
+      break;
+    default:
+      value = reg < NUM_REGS ? regs[reg] : 0;
+      break;
+  }
+  pointer = reg + 1;
+  return value;
+}
+
+void sim_acc_model(uint8_t id) {
+  who_am_i = id;
+}
+
+void sim_acc_set(int16_t x_mg, int16_t y_mg, int16_t z_mg) {
+  constant_mg[0] = x_mg;
+  constant_mg[1] = y_mg;
+  constant_mg[2] = z_mg;
+}
+
+void sim_acc_source(sim_acc_fn_t fn, void* ctx) {
+  source_fn = fn;
+  source_ctx = ctx;
+}
+
+uint8_t sim_acc_reg(uint8_t reg) {
+  sensor_init();
+  switch (reg) {
+    case REG_FF_MT_SRC:
+      return ff_mt_src;
+    case REG_TRANSIENT_SRC:
+      return transient_src;
+    case REG_INT_SOURCE:
+      return int_source;
+    default:
+      return reg < NUM_REGS ? regs[reg] : 0;
+  }
+}
+
+bool sim_acc_active(void) {
+  return regs[MMA865_CTRL_REG1] & 0x1;
+}
+
+uint32_t sim_acc_samples(void) {
+  return samples;
+}
+
+uint32_t sim_acc_ignored_writes(void) {
+  return ignored_writes;
+}
+
+/* ######################### TWI MANAGER ######################### */
+static nrf_twi_mngr_transaction_t const* queue[MAX_QUEUE];
+static uint8_t queue_head;
+static uint8_t queue_count;
+static uint8_t queue_size;
+static nrf_twi_mngr_transaction_t const* current;
+static int current_event = -1;
+static uint64_t current_end;
+static uint64_t bit_ns;
+static uint32_t transactions;
+static uint32_t max_waiting;
+
+static ret_code_t transfers_run(nrf_twi_mngr_transfer_t const* transfers, uint8_t count) {
+  uint8_t i, n;
+  for (i = 0; i < count; i++) {
+    if (NRF_TWI_MNGR_OP_ADDRESS(transfers[i].operation) != MMA865_ADDR) {
+      return NRF_ERROR_INTERNAL; /* address NACK */
+    }
+    if (NRF_TWI_MNGR_IS_READ_OP(transfers[i].operation)) {
+      for (n = 0; n < transfers[i].length; n++) {
+        transfers[i].p_data[n] = register_read();
+      }
+    } else if (transfers[i].length) {
+      pointer = transfers[i].p_data[0];
+      for (n = 1; n < transfers[i].length; n++) {
+        register_write(transfers[i].p_data[n]);
+      }
+    }
+  }
+  return NRF_SUCCESS;
+}
+
+/* bus time for the transaction, address and data bytes with their ACKs plus start and stop */
+static uint64_t transaction_time(nrf_twi_mngr_transaction_t const* transaction) {
+  uint32_t i, bytes = 0;
+  for (i = 0; i < transaction->number_of_transfers; i++) {
+    bytes += 1 + transaction->p_transfers[i].length;
+  }
+  return (bytes * 9 + 2) * bit_ns;
+}
+
+static void transaction_done(void* arg);
+
+static void transaction_next(void) {
+  if (current || queue_count == 0) {
+    return;
+  }
+  current = queue[queue_head];
+  queue_head = (queue_head + 1) % MAX_QUEUE;
+  queue_count--;
+  current_end = sim_now() + transaction_time(current);
+  current_event = sim_at(current_end, transaction_done, NULL);
+}
+
+/* the next transaction starts before the callback runs, as in the SDK */
+static void transaction_done(void* arg) {
+  nrf_twi_mngr_transaction_t const* transaction = current;
+  ret_code_t result = transfers_run(transaction->p_transfers, transaction->number_of_transfers);
+  current = NULL;
+  current_event = -1;
+  transactions++;
+  transaction_next();
+  if (transaction->callback) {
+    transaction->callback(result, transaction->p_user_data);
+  }
+}
+
+ret_code_t nrf_twi_mngr_init(nrf_twi_mngr_t const* p_nrf_twi_mngr,
+                             nrf_drv_twi_config_t const* p_default_twi_config) {
+  if (p_nrf_twi_mngr->queue_size > MAX_QUEUE) {
+    return NRF_ERROR_INVALID_PARAM;
+  }
+  sensor_init();
+  queue_size = p_nrf_twi_mngr->queue_size;
+  bit_ns = SIM_S / p_default_twi_config->frequency;
+  return NRF_SUCCESS;
+}
+
+ret_code_t nrf_twi_mngr_schedule(nrf_twi_mngr_t const* p_nrf_twi_mngr,
+                                 nrf_twi_mngr_transaction_t const* p_transaction) {
+  if (queue_count >= queue_size) {
+    return NRF_ERROR_NO_MEM;
+  }
+  queue[(queue_head + queue_count) % MAX_QUEUE] = p_transaction;
+  queue_count++;
+  transaction_next();
+  if (queue_count > max_waiting) {
+    max_waiting = queue_count;
+  }
+  return NRF_SUCCESS;
+}
+
+static void internal_done(ret_code_t result, void* p_user_data) {
+  *(ret_code_t*)p_user_data = result;
+}
+
+/* queued behind everything already scheduled, the wait moves the clock on without running any
+   other interrupt until main sleeps again */
+ret_code_t nrf_twi_mngr_perform(nrf_twi_mngr_t const* p_nrf_twi_mngr,
+                                nrf_drv_twi_config_t const* p_config,
+                                nrf_twi_mngr_transfer_t const* p_transfers,
+                                uint8_t number_of_transfers, void (*user_function)(void)) {
+  ret_code_t result = NRF_ERROR_BUSY;
+  nrf_twi_mngr_transaction_t internal = {
+      .callback = internal_done,
+      .p_user_data = &result,
+      .p_transfers = p_transfers,
+      .number_of_transfers = number_of_transfers,
+      .p_required_twi_cfg = p_config};
+  ret_code_t ret_code = nrf_twi_mngr_schedule(p_nrf_twi_mngr, &internal);
+  VERIFY_SUCCESS(ret_code);
+  while (result == NRF_ERROR_BUSY) {
+    sim_cancel(current_event);
+    fake_busy_until(current_end);
+    transaction_done(NULL);
+  }
+  return result;
+}
+
+uint32_t sim_twi_max_waiting(void) {
+  return max_waiting;
+}
+
+uint32_t sim_twi_transactions(void) {
+  return transactions;
+}
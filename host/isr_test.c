@@ -0,0 +1,137 @@
+/* Copyright (c) 2023  Hunter Whyte */
+/* time the accelerometer keeps the CPU in interrupts: the firmware queuing its reads on the TWI
+   manager, against the INT1 handler it replaced, which read every sample with a blocking transfer.
+   Both run through the whole firmware in the simulation streaming samples in the wave rainbow
+   mode, the old handler put in place of mma865_handler(). Reports the longest interrupt and the
+   latest any interrupt started after it was due. Only busy waits move the virtual clock, so this
+   is the time spent waiting on the bus, not the few us of code either handler runs. Each run is a
+   child process since the firmware's statics can't be reset */
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "app_error.h"
+#include "check.h"
+#include "nrf_drv_gpiote.h"
+#include "sim.h"
+
+#include "bracelet.h"
+#include "mma865.h"
+
+#define GRAVITY_MG 1000
+#define RUN_NS (10 * SIM_S)
+#define SAMPLE_NS (20 * SIM_MS) /* 50Hz */
+/* the old read of a sample, register address then 6 bytes, each with its address byte and every
+   byte with its ACK, plus start and stop at 100kHz */
+#define READ_NS ((uint64_t)((1 + 1 + 1 + MMA865_BYTES_PER_SAMPLE) * 9 + 2) * SIM_S / 100000)
+
+typedef struct run {
+  const char* name;
+  uint8_t model;
+  bool blocking; /* old INT1 handler */
+} run_t;
+
+static const run_t runs[] = {
+    {"blocking read, MMA8653", MMA8653_ID, true},
+    {"TWI manager, MMA8653", MMA8653_ID, false},
+    {"TWI manager, MMA8652", MMA8652_ID, false},
+};
+
+/* mma865.c's blocking register read, not in mma865.h */
+ret_code_t mma865_register_read(uint8_t register_address, uint8_t* destination,
+                                uint8_t number_of_bytes);
+
+static uint8_t values[MMA865_BYTES_PER_SAMPLE];
+
+/* mma865_handler() before the TWI manager, reads the sample before returning */
+static void blocking_handler(nrf_drv_gpiote_pin_t pin, nrf_gpiote_polarity_t action) {
+  ret_code_t ret_code =
+      mma865_register_read(MMA865_REG_OUT_X_MSB, values, MMA865_BYTES_PER_SAMPLE);
+  APP_ERROR_CHECK(ret_code);
+}
+
+/* the line may already be low when the handler is swapped, a read releases it */
+static void blocking_start(void* arg) {
+  blocking_handler(ACC_INT1, NRF_GPIOTE_POLARITY_HITOLO);
+}
+
+static void press(void) {
+  sim_button(true);
+  sim_run(100 * SIM_MS);
+  sim_button(false);
+  sim_run(100 * SIM_MS);
+}
+
+static void run(const run_t* run) {
+  nrf_drv_gpiote_in_config_t config = GPIOTE_CONFIG_IN_SENSE_HITOLO(false);
+  uint64_t isr_ns, latency_ns;
+  uint32_t samples, cycles, i;
+
+  sim_acc_model(run->model);
+  sim_acc_set(0, 0, GRAVITY_MG);
+  sim_boot();
+  sim_run(SIM_S);
+  /* the first press goes to the first mode */
+  for (i = 0; i <= BTN_WAVE_RAINBOW; i++) {
+    press();
+  }
+  if (run->blocking) {
+    nrf_drv_gpiote_in_uninit(ACC_INT1);
+    nrf_drv_gpiote_in_init(ACC_INT1, &config, blocking_handler);
+    nrf_drv_gpiote_in_event_enable(ACC_INT1, true);
+    sim_at(sim_now(), blocking_start, NULL);
+  }
+  sim_run(SIM_S);
+
+  sim_take_max_isr_ns();
+  sim_take_max_latency_ns();
+  mma865_take_max_isr_cycles();
+  samples = sim_acc_samples();
+  sim_run(RUN_NS);
+  samples = sim_acc_samples() - samples;
+  isr_ns = sim_take_max_isr_ns();
+  latency_ns = sim_take_max_latency_ns();
+  cycles = mma865_take_max_isr_cycles();
+  printf("  %-24s %8u %8.0fus %8.0fus %10u\n", run->name, samples, (double)isr_ns / SIM_US,
+         (double)latency_ns / SIM_US, cycles);
+
+  CHECK(samples >= RUN_NS / SAMPLE_NS * 9 / 10, "%s: only %u samples", run->name, samples);
+  if (run->blocking) {
+    CHECK(isr_ns >= READ_NS, "%s: longest interrupt %lluns, the read takes %lluns", run->name,
+          (unsigned long long)isr_ns, (unsigned long long)READ_NS);
+  } else {
+    /* nothing waits on the bus in an interrupt, the firmware's own count agrees */
+    CHECK(isr_ns == 0, "%s: an interrupt waited %lluns", run->name, (unsigned long long)isr_ns);
+    CHECK(latency_ns == 0, "%s: an interrupt started %lluns late", run->name,
+          (unsigned long long)latency_ns);
+    CHECK(cycles == 0, "%s: mma865 counted %u cycles in an interrupt", run->name, cycles);
+  }
+}
+
+int main(void) {
+  uint32_t i;
+  int status;
+  pid_t pid;
+
+  printf("%.0fs of 50Hz samples, time waiting on the bus in interrupts:\n",
+         (double)RUN_NS / SIM_S);
+  printf("  %-24s %8s %10s %10s %10s\n", "INT1 handler", "samples", "longest", "latest",
+         "mma865 max");
+  for (i = 0; i < sizeof(runs) / sizeof(runs[0]); i++) {
+    fflush(stdout);
+    pid = fork();
+    if (pid == 0) {
+      check_failures = 0;
+      run(&runs[i]);
+      fflush(stdout);
+      _exit(check_failures ? 1 : 0);
+    }
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      printf("FAIL %s\n", runs[i].name);
+      check_failures++;
+    }
+  }
+  return check_failures;
+}
@@ -0,0 +1,191 @@
+/* Copyright (c) 2023  Hunter Whyte */
+/* convergence under packet loss: the controller's scheduler (ctrl.h) changes random groups of a
+   channel at a steady rate and bracelets of every group decode the channel the way bracelet_ant.c
+   does, each losing messages independently. Reports how long after a change its bracelets show
+   it, at several loss rates. Built twice, as the firmware is with WIRE_PARITY 0 and with the
+   controller sending parity messages, and the parity build also runs bracelets that ignore them.
+   Parity must never hold a change back, so without loss every change is fast either way */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "check.h"
+#include "common.h"
+#include "ctrl.h"
+#include "sim.h"
+#include "wire.h"
+
+#define RUN_NS (60 * SIM_S)
+#define QUIET_NS (15 * SIM_S) /* no changes in the end of the run, for the last ones to arrive */
+#define CHANGES_PER_S 20
+#define PER_GROUP 4           /* bracelets of each group for each loss rate and decoder */
+#define FAST_NS (100 * SIM_MS) /* a change shown within this counts as fast */
+#define MAX_SAMPLES (RUN_NS / SIM_S * CHANGES_PER_S * PER_GROUP)
+
+static const uint32_t loss_percents[] = {0, 5, 10, 20, 30};
+#define LOSSES (sizeof(loss_percents) / sizeof(loss_percents[0]))
+
+typedef struct decoder {
+  const char* name;
+  bool parity; /* rebuilds missed changes from parity messages */
+} decoder_t;
+
+static const decoder_t decoders[] = {
+#if WIRE_PARITY
+    {"parity", true},
+#endif
+    {"ignored", false},
+};
+#define DECODERS (sizeof(decoders) / sizeof(decoders[0]))
+
+typedef struct bracelet {
+  group_data_t data;
+  wire_parity_t parity;
+  uint64_t pending_ns; /* time of the change not shown yet, 0 if none */
+} bracelet_t;
+
+typedef struct result {
+  uint32_t samples[MAX_SAMPLES]; /* convergence times in us */
+  uint32_t count;
+  uint32_t unconverged; /* bracelets still without their group's last change at the end */
+  uint64_t sum;
+} result_t;
+
+static bracelet_t bracelets[LOSSES][DECODERS][GROUPS_PER_CHANNEL][PER_GROUP];
+static result_t results[LOSSES][DECODERS];
+static group_data_t sent[GROUPS_PER_CHANNEL]; /* as the controller packs them */
+static uint32_t state = 1;
+
+static bool data_equal(const group_data_t* a, const group_data_t* b) {
+  return a->control == b->control && a->red == b->red && a->green == b->green &&
+         a->blue == b->blue;
+}
+
+static void show(bracelet_t* bracelet, result_t* result, uint8_t group, const group_data_t* data,
+                 uint64_t time_ns) {
+  bracelet->data = *data;
+  if (bracelet->pending_ns && data_equal(data, &sent[group])) {
+    result->samples[result->count++] = (time_ns - bracelet->pending_ns) / 1000;
+    bracelet->pending_ns = 0;
+  }
+}
+
+/* as ant_evt_handler(), for the pages and changes of a channel 0 group */
+static void rx(uint8_t channel, const uint8_t payload[WIRE_PAYLOAD_SIZE], uint64_t time_ns,
+               void* ctx) {
+  bracelet_t* bracelet;
+  group_data_t data;
+  uint32_t loss, decoder, group, i;
+
+  if (channel != 0) {
+    return;
+  }
+  for (loss = 0; loss < LOSSES; loss++) {
+    for (decoder = 0; decoder < DECODERS; decoder++) {
+      for (group = 0; group < GROUPS_PER_CHANNEL; group++) {
+        for (i = 0; i < PER_GROUP; i++) {
+          if (check_rand(&state) % 100 < loss_percents[loss]) {
+            continue;
+          }
+          bracelet = &bracelets[loss][decoder][group][i];
+          if (wire_decode_group(payload, group, &data) ||
+              (decoders[decoder].parity &&
+               wire_parity_recover(&bracelet->parity, payload, group, &data))) {
+            show(bracelet, &results[loss][decoder], group, &data, time_ns);
+          }
+          wire_parity_add(&bracelet->parity, payload);
+        }
+      }
+    }
+  }
+}
+
+/* a new color for a group, different from its last one once packed */
+static void change(uint64_t time_ns) {
+  uint8_t group = check_rand(&state) % GROUPS_PER_CHANNEL;
+  uint8_t red, green, blue;
+  group_data_t data;
+  bracelet_t* bracelet;
+  uint32_t loss, decoder, i;
+
+  do {
+    red = check_rand(&state);
+    green = check_rand(&state);
+    blue = check_rand(&state);
+    data = (group_data_t){.control = 0, .red = red >> 3, .green = green >> 2, .blue = blue >> 3};
+  } while (data_equal(&data, &sent[group]));
+  sent[group] = data;
+  ctrl_update_payload(group, 0, red, green, blue);
+
+  for (loss = 0; loss < LOSSES; loss++) {
+    for (decoder = 0; decoder < DECODERS; decoder++) {
+      for (i = 0; i < PER_GROUP; i++) {
+        bracelet = &bracelets[loss][decoder][group][i];
+        bracelet->pending_ns = data_equal(&bracelet->data, &data) ? 0 : time_ns;
+      }
+    }
+  }
+}
+
+static int compare_samples(const void* a, const void* b) {
+  uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+  return (x > y) - (x < y);
+}
+
+static void report(void) {
+  result_t* result;
+  uint32_t loss, decoder, group, i, fast;
+
+  printf("%d changes/s on a channel, WIRE_PARITY %d, %d bracelets per group, time to show a "
+         "change:\n",
+         CHANGES_PER_S, WIRE_PARITY, PER_GROUP);
+  printf("  %4s %-8s %8s %8s %8s %8s %8s\n", "loss", "parity", "mean", "p90", "p99", "max",
+         "<100ms");
+  for (loss = 0; loss < LOSSES; loss++) {
+    for (decoder = 0; decoder < DECODERS; decoder++) {
+      result = &results[loss][decoder];
+      for (group = 0; group < GROUPS_PER_CHANNEL; group++) {
+        for (i = 0; i < PER_GROUP; i++) {
+          result->unconverged += bracelets[loss][decoder][group][i].pending_ns != 0;
+        }
+      }
+      qsort(result->samples, result->count, sizeof(uint32_t), compare_samples);
+      fast = 0;
+      for (i = 0; i < result->count; i++) {
+        result->sum += result->samples[i];
+        fast += result->samples[i] * 1000ULL < FAST_NS;
+      }
+      printf("  %3u%% %-8s %6.0fms %6.0fms %6.0fms %6.0fms %7.1f%%\n", loss_percents[loss],
+             decoders[decoder].name, (double)result->sum / result->count / 1000,
+             result->samples[result->count * 90 / 100] / 1000.0,
+             result->samples[result->count * 99 / 100] / 1000.0,
+             result->samples[result->count - 1] / 1000.0, 100.0 * fast / result->count);
+      CHECK(result->unconverged == 0, "%u%% loss, parity %s: %u bracelets never caught up",
+            loss_percents[loss], decoders[decoder].name, result->unconverged);
+      CHECK(loss_percents[loss] || fast == result->count,
+            "no loss, parity %s: %u of %u changes slower than %.0fms", decoders[decoder].name,
+            result->count - fast, result->count, (double)FAST_NS / SIM_MS);
+    }
+    /* both get the same stream at the same loss, rebuilding missed changes should only help */
+    if (DECODERS > 1 && loss_percents[loss]) {
+      CHECK(results[loss][0].sum / results[loss][0].count <=
+                results[loss][1].sum / results[loss][1].count,
+            "%u%% loss: slower with parity", loss_percents[loss]);
+    }
+  }
+}
+
+int main(void) {
+  uint64_t time;
+
+  ctrl_start();
+  for (time = 0; time < RUN_NS; time += SIM_S / CHANGES_PER_S) {
+    ctrl_run_until(time, rx, NULL);
+    if (time < RUN_NS - QUIET_NS) {
+      change(time);
+    }
+  }
+  ctrl_run_until(RUN_NS, rx, NULL);
+  report();
+  return check_failures;
+}
@@ -0,0 +1,293 @@
+/* Copyright (c) 2023  Hunter Whyte */
+/* replays accelerometer traces through the bracelet's jerk filter and clap detector, the same
+   motion.c code with the thresholds and filter the firmware is built with, and reports the
+   detections against the labelled claps and the time per sample. The synthetic traces are also
+   run through the other jerk filter and the per axis maximum the firmware used before, to
+   compare their accuracy and time per sample.
+     replay_test                        synthetic traces from trace_gen.c, checked
+     replay_test trace.bin [labels.txt] a trace dumped by TRACE_RECORD, labels are the time of
+                                        each clap in ms, one per line */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "check.h"
+#include "nrf_drv_gpiote.h"
+
+#include "bracelet.h"
+#include "mma865.h"
+#include "motion.h"
+#include "trace.h"
+#include "trace_gen.h"
+
+#define MATCH_MS 100 /* a detection this long after a clap counts for it */
+#define MAX_FILE_LABELS 1024
+#define TRACE_SECONDS 60
+#define SEEDS 5
+/* detections away from any clap allowed in the 5 minutes of each kind of synthetic trace, for
+   every jerk method */
+#define MAX_FALSE_POSITIVES 1
+
+/* what a detection is made from, the squared jerk and the threshold it's compared against */
+typedef struct jerk_method {
+  const char* name;
+  uint32_t (*jerk_sq)(motion_filter_t* filter, int16_t x, int16_t y, int16_t z);
+  uint8_t filter;
+  uint32_t threshold;
+} jerk_method_t;
+
+/* the original detection: the largest jerk of any one axis, on left justified 16 bit samples
+   with the int16 subtraction it used, squared so it can go through motion_detect() */
+static uint32_t axis_max_jerk_sq(motion_filter_t* filter, int16_t x, int16_t y, int16_t z) {
+  const int16_t sample[3] = {x, y, z};
+  int16_t jerk, max = 0;
+  uint8_t i;
+
+  for (i = 0; i < 3; i++) {
+    if (!filter->primed) {
+      filter->last[i] = sample[i];
+    }
+    jerk = (int16_t)(sample[i] * 64) - (int16_t)(filter->last[i] * 64);
+    if (jerk < 0) {
+      jerk = -jerk;
+    }
+    if (jerk > max) {
+      max = jerk;
+    }
+    filter->last[i] = sample[i];
+  }
+  filter->primed = true;
+  return (uint32_t)max * max;
+}
+
+static const jerk_method_t methods[] = {
+    {"firmware", motion_jerk_sq, MMA865_FILTER, CLAP_JERK_THRESHOLD},
+    {"diff", motion_jerk_sq, MOTION_FILTER_DIFF, CLAP_JERK_THRESHOLD},
+    {"dc", motion_jerk_sq, MOTION_FILTER_DC, CLAP_JERK_THRESHOLD},
+    {"per axis max", axis_max_jerk_sq, MOTION_FILTER_DIFF, 10000},
+};
+#define NUM_METHODS (sizeof(methods) / sizeof(methods[0]))
+#define FIRMWARE (&methods[0])
+
+typedef struct replay_result {
+  uint32_t samples;
+  uint32_t claps;
+  uint32_t detected; /* claps with a detection inside MATCH_MS */
+  uint32_t repeats;  /* more detections inside MATCH_MS of a clap, the clap ringing on */
+  uint32_t false_positives;
+  uint32_t latency_sum_ms;
+  uint32_t latency_max_ms;
+} replay_result_t;
+
+/* run a trace through the filter and detector, detections are printed if verbose */
+static void replay(const jerk_method_t* method, const uint8_t* buffer, uint16_t length,
+                   const uint32_t* labels, uint16_t label_count, bool verbose,
+                   replay_result_t* result) {
+  motion_filter_t filter = MOTION_FILTER(method->filter);
+  motion_detector_t detector = MOTION_DETECTOR(method->threshold, COOLDOWN_MS);
+  uint16_t pos = 0, label = 0;
+  uint32_t time_ms = 0, latency;
+  int16_t x, y, z;
+  bool matched = false; /* labels[label] already has its detection */
+
+  while (trace_read(buffer, length, &pos, &time_ms, &x, &y, &z)) {
+    result->samples++;
+    if (!motion_detect(&detector, time_ms, method->jerk_sq(&filter, x, y, z))) {
+      continue;
+    }
+    /* claps too long ago to match anything more */
+    while (label < label_count && time_ms > labels[label] + MATCH_MS) {
+      label++;
+      matched = false;
+    }
+    if (label < label_count && time_ms >= labels[label] && !matched) {
+      latency = time_ms - labels[label];
+      result->detected++;
+      result->latency_sum_ms += latency;
+      if (latency > result->latency_max_ms) {
+        result->latency_max_ms = latency;
+      }
+      matched = true;
+      if (verbose) {
+        printf("  detection at %u ms, %u ms after the clap\n", time_ms, latency);
+      }
+    } else if (label < label_count && time_ms >= labels[label]) {
+      result->repeats++;
+      if (verbose) {
+        printf("  detection at %u ms, repeat\n", time_ms);
+      }
+    } else {
+      result->false_positives++;
+      if (verbose) {
+        printf("  detection at %u ms, false positive\n", time_ms);
+      }
+    }
+  }
+  result->claps += label_count;
+}
+
+static void result_print(const char* name, const replay_result_t* result) {
+  printf("  %-14s %7u %6u %6u %6u %6u %7.1f %6u\n", name, result->samples, result->claps,
+         result->detected, result->repeats, result->false_positives,
+         result->detected ? (double)result->latency_sum_ms / result->detected : 0.0,
+         result->latency_max_ms);
+}
+
+static void result_header(void) {
+  printf("  %-14s %7s %6s %6s %6s %6s %7s %6s\n", "trace", "samples", "claps", "found", "repeat",
+         "false", "lat ms", "max");
+}
+
+/* ######################### FILES ######################### */
+static int replay_file(const char* trace_path, const char* labels_path) {
+  static uint8_t buffer[UINT16_MAX];
+  static uint32_t labels[MAX_FILE_LABELS];
+  uint16_t label_count = 0;
+  size_t length;
+  replay_result_t result = {0};
+  FILE* f = fopen(trace_path, "rb");
+
+  if (!f) {
+    perror(trace_path);
+    return 1;
+  }
+  length = fread(buffer, 1, sizeof(buffer), f);
+  fclose(f);
+  if (labels_path) {
+    f = fopen(labels_path, "r");
+    if (!f) {
+      perror(labels_path);
+      return 1;
+    }
+    while (label_count < MAX_FILE_LABELS && fscanf(f, "%u", &labels[label_count]) == 1) {
+      label_count++;
+    }
+    fclose(f);
+  }
+  replay(FIRMWARE, buffer, length, labels, label_count, true, &result);
+  if (result.samples == 0) {
+    printf("%s: not a trace\n", trace_path);
+    return 1;
+  }
+  result_header();
+  result_print(trace_path, &result);
+  return 0;
+}
+
+/* ######################### SYNTHETIC ######################### */
+static gen_trace_t traces[GEN_NUM_KINDS][SEEDS];
+
+static void synthetic(void) {
+  gen_kind_e kind;
+  replay_result_t result, total = {0};
+  uint32_t seed, i;
+  uint64_t start;
+  printf("synthetic traces, %d of %ds each:\n", SEEDS, TRACE_SECONDS);
+  result_header();
+  for (kind = 0; kind < GEN_NUM_KINDS; kind++) {
+    result = (replay_result_t){0};
+    for (seed = 0; seed < SEEDS; seed++) {
+      trace_gen(&traces[kind][seed], kind, seed + 1, TRACE_SECONDS * 1000, 500);
+      replay(FIRMWARE, traces[kind][seed].buffer, traces[kind][seed].length,
+             traces[kind][seed].labels, traces[kind][seed].label_count, false, &result);
+    }
+    result_print(traces[kind][0].name, &result);
+    CHECK(result.samples == SEEDS * TRACE_SECONDS * 1000 / GEN_PERIOD_MS, "%s: %u samples read",
+          traces[kind][0].name, result.samples);
+    CHECK(result.detected == result.claps, "%s: %u of %u claps missed", traces[kind][0].name,
+          result.claps - result.detected, result.claps);
+    CHECK(result.false_positives == 0, "%s: %u false positives", traces[kind][0].name,
+          result.false_positives);
+  }
+
+  /* the whole replay loop, reading the trace included */
+  start = bench_ns();
+  for (i = 0; i < 20; i++) {
+    for (kind = 0; kind < GEN_NUM_KINDS; kind++) {
+      for (seed = 0; seed < SEEDS; seed++) {
+        replay(FIRMWARE, traces[kind][seed].buffer, traces[kind][seed].length,
+               traces[kind][seed].labels, traces[kind][seed].label_count, false, &total);
+      }
+    }
+  }
+  printf("time per sample, trace read, filter and detector: %.2f ns\n",
+         (double)(bench_ns() - start) / total.samples);
+  bench_sink += total.detected;
+}
+
+/* ######################### JERK METHODS ######################### */
+static int16_t samples[GEN_NUM_KINDS * SEEDS * TRACE_SECONDS * 1000 / GEN_PERIOD_MS][3];
+
+/* every method on the synthetic traces from synthetic(), and the time of the jerk alone */
+static void methods_compare(void) {
+  const jerk_method_t* method;
+  gen_kind_e kind;
+  replay_result_t result, clap_total, firmware_clap = {0}, axis_clap = {0};
+  uint32_t seed, i, count = 0, time_ms, sum;
+  uint16_t pos;
+  motion_filter_t filter;
+  uint64_t start;
+
+  for (kind = 0; kind < GEN_NUM_KINDS; kind++) {
+    for (seed = 0; seed < SEEDS; seed++) {
+      pos = 0;
+      while (trace_read(traces[kind][seed].buffer, traces[kind][seed].length, &pos, &time_ms,
+                        &samples[count][0], &samples[count][1], &samples[count][2])) {
+        count++;
+      }
+    }
+  }
+
+  printf("jerk methods on the synthetic traces, time per sample of the jerk alone:\n");
+  for (method = methods; method < methods + NUM_METHODS; method++) {
+    printf("%s, threshold %u:\n", method->name, method->threshold);
+    result_header();
+    clap_total = (replay_result_t){0};
+    for (kind = 0; kind < GEN_NUM_KINDS; kind++) {
+      result = (replay_result_t){0};
+      for (seed = 0; seed < SEEDS; seed++) {
+        replay(method, traces[kind][seed].buffer, traces[kind][seed].length,
+               traces[kind][seed].labels, traces[kind][seed].label_count, false, &result);
+      }
+      result_print(traces[kind][0].name, &result);
+      CHECK(result.false_positives <= MAX_FALSE_POSITIVES, "%s on %s: %u false positives",
+            method->name, traces[kind][0].name, result.false_positives);
+      clap_total.claps += result.claps;
+      clap_total.detected += result.detected;
+      clap_total.false_positives += result.false_positives;
+      clap_total.latency_sum_ms += result.latency_sum_ms;
+    }
+
+    filter = (motion_filter_t)MOTION_FILTER(method->filter);
+    start = bench_ns();
+    for (i = 0, sum = 0; i < count; i++) {
+      sum += method->jerk_sq(&filter, samples[i][0], samples[i][1], samples[i][2]) > 0;
+    }
+    printf("  %.2f ns per sample\n", (double)(bench_ns() - start) / count);
+    bench_sink += sum;
+
+    if (method == FIRMWARE) {
+      firmware_clap = clap_total;
+    } else if (method->jerk_sq == axis_max_jerk_sq) {
+      axis_clap = clap_total;
+    }
+  }
+  CHECK(firmware_clap.detected >= axis_clap.detected,
+        "firmware jerk finds %u claps, the per axis maximum %u", firmware_clap.detected,
+        axis_clap.detected);
+  CHECK(firmware_clap.false_positives <= axis_clap.false_positives,
+        "firmware jerk has %u false positives, the per axis maximum %u",
+        firmware_clap.false_positives, axis_clap.false_positives);
+  CHECK(firmware_clap.latency_sum_ms <= axis_clap.latency_sum_ms,
+        "firmware jerk is %u ms late in total, the per axis maximum %u",
+        firmware_clap.latency_sum_ms, axis_clap.latency_sum_ms);
+}
+
+int main(int argc, char** argv) {
+  if (argc > 1) {
+    return replay_file(argv[1], argc > 2 ? argv[2] : NULL);
+  }
+  synthetic();
+  methods_compare();
+  return check_failures;
+}
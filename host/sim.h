@@ -0,0 +1,104 @@
+/* Copyright (c) 2023  Hunter Whyte */
+#ifndef SIM_H
+#define SIM_H
+/*
+Host simulation of the bracelet firmware. bracelet.c, ws2812.c, mma865.c, bracelet_ant.c and
+nfc.c are built unmodified against the fakes of the SDK in fake/, bracelet_ble.c is replaced by
+fake/sim_radio.c at the level of bracelet_ble.h.
+Time is virtual and only moves inside sim_run(). main() runs as a coroutine that hands control
+back each time it sleeps in nrf_pwr_mgmt_run(), everything the hardware does is an event on
+the virtual clock: timers, PWM sequence ends, TWI transfers, accelerometer samples and anything
+injected from the test. Each event runs as an interrupt and the main loop gets one pass after
+it, as after a wakeup on the nRF.
+The LEDs are decoded back out of the PWM values as a WS2812 chain sees them, and the
+accelerometer is a register model of the MMA8652 or MMA8653 behind the TWI manager.
+Statics in the firmware can't be reset, so each scenario needs a fresh process.
+*/
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SIM_US 1000ULL /* virtual time is counted in ns */
+#define SIM_MS (1000 * SIM_US)
+#define SIM_S (1000 * SIM_MS)
+
+typedef void (*sim_fn_t)(void* arg);
+
+/* ######################### CLOCK ######################### */
+uint64_t sim_now(void);
+/* run fn as an interrupt at time_ns, returns an id for sim_cancel() */
+int sim_at(uint64_t time_ns, sim_fn_t fn, void* arg);
+void sim_cancel(int event);
+/* start main() and run it until it first sleeps */
+void sim_boot(void);
+void sim_run(uint64_t duration_ns);
+void sim_run_until(uint64_t time_ns);
+bool sim_off(void);         /* sd_power_system_off() was called */
+uint32_t sim_wakeups(void); /* main loop passes since boot */
+/* longest an event ran and latest one started after it was due, since the last call. Virtual time
+   only moves in busy waits, so both stay 0 unless the firmware waits on something */
+uint64_t sim_take_max_isr_ns(void);
+uint64_t sim_take_max_latency_ns(void);
+void sim_set_verbose(bool verbose);
+/* RTC counter at boot, to run the firmware across the 24 bit wrap. Set before sim_boot() */
+void sim_rtc_start(uint32_t ticks);
+uint32_t sim_timers_active(void);
+
+/* ######################### INPUTS ######################### */
+int sim_pin(uint32_t pin); /* level of an output pin, -1 if never driven */
+void sim_button(bool down);
+void sim_battery(int16_t sample);
+
+/* ######################### LEDS ######################### */
+typedef struct {
+  uint8_t red;
+  uint8_t green;
+  uint8_t blue;
+} sim_rgb_t;
+
+#define SIM_MAX_LEDS 300
+
+typedef void (*sim_frame_fn_t)(const sim_rgb_t* leds, uint16_t count);
+
+sim_rgb_t sim_led(uint16_t index); /* color shown, dark while NPVOUT is off */
+uint32_t sim_led_frames(void);     /* frames latched by the chain */
+uint32_t sim_led_errors(void);     /* PWM values that aren't a one, a zero or low */
+bool sim_pwm_running(void);
+uint32_t sim_pwm_playbacks(void); /* frames started on the PWM */
+/* called with the LEDs that took new data each time the chain latches */
+void sim_on_frame(sim_frame_fn_t fn);
+/* delay the PWM interrupt by up to max_ns, uniformly random from seed */
+void sim_pwm_latency(uint64_t max_ns, uint32_t seed);
+
+/* ######################### ACCELEROMETER ######################### */
+typedef void (*sim_acc_fn_t)(uint64_t time_ns, int16_t mg[3], void* ctx);
+
+/* MMA8652_ID or MMA8653_ID, set before sim_boot() */
+void sim_acc_model(uint8_t who_am_i);
+void sim_acc_set(int16_t x_mg, int16_t y_mg, int16_t z_mg);
+/* acceleration from fn at each sample instead of the constant one */
+void sim_acc_source(sim_acc_fn_t fn, void* ctx);
+uint8_t sim_acc_reg(uint8_t reg);
+bool sim_acc_active(void);
+uint32_t sim_acc_samples(void);       /* samples taken by the sensor */
+uint32_t sim_acc_ignored_writes(void); /* register writes dropped because it was active */
+uint32_t sim_twi_max_waiting(void);   /* most transactions queued behind the running one */
+uint32_t sim_twi_transactions(void);
+
+/* ######################### RADIO ######################### */
+bool sim_ant_open(uint8_t channel);
+/* deliver a broadcast payload, false if the channel isn't open */
+bool sim_ant_rx(uint8_t channel, const uint8_t payload[8]);
+bool sim_ble_advertising(void);
+bool sim_ble_connected(void);
+bool sim_ble_connect(void); /* false unless advertising */
+void sim_ble_disconnect(void);
+/* NUS write from the app, false unless connected */
+bool sim_nus_rx(const uint8_t* data, uint16_t length);
+/* phone writes a text record to the NFC tag, false if it doesn't fit */
+bool sim_nfc_write(const char* text);
+/* group stored in flash before sim_boot(), and what is there now, -1 for no record */
+void sim_flash_group(uint8_t group);
+int sim_flash_group_stored(void);
+
+#endif /* SIM_H */
@@ -0,0 +1,316 @@
+/* Copyright (c) 2023  Hunter Whyte */
+/* scenarios run through the whole bracelet firmware in the simulation, see sim.h. Each one runs in
+   a child process since the firmware's statics can't be reset between them */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "check.h"
+#include "nrf_drv_gpiote.h"
+#include "sim.h"
+
+#include "bracelet.h"
+#include "common.h"
+#include "mma865.h"
+#include "wire.h"
+#include "ws2812.h"
+
+#define GRAVITY_MG 1000
+
+/* colors go through gamma and dithering on the way out, so only the rough level is checked */
+static bool led_near(uint16_t index, uint8_t red, uint8_t green, uint8_t blue) {
+  sim_rgb_t led = sim_led(index);
+  return abs(led.red - red) <= 24 && abs(led.green - green) <= 24 && abs(led.blue - blue) <= 24;
+}
+
+static bool led_dark(uint16_t index) {
+  sim_rgb_t led = sim_led(index);
+  return led.red == 0 && led.green == 0 && led.blue == 0;
+}
+
+static void press(uint64_t hold_ns) {
+  sim_button(true);
+  sim_run(hold_ns);
+  sim_button(false);
+  sim_run(100 * SIM_MS);
+}
+
+static void boot_still(uint8_t model) {
+  sim_acc_model(model);
+  sim_acc_set(0, 0, GRAVITY_MG);
+  sim_boot();
+  sim_run(SIM_S);
+}
+
+/* the accelerometer never had a write dropped or the TWI queue overflow */
+static void check_twi(void) {
+  CHECK(sim_acc_ignored_writes() == 0, "%u register writes ignored while active",
+        sim_acc_ignored_writes());
+  CHECK(sim_twi_max_waiting() <= MMA865_TWI_QUEUE_SIZE, "%u transactions waiting",
+        sim_twi_max_waiting());
+}
+
+/* ######################### SCENARIOS ######################### */
+static void boot_dim_blue(void) {
+  uint32_t frames;
+  boot_still(MMA8653_ID);
+  CHECK(sim_pin(NPVOUT) == 1, "LEDs not powered");
+  CHECK(sim_led_frames() > 0, "no frame shown");
+  /* as bright as before gamma correction */
+  CHECK(sim_led(0).red == 0 && sim_led(0).green == 0 && sim_led(0).blue == 10,
+        "boot color %d %d %d", sim_led(0).red, sim_led(0).green, sim_led(0).blue);
+  CHECK(sim_led_errors() == 0, "%u bad PWM values", sim_led_errors());
+  CHECK(sim_ble_advertising() == false, "advertising at boot");
+  /* a static color is shown once, nothing ticks after that */
+  frames = sim_led_frames();
+  sim_run(5 * SIM_S);
+  CHECK(!sim_pwm_running(), "PWM still running");
+  CHECK(sim_led_frames() == frames, "%u frames after boot", sim_led_frames() - frames);
+  check_twi();
+}
+
+static void button_cycles_modes(void) {
+  boot_still(MMA8653_ID);
+  press(100 * SIM_MS);
+  CHECK(led_near(0, 255, 0, 255), "first press %d %d %d", sim_led(0).red, sim_led(0).green,
+        sim_led(0).blue);
+  press(100 * SIM_MS);
+  sim_run(SIM_S);
+  CHECK(sim_led(0).red == 0 && sim_led(0).blue == 0, "second press %d %d %d", sim_led(0).red,
+        sim_led(0).green, sim_led(0).blue);
+  CHECK(sim_led_errors() == 0, "%u bad PWM values", sim_led_errors());
+}
+
+static void long_press_advertises(void) {
+  boot_still(MMA8653_ID);
+  press(LONGPRESS_MS * SIM_MS + 500 * SIM_MS);
+  CHECK(sim_ble_advertising(), "not advertising after a long press");
+  CHECK(sim_ble_connect(), "connect refused");
+  sim_run(100 * SIM_MS);
+  CHECK(led_near(0, 10, 0, 10), "connected %d %d %d", sim_led(0).red, sim_led(0).green,
+        sim_led(0).blue);
+  CHECK(sim_nus_rx((const uint8_t[]){0, 0, 255, 0}, 4), "NUS write refused");
+  sim_run(100 * SIM_MS);
+  CHECK(led_near(0, 0, 255, 0), "NUS color %d %d %d", sim_led(0).red, sim_led(0).green,
+        sim_led(0).blue);
+}
+
+static void ant_page_sets_color(void) {
+  uint8_t group = 5, payload[WIRE_PAYLOAD_SIZE];
+  group_data_t groups[GROUPS_PER_PAGE] = {{0}};
+  sim_flash_group(group);
+  boot_still(MMA8653_ID);
+  CHECK(sim_ant_open(GROUP_TO_CHANNEL(group)), "channel %d not open", GROUP_TO_CHANNEL(group));
+  /* 5 bit red, 6 bit green, 5 bit blue */
+  groups[GROUP_TO_INDEX(group)] = (group_data_t){0, 31, 0, 0};
+  wire_encode_page(payload, 0, GROUP_TO_PAGE(group), groups, 0);
+  CHECK(sim_ant_rx(GROUP_TO_CHANNEL(group), payload), "page not delivered");
+  sim_run(100 * SIM_MS);
+  CHECK(led_near(0, 248, 0, 0), "ANT color %d %d %d", sim_led(0).red, sim_led(0).green,
+        sim_led(0).blue);
+  CHECK(sim_led_errors() == 0, "%u bad PWM values", sim_led_errors());
+}
+
+/* a clap mode chosen over ANT runs the clap detection, not only the one from the button */
+static void ant_clap_mode_follows_claps(void) {
+  uint8_t group = 5, payload[WIRE_PAYLOAD_SIZE];
+  group_data_t groups[GROUPS_PER_PAGE] = {{0}};
+  sim_flash_group(group);
+  boot_still(MMA8653_ID);
+  /* control 3 is the clap pulse */
+  groups[GROUP_TO_INDEX(group)] = (group_data_t){3, 31, 0, 0};
+  wire_encode_page(payload, 0, GROUP_TO_PAGE(group), groups, 0);
+  CHECK(sim_ant_rx(GROUP_TO_CHANNEL(group), payload), "page not delivered");
+  sim_run(2 * SIM_S);
+  CHECK(sim_led(0).red < 24, "lit before a clap %d %d %d", sim_led(0).red, sim_led(0).green,
+        sim_led(0).blue);
+  /* one sample 3g off, past CLAP_JERK_THRESHOLD */
+  sim_acc_set(3 * GRAVITY_MG, 0, GRAVITY_MG);
+  sim_run(20 * SIM_MS);
+  sim_acc_set(0, 0, GRAVITY_MG);
+  sim_run(50 * SIM_MS);
+  CHECK(sim_led(0).red > 128, "no pulse after a clap %d %d %d", sim_led(0).red, sim_led(0).green,
+        sim_led(0).blue);
+  check_twi();
+}
+
+static uint16_t led_level(uint16_t index) {
+  sim_rgb_t led = sim_led(index);
+  return led.red + led.green + led.blue;
+}
+
+/* the clap pulse from the button, detected by the transient engine on the MMA8652 and from
+   streamed samples on the MMA8653 */
+static void clap_pulse(uint8_t model, uint8_t source) {
+  uint8_t i;
+  uint16_t level;
+  boot_still(model);
+  for (i = 0; i <= BTN_CLAP_PULSE; i++) {
+    press(100 * SIM_MS);
+  }
+  sim_run(2 * SIM_S);
+  CHECK(sim_acc_reg(MMA865_CTRL_REG4) == source, "interrupt source %x",
+        sim_acc_reg(MMA865_CTRL_REG4));
+  level = led_level(0);
+  /* one sample 3g off, past CLAP_JERK_THRESHOLD and MMA865_DETECT_THS */
+  sim_acc_set(3 * GRAVITY_MG, 0, GRAVITY_MG);
+  sim_run(20 * SIM_MS);
+  sim_acc_set(0, 0, GRAVITY_MG);
+  sim_run(50 * SIM_MS);
+  CHECK(led_level(0) > level + 128, "no pulse after a clap, level %u from %u", led_level(0),
+        level);
+  check_twi();
+}
+
+static void clap_pulse_8653(void) {
+  clap_pulse(MMA8653_ID, MMA865_INT_DRDY);
+}
+
+static void clap_pulse_8652(void) {
+  clap_pulse(MMA8652_ID, MMA865_INT_TRANS);
+}
+
+/* still for IDLE_STILL_MS turns everything off, then a shake has to bring it back */
+static void idle_and_wake(uint8_t model, int16_t shake_mg) {
+  uint32_t frames;
+  boot_still(model);
+  /* the high pass filter settling after the sensor starts can count as motion */
+  sim_run(IDLE_STILL_MS * SIM_MS + 2 * SIM_S);
+  CHECK(!sim_pwm_running(), "PWM running in IDLE");
+  CHECK(sim_pin(NPVOUT) == 0, "LEDs powered in IDLE");
+  CHECK(led_dark(0), "LEDs lit in IDLE");
+  frames = sim_led_frames();
+  sim_run(10 * SIM_S);
+  CHECK(sim_led_frames() == frames, "%u frames in IDLE", sim_led_frames() - frames);
+  CHECK(sim_acc_active(), "wake detection stopped in IDLE");
+
+  sim_acc_set(0, shake_mg, GRAVITY_MG);
+  sim_run(SIM_S);
+  sim_acc_set(0, 0, GRAVITY_MG);
+  sim_run(SIM_S);
+  CHECK(sim_pin(NPVOUT) == 1, "LEDs still off after motion");
+  CHECK(sim_led(0).red == 0 && sim_led(0).green == 0, "woke to %d %d %d", sim_led(0).red,
+        sim_led(0).green, sim_led(0).blue);
+  CHECK(sim_led_frames() > frames, "no frame after waking");
+  check_twi();
+}
+
+static void idle_and_wake_8653(void) {
+  /* compares raw acceleration, the shake has to pass 1.25g on an axis */
+  idle_and_wake(MMA8653_ID, 1500);
+}
+
+static void idle_and_wake_8652(void) {
+  /* the transient detection sees the change through its high pass filter */
+  idle_and_wake(MMA8652_ID, 600);
+}
+
+static void nfc_sets_group(void) {
+  boot_still(MMA8653_ID);
+  CHECK(sim_nfc_write("7"), "NFC write refused");
+  sim_run(100 * SIM_MS);
+  CHECK(sim_flash_group_stored() == 6, "group %d stored", sim_flash_group_stored());
+}
+
+/* groups past 99 take three digits and are on the second channel */
+static void nfc_sets_group_on_channel_1(void) {
+  boot_still(MMA8653_ID);
+  CHECK(sim_nfc_write("131"), "NFC write refused");
+  sim_run(100 * SIM_MS);
+  CHECK(sim_flash_group_stored() == 130, "group %d stored", sim_flash_group_stored());
+  CHECK(sim_ant_open(GROUP_TO_CHANNEL(130)), "channel %d not open", GROUP_TO_CHANNEL(130));
+}
+
+/* a write that isn't a group number leaves the stored group and channel alone */
+static void nfc_rejects_invalid_group(void) {
+  static const char* texts[] = {"", "0", "1a", "+1", "999"};
+  char text[8];
+  uint32_t i;
+
+  sim_flash_group(130);
+  boot_still(MMA8653_ID);
+  for (i = 0; i < sizeof(texts) / sizeof(texts[0]); i++) {
+    CHECK(sim_nfc_write(texts[i]), "NFC write of \"%s\" refused", texts[i]);
+    sim_run(100 * SIM_MS);
+    CHECK(sim_flash_group_stored() == 130, "\"%s\": group %d stored", texts[i],
+          sim_flash_group_stored());
+  }
+  snprintf(text, sizeof(text), "%d", MAX_GROUPS + 1);
+  CHECK(sim_nfc_write(text), "NFC write of \"%s\" refused", text);
+  sim_run(100 * SIM_MS);
+  CHECK(sim_flash_group_stored() == 130, "\"%s\": group %d stored", text,
+        sim_flash_group_stored());
+  CHECK(sim_ant_open(GROUP_TO_CHANNEL(130)), "channel %d not open", GROUP_TO_CHANNEL(130));
+}
+
+/* the first group is written as 1 and stored as 0, which loads as a valid group */
+static void nfc_sets_first_group(void) {
+  sim_flash_group(130);
+  boot_still(MMA8653_ID);
+  CHECK(sim_nfc_write("1"), "NFC write refused");
+  sim_run(100 * SIM_MS);
+  CHECK(sim_flash_group_stored() == 0, "group %d stored", sim_flash_group_stored());
+  CHECK(sim_ant_open(0) && !sim_ant_open(1), "channel 0 not open");
+}
+
+static void low_battery_shuts_down(void) {
+  boot_still(MMA8653_ID);
+  sim_battery(MIN_BATTERY_VOLTAGE - 10);
+  sim_run(BATTERY_INTERVAL_MS * SIM_MS + 6 * SIM_S);
+  CHECK(sim_off(), "still on with a flat battery");
+}
+
+/* ######################### RUNNER ######################### */
+typedef struct {
+  const char* name;
+  void (*fn)(void);
+} scenario_t;
+
+static const scenario_t scenarios[] = {
+    {"boot_dim_blue", boot_dim_blue},
+    {"button_cycles_modes", button_cycles_modes},
+    {"long_press_advertises", long_press_advertises},
+    {"ant_page_sets_color", ant_page_sets_color},
+    {"ant_clap_mode_follows_claps", ant_clap_mode_follows_claps},
+    {"clap_pulse_8653", clap_pulse_8653},
+    {"clap_pulse_8652", clap_pulse_8652},
+    {"idle_and_wake_8653", idle_and_wake_8653},
+    {"idle_and_wake_8652", idle_and_wake_8652},
+    {"nfc_sets_group", nfc_sets_group},
+    {"nfc_sets_group_on_channel_1", nfc_sets_group_on_channel_1},
+    {"nfc_rejects_invalid_group", nfc_rejects_invalid_group},
+    {"nfc_sets_first_group", nfc_sets_first_group},
+    {"low_battery_shuts_down", low_battery_shuts_down},
+};
+
+/* runs every scenario, or only the one named with the firmware's log */
+int main(int argc, char** argv) {
+  uint32_t i, run = 0;
+  int status;
+  pid_t pid;
+  for (i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+    if (argc > 1 && strcmp(argv[1], scenarios[i].name) != 0) {
+      continue;
+    }
+    fflush(stdout);
+    pid = fork();
+    if (pid == 0) {
+      check_failures = 0; /* counts the parent's failures so far */
+      sim_set_verbose(argc > 1);
+      scenarios[i].fn();
+      fflush(stdout);
+      _exit(check_failures ? 1 : 0);
+    }
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      printf("FAIL %s\n", scenarios[i].name);
+      check_failures++;
+    }
+    run++;
+  }
+  printf("%u scenarios, %d failed\n", run, check_failures);
+  return check_failures;
+}
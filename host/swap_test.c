@@ -0,0 +1,101 @@
+/* Copyright (c) 2023  Hunter Whyte */
+/* writes uniform frames at random times while the PWM interrupt runs after a random latency, and
+   checks every frame the chain latches is one whole frame, never part of two, and that frames
+   come out in the order they were written. The ring halves have to be refilled while the other
+   one plays, a latency longer than that has to show up as torn frames */
+#include <stdint.h>
+#include <stdio.h>
+
+#include "check.h"
+#include "sim.h"
+
+#include "color.h"
+#include "ws2812.h"
+
+#define CHAIN_LEDS 60
+#define WRITES 150
+#define FIRST_RED (256 - WRITES) /* bright enough that the output isn't dithered */
+#define HALF_NS ((uint64_t)RING_CYCLES * CYCLE_TICKS * SIM_S / 16000000)
+
+static uint32_t seed;
+static uint8_t written;     /* red of the last frame written, goes up with every write */
+static uint64_t written_ns; /* time of the last write */
+static uint64_t latched_ns; /* time of the last latch */
+static uint32_t writes;
+static uint32_t latched;
+static uint32_t torn;      /* frames with more than one color */
+static uint32_t reordered; /* frames older than one already shown */
+static uint8_t last_red;
+
+/* red the LEDs show for a red written, gamma corrected without dithering at full budget */
+static uint8_t shown_red(uint8_t red) {
+  uint32_t level = gamma_lut[red] + 0x80;
+  return level > 0xFFFF ? 0xFF : level >> 8;
+}
+
+/* LEDs past the ones that took new data keep the last frame, so the whole chain is checked */
+static void frame_check(const sim_rgb_t* leds, uint16_t count) {
+  uint16_t i;
+  latched++;
+  latched_ns = sim_now();
+  for (i = 1; i < CHAIN_LEDS; i++) {
+    if (sim_led(i).red != sim_led(0).red || sim_led(i).green != sim_led(0).green) {
+      torn++;
+      return;
+    }
+  }
+  if (sim_led(0).red < last_red) {
+    reordered++;
+  }
+  last_red = sim_led(0).red;
+}
+
+/* a write at a random time in the next two frame times, often while one is streaming */
+static void write_event(void* arg) {
+  written = FIRST_RED + writes;
+  written_ns = sim_now();
+  ws2812_set_all_rgb(written, 255 - written, 0);
+  if (++writes < WRITES) {
+    sim_at(sim_now() + check_rand(&seed) % (2 * ws2812_frame_time_us() * SIM_US), write_event,
+           NULL);
+  }
+}
+
+/* writes WRITES frames with the interrupt up to latency_ns late, returns the torn frames */
+static uint32_t run(uint64_t latency_ns, uint32_t s) {
+  seed = s;
+  writes = latched = torn = reordered = last_red = 0;
+  sim_pwm_latency(latency_ns, s);
+  sim_at(sim_now(), write_event, NULL);
+  sim_run(WRITES * 2 * ws2812_frame_time_us() * SIM_US + SIM_S);
+  printf("  latency up to %4llu us: %u writes, %u frames, %u torn, %u bad PWM values\n",
+         (unsigned long long)(latency_ns / SIM_US), writes, latched, torn, sim_led_errors());
+  return torn;
+}
+
+/* a run inside the latency budget, frames only ever whole, in order and the last one shown */
+static void run_clean(uint64_t latency_ns, uint32_t s) {
+  CHECK(run(latency_ns, s) == 0, "torn frames with seed %u", s);
+  CHECK(reordered == 0, "%u frames out of order", reordered);
+  CHECK(latched_ns > written_ns, "no frame after the last write");
+  CHECK(sim_led(0).red == shown_red(written) && sim_led(CHAIN_LEDS - 1).red == shown_red(written),
+        "last frame %d not shown, %d", shown_red(written), sim_led(0).red);
+}
+
+int main(void) {
+  uint32_t s;
+  ws2812_init();
+  ws2812_set_num_leds(CHAIN_LEDS);
+  ws2812_set_power_budget(UINT16_MAX);
+  CHECK(gamma_lut[FIRST_RED] >= WS2812_DITHER_LEVEL, "red %d is dithered", FIRST_RED);
+  sim_on_frame(frame_check);
+  printf("ring half plays for %llu us\n", (unsigned long long)(HALF_NS / SIM_US));
+  run_clean(0, 1);
+  for (s = 1; s <= 10; s++) {
+    run_clean(HALF_NS * 9 / 10, s);
+  }
+  CHECK(sim_led_errors() == 0, "%u bad PWM values", sim_led_errors());
+  /* the check itself has to see a ring refilled too late */
+  CHECK(run(HALF_NS * 3, 1) > 0, "no torn frames with a late refill");
+  return check_failures;
+}
@@ -0,0 +1,145 @@
+/* Copyright (c) 2023  Hunter Whyte */
+/* claps on a beat from trace_gen.c, detected as the firmware does and fed to the tempo tracker
+   the way clap_pulse() feeds it. Reports for each tempo how many claps it takes to lock, the
+   error of the period once locked and of the beat it predicts, and the time per onset */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "check.h"
+#include "nrf_drv_gpiote.h"
+
+#include "bracelet.h"
+#include "mma865.h"
+#include "motion.h"
+#include "tempo.h"
+#include "trace_gen.h"
+
+#define TRACE_SECONDS 30
+#define SEEDS 5
+#define LOCKED_PERCENT 5  /* a period this close to the beat counts as locked */
+#define MAX_LOCK_CLAPS 10 /* claps it may take to lock */
+
+typedef struct tempo_result {
+  uint32_t runs;
+  uint32_t unlocked;       /* runs that never locked, or lost the lock again */
+  uint32_t lock_claps_sum; /* claps until the lock that was kept */
+  uint32_t lock_claps_max;
+  uint32_t period_error_sum;  /* ms, every clap once locked */
+  uint32_t predict_error_sum; /* ms between the predicted and the next clap, once locked */
+  uint32_t predict_error_max;
+  uint32_t locked_claps;
+} tempo_result_t;
+
+static gen_trace_t trace;
+static uint32_t onsets[GEN_MAX_LABELS];
+
+/* clap detections in the trace */
+static uint16_t detect(void) {
+  motion_filter_t filter = MOTION_FILTER(MMA865_FILTER);
+  motion_detector_t detector = MOTION_DETECTOR(CLAP_JERK_THRESHOLD, COOLDOWN_MS);
+  uint16_t pos = 0, count = 0;
+  uint32_t time_ms;
+  int16_t x, y, z;
+  while (trace_read(trace.buffer, trace.length, &pos, &time_ms, &x, &y, &z)) {
+    if (motion_detect(&detector, time_ms, motion_jerk_sq(&filter, x, y, z)) &&
+        count < GEN_MAX_LABELS) {
+      onsets[count++] = time_ms;
+    }
+  }
+  return count;
+}
+
+static void run(uint16_t beat_ms, uint32_t seed, tempo_result_t* result) {
+  tempo_t tempo;
+  uint16_t count, i, period, lock = 0;
+  uint32_t error, predicted;
+  bool locked = false;
+
+  trace_gen(&trace, GEN_BEAT, seed, TRACE_SECONDS * 1000, beat_ms);
+  count = detect();
+  tempo_reset(&tempo);
+  result->runs++;
+  for (i = 0; i < count; i++) {
+    tempo_onset(&tempo, onsets[i]);
+    period = tempo_period_ms(&tempo);
+    error = abs((int32_t)period - beat_ms);
+    if (error * 100 > beat_ms * LOCKED_PERCENT) {
+      locked = false;
+      continue;
+    }
+    if (!locked) {
+      locked = true;
+      lock = i + 1;
+    }
+    result->period_error_sum += error;
+    result->locked_claps++;
+    if (i + 1 < count) {
+      predicted = onsets[i] + period;
+      error = abs((int32_t)(onsets[i + 1] - predicted));
+      result->predict_error_sum += error;
+      if (error > result->predict_error_max) {
+        result->predict_error_max = error;
+      }
+    }
+  }
+  if (!locked) {
+    result->unlocked++;
+    return;
+  }
+  result->lock_claps_sum += lock;
+  if (lock > result->lock_claps_max) {
+    result->lock_claps_max = lock;
+  }
+}
+
+static void accuracy(void) {
+  static const uint16_t beats_ms[] = {350, 400, 462, 500, 545, 600, 706, 800, 923, 1000};
+  tempo_result_t result;
+  uint32_t i, seed;
+
+  printf("claps on a beat, %d traces of %ds per tempo, locked within %d%%:\n", SEEDS,
+         TRACE_SECONDS, LOCKED_PERCENT);
+  printf("  %5s %4s %8s %8s %10s %11s %8s\n", "beat", "BPM", "unlocked", "to lock", "max lock",
+         "period err", "beat err");
+  for (i = 0; i < sizeof(beats_ms) / sizeof(beats_ms[0]); i++) {
+    result = (tempo_result_t){0};
+    for (seed = 1; seed <= SEEDS; seed++) {
+      run(beats_ms[i], seed, &result);
+    }
+    printf("  %5u %4u %8u %8.1f %10u %8.1f ms %5.1f ms (max %u)\n", beats_ms[i],
+           60000 / beats_ms[i], result.unlocked,
+           (double)result.lock_claps_sum / (result.runs - result.unlocked), result.lock_claps_max,
+           (double)result.period_error_sum / result.locked_claps,
+           (double)result.predict_error_sum / result.locked_claps, result.predict_error_max);
+    CHECK(result.unlocked == 0, "%u ms beat: %u of %u runs not locked at the end", beats_ms[i],
+          result.unlocked, result.runs);
+    CHECK(result.lock_claps_max <= MAX_LOCK_CLAPS, "%u ms beat: %u claps to lock", beats_ms[i],
+          result.lock_claps_max);
+  }
+}
+
+static void benchmark(void) {
+  tempo_t tempo;
+  uint32_t i, time_ms = 0, sum = 0, state = 1;
+  uint64_t start;
+  const uint32_t count = 100000;
+
+  tempo_reset(&tempo);
+  start = bench_ns();
+  for (i = 0; i < count; i++) {
+    time_ms += 480 + check_rand(&state) % 41;
+    tempo_onset(&tempo, time_ms);
+    sum += tempo_period_ms(&tempo);
+  }
+  printf("time per onset with the period read back: %.1f ns, %zu bytes of state\n",
+         (double)(bench_ns() - start) / count, sizeof(tempo_t));
+  bench_sink += sum;
+  CHECK(sizeof(tempo_t) <= 256, "tempo state is %zu bytes", sizeof(tempo_t));
+}
+
+int main(void) {
+  accuracy();
+  benchmark();
+  return check_failures;
+}
@@ -0,0 +1,112 @@
+/* Copyright (c) 2023  Hunter Whyte */
+/* checks the integer atan2 of tilt.c against the float one all the way round, and the roll and
+   pitch of a few wrist orientations, then times the integer atan2 against atan2f */
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "check.h"
+#include "tilt.h"
+
+#define ANGLE_TURN 65536
+#define RADIUS 256 /* 1g in 10 bit counts at the +-2g range */
+#define POINTS 4096
+#define MAX_ERROR_DEGREES 0.3
+#define BENCH_CALLS 1000000
+
+/* binary angle of (x, y) from the float atan2 */
+static double float_angle(double y, double x) {
+  double angle = atan2(y, x) * ANGLE_TURN / (2 * M_PI);
+  return angle < 0 ? angle + ANGLE_TURN : angle;
+}
+
+/* difference of two binary angles, wrapped to -half to +half a turn */
+static double angle_diff(double a, double b) {
+  double d = fmod(a - b + ANGLE_TURN + ANGLE_TURN / 2, ANGLE_TURN) - ANGLE_TURN / 2;
+  return fabs(d);
+}
+
+static void atan2_sweep(void) {
+  uint32_t i;
+  int32_t x, y;
+  double theta, error, max_error = 0, sum = 0;
+
+  for (i = 0; i < POINTS; i++) {
+    theta = 2 * M_PI * i / POINTS;
+    x = lround(RADIUS * cos(theta));
+    y = lround(RADIUS * sin(theta));
+    error = angle_diff(tilt_atan2(y, x), float_angle(y, x));
+    sum += error;
+    if (error > max_error) {
+      max_error = error;
+    }
+  }
+  printf("tilt_atan2 over %d points of a 1g circle: max error %.3f degrees, mean %.3f\n", POINTS,
+         max_error * 360 / ANGLE_TURN, sum / POINTS * 360 / ANGLE_TURN);
+  CHECK(max_error * 360 / ANGLE_TURN <= MAX_ERROR_DEGREES, "max error %.3f degrees",
+        max_error * 360 / ANGLE_TURN);
+  CHECK(tilt_atan2(0, 0) == 0, "atan2(0, 0) is %u", tilt_atan2(0, 0));
+}
+
+/* roll and pitch once the filter settles on a still wrist */
+static void orientation(const char* name, int16_t x, int16_t y, int16_t z, int16_t roll,
+                        int16_t pitch) {
+  tilt_t tilt;
+  uint16_t i;
+  tilt_reset(&tilt);
+  for (i = 0; i < 100; i++) {
+    tilt_update(&tilt, x, y, z);
+  }
+  printf("  %-16s roll %3u pitch %3u\n", name, tilt_roll(&tilt), tilt_pitch(&tilt));
+  CHECK(abs(tilt_roll(&tilt) - roll) <= 1 || abs(tilt_roll(&tilt) - roll) >= 255,
+        "%s: roll %u, expected %d", name, tilt_roll(&tilt), roll);
+  CHECK(abs(tilt_pitch(&tilt) - pitch) <= 1, "%s: pitch %u, expected %d", name,
+        tilt_pitch(&tilt), pitch);
+}
+
+static void orientations(void) {
+  printf("roll and pitch, 256 to a turn:\n");
+  orientation("flat", 0, 0, RADIUS, 0, 128);
+  orientation("rolled a quarter", 0, RADIUS, 0, 64, 128);
+  orientation("upside down", 0, 0, -RADIUS, 128, 128);
+  orientation("x up", RADIUS, 0, 0, 0, 255);
+  orientation("x down", -RADIUS, 0, 0, 0, 0);
+}
+
+static void benchmarks(void) {
+  uint32_t i, seed = 1, sum = 0;
+  int16_t x, y;
+  uint64_t start;
+  double int_ns, float_ns;
+  float fsum = 0;
+
+  start = bench_ns();
+  for (i = 0; i < BENCH_CALLS; i++) {
+    x = (int16_t)check_rand(&seed) >> 6;
+    y = (int16_t)check_rand(&seed) >> 6;
+    sum += tilt_atan2(y, x);
+  }
+  int_ns = (double)(bench_ns() - start) / BENCH_CALLS;
+  bench_sink += sum;
+
+  start = bench_ns();
+  for (i = 0; i < BENCH_CALLS; i++) {
+    x = (int16_t)check_rand(&seed) >> 6;
+    y = (int16_t)check_rand(&seed) >> 6;
+    fsum += atan2f(y, x);
+  }
+  float_ns = (double)(bench_ns() - start) / BENCH_CALLS;
+  bench_sink += (uint32_t)fsum;
+
+  printf("time per call, random numbers included:\n");
+  printf("  %-14s %5.2f ns\n", "tilt_atan2", int_ns);
+  printf("  %-14s %5.2f ns\n", "atan2f", float_ns);
+}
+
+int main(void) {
+  atan2_sweep();
+  orientations();
+  benchmarks();
+  return check_failures;
+}
@@ -0,0 +1,128 @@
+/* Copyright (c) 2023  Hunter Whyte */
+/* synthetic labelled accelerometer traces, see trace_gen.h */
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "trace_gen.h"
+
+#define FULL_SCALE 511 /* 10 bit counts */
+#define NOISE_COUNTS 3
+#define MAX_CLAPS (GEN_MAX_LABELS)
+
+static uint32_t state;
+
+static uint32_t gen_rand(void) {
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return state;
+}
+
+/* uniform in [low, high] */
+static float gen_uniform(float low, float high) {
+  return low + (high - low) * (gen_rand() & 0xFFFFFF) / (float)0xFFFFFF;
+}
+
+static int16_t counts(float g) {
+  float c = roundf(g * GEN_COUNTS_PER_G + gen_uniform(-NOISE_COUNTS, NOISE_COUNTS));
+  if (c > FULL_SCALE) {
+    return FULL_SCALE;
+  }
+  if (c < -FULL_SCALE - 1) {
+    return -FULL_SCALE - 1;
+  }
+  return c;
+}
+
+/* clap times for the kind, on the sample grid */
+static void claps_place(gen_trace_t* trace, gen_kind_e kind, uint32_t duration_ms,
+                        uint32_t beat_ms) {
+  uint32_t t = 1000;
+  int32_t jitter;
+  trace->label_count = 0;
+  if (kind != GEN_CLAPS && kind != GEN_BEAT && kind != GEN_CLAPS_WALKING &&
+      kind != GEN_LIGHT_CLAPS) {
+    return;
+  }
+  while (t + 500 < duration_ms && trace->label_count < MAX_CLAPS) {
+    trace->labels[trace->label_count++] = t / GEN_PERIOD_MS * GEN_PERIOD_MS;
+    if (kind == GEN_BEAT) {
+      jitter = (int32_t)(gen_rand() % 41) - 20;
+      t = trace->labels[0] + trace->label_count * beat_ms + jitter;
+    } else {
+      t += 400 + gen_rand() % 1100;
+    }
+  }
+}
+
+void trace_gen(gen_trace_t* trace, gen_kind_e kind, uint32_t seed, uint32_t duration_ms,
+               uint32_t beat_ms) {
+  static const char* names[GEN_NUM_KINDS] = {
+      [GEN_STILL] = "still",
+      [GEN_CLAPS] = "claps",
+      [GEN_BEAT] = "beat",
+      [GEN_WALK] = "walk",
+      [GEN_SWING] = "swing",
+      [GEN_CLAPS_WALKING] = "claps walking",
+      [GEN_LIGHT_CLAPS] = "light claps",
+  };
+  trace_t recorder;
+  uint32_t t, clap = 0;
+  uint16_t k;
+  float ax, ay, az, s, pitch, amplitude[MAX_CLAPS], direction[MAX_CLAPS][3], norm;
+  /* spike then rebound, in samples after the clap */
+  static const float shape[3] = {1.0f, -0.6f, 0.2f};
+
+  state = seed ? seed : 1;
+  trace->name = names[kind];
+  claps_place(trace, kind, duration_ms, beat_ms);
+  for (k = 0; k < trace->label_count; k++) {
+    amplitude[k] = kind == GEN_LIGHT_CLAPS ? gen_uniform(0.7f, 1.0f) : gen_uniform(1.5f, 3.0f);
+    do {
+      direction[k][0] = gen_uniform(-1, 1);
+      direction[k][1] = gen_uniform(-1, 1);
+      direction[k][2] = gen_uniform(-1, 1);
+      norm = sqrtf(direction[k][0] * direction[k][0] + direction[k][1] * direction[k][1] +
+                   direction[k][2] * direction[k][2]);
+    } while (norm < 0.2f || norm > 1.0f);
+    direction[k][0] /= norm;
+    direction[k][1] /= norm;
+    direction[k][2] /= norm;
+  }
+
+  trace_begin(&recorder, trace->buffer, sizeof(trace->buffer), GEN_PERIOD_MS, 0);
+  for (t = GEN_PERIOD_MS; t <= duration_ms; t += GEN_PERIOD_MS) {
+    s = t / 1000.0f;
+    ax = 0;
+    ay = 0;
+    az = 1;
+    if (kind == GEN_WALK || kind == GEN_CLAPS_WALKING) {
+      /* bob at two steps a second and a small jolt at each heel strike */
+      az += 0.3f * sinf(2 * M_PI * 2 * s);
+      ax += 0.1f * sinf(2 * M_PI * 1 * s);
+      if (t % 500 < GEN_PERIOD_MS) {
+        az += 0.35f;
+      }
+    } else if (kind == GEN_SWING) {
+      /* forearm turning up and down through 45 degrees while it swings */
+      pitch = 0.8f * sinf(2 * M_PI * 0.5f * s);
+      ax = sinf(pitch) + 0.6f * sinf(2 * M_PI * s);
+      az = cosf(pitch);
+      ay = 0.2f * sinf(2 * M_PI * 0.7f * s);
+    }
+    while (clap < trace->label_count && trace->labels[clap] + 2 * GEN_PERIOD_MS < t) {
+      clap++;
+    }
+    for (k = clap; k < trace->label_count && trace->labels[k] <= t; k++) {
+      float a = amplitude[k] * shape[(t - trace->labels[k]) / GEN_PERIOD_MS];
+      ax += a * direction[k][0];
+      ay += a * direction[k][1];
+      az += a * direction[k][2];
+    }
+    if (!trace_record(&recorder, t, counts(ax), counts(ay), counts(az))) {
+      break;
+    }
+  }
+  trace->length = recorder.length;
+}
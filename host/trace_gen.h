@@ -0,0 +1,47 @@
+/* Copyright (c) 2023  Hunter Whyte */
+#ifndef TRACE_GEN_H
+#define TRACE_GEN_H
+
+#include <stdint.h>
+
+#include "trace.h"
+
+/*
+Synthetic accelerometer traces in the format of trace.h, for replaying through the motion
+detection until there are enough recorded ones. Samples are 10 bit counts at the sensor's 2g
+range and 50Hz, with gravity, a little noise and clipping at full scale. Each trace carries the
+times of the claps in it as labels.
+A clap is a spike of 1.5g to 3g in a random direction for one sample that rebounds over the next
+two, everything else in the traces is motion that shouldn't count as one. Light claps are 0.7g to
+1g, just over the clap threshold when measured as a vector but not always on any single axis.
+*/
+
+#define GEN_COUNTS_PER_G 256
+#define GEN_PERIOD_MS 20
+#define GEN_TRACE_BYTES 16384 /* about 65s of samples */
+#define GEN_MAX_LABELS 128
+
+typedef enum gen_kind {
+  GEN_STILL,         /* resting on a table */
+  GEN_CLAPS,         /* claps at random intervals, arm still in between */
+  GEN_BEAT,          /* claps on a beat with a little timing jitter */
+  GEN_WALK,          /* walking, a bob at each step */
+  GEN_SWING,         /* arm swinging and turning slowly */
+  GEN_CLAPS_WALKING, /* claps at random intervals while walking */
+  GEN_LIGHT_CLAPS,   /* light claps at random intervals, arm still in between */
+  GEN_NUM_KINDS
+} gen_kind_e;
+
+typedef struct gen_trace {
+  const char* name;
+  uint8_t buffer[GEN_TRACE_BYTES];
+  uint16_t length;
+  uint32_t labels[GEN_MAX_LABELS]; /* time of each clap in ms */
+  uint16_t label_count;
+} gen_trace_t;
+
+/* beat_ms is the beat period for GEN_BEAT, the other kinds ignore it */
+void trace_gen(gen_trace_t* trace, gen_kind_e kind, uint32_t seed, uint32_t duration_ms,
+               uint32_t beat_ms);
+
+#endif /* TRACE_GEN_H */
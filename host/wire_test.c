@@ -0,0 +1,314 @@
+/* Copyright (c) 2023  Hunter Whyte */
+/* round trips of every message type in wire.h, their encode and decode throughput, and the
+   capacity model in wire.h against what the controller's scheduler (ctrl.h) actually sends: the
+   group changes it gets out per second with every group of a channel changing, and how long the
+   keyframe rotation takes idle and busy */
+#include <stdint.h>
+#include <stdio.h>
+
+#include "check.h"
+#include "common.h"
+#include "ctrl.h"
+#include "sim.h"
+#include "wire.h"
+
+#define BENCH_MESSAGES 1000000
+#define CAPACITY_SECONDS 60
+#define MODEL_PERCENT 2 /* measured figures have to be this close to the model */
+/* the busy schedule in wire.h, messages in each repeat, group changes and keyframes in it */
+#define BUSY_MESSAGES 16
+#define BUSY_CHANGES 28
+#define BUSY_KEYFRAMES 4
+
+static uint32_t state = 1;
+
+static group_data_t random_group(void) {
+  uint32_t r = check_rand(&state);
+  return (group_data_t){r & 0x1F, (r >> 5) & 0x1F, (r >> 10) & 0x3F, (r >> 16) & 0x1F};
+}
+
+static bool group_equal(const group_data_t* a, const group_data_t* b) {
+  return a->control == b->control && a->red == b->red && a->green == b->green &&
+         a->blue == b->blue;
+}
+
+/* ######################### ROUND TRIPS ######################### */
+static group_data_t channel_groups[GROUPS_PER_CHANNEL];
+
+/* every page of a channel, decoded for every group of the channel */
+static void pages_check(void) {
+  uint8_t payload[WIRE_PAYLOAD_SIZE], page, group, channel;
+  group_data_t data;
+  bool carried;
+
+  for (channel = 0; channel < NUM_CHANNELS; channel++) {
+    for (group = 0; group < GROUPS_PER_CHANNEL; group++) {
+      channel_groups[group] = random_group();
+    }
+    for (page = 0; page < PAGES_PER_CHANNEL; page++) {
+      wire_encode_page(payload, page, page, &channel_groups[page * GROUPS_PER_PAGE], 1);
+      CHECK(WIRE_TYPE(payload) == WIRE_TYPE_PAGE && WIRE_SEQ(payload) == (page & WIRE_SEQ_MASK),
+            "page %d: header %02x", page, payload[0]);
+      for (group = 0; group < GROUPS_PER_CHANNEL; group++) {
+        carried = wire_decode_group(payload, channel * GROUPS_PER_CHANNEL + group, &data);
+        CHECK(carried == (GROUP_TO_PAGE(group) == page), "page %d carries group %d: %d", page,
+              group, carried);
+        CHECK(!carried || group_equal(&data, &channel_groups[group]), "page %d group %d", page,
+              group);
+      }
+    }
+  }
+}
+
+/* change messages with none, one or two random groups of a channel */
+static void changes_check(void) {
+  uint8_t payload[WIRE_PAYLOAD_SIZE], indexes[WIRE_CHANGES_PER_MESSAGE], count, group;
+  group_data_t data;
+  bool carried;
+  uint32_t i;
+
+  for (group = 0; group < GROUPS_PER_CHANNEL; group++) {
+    channel_groups[group] = random_group();
+  }
+  for (i = 0; i < 10000; i++) {
+    count = i % (WIRE_CHANGES_PER_MESSAGE + 1);
+    indexes[0] = check_rand(&state) % GROUPS_PER_CHANNEL;
+    indexes[1] = (indexes[0] + 1 + check_rand(&state) % (GROUPS_PER_CHANNEL - 1)) %
+                 GROUPS_PER_CHANNEL;
+    wire_encode_changes(payload, i, channel_groups, indexes, count);
+    for (group = 0; group < GROUPS_PER_CHANNEL; group++) {
+      carried = wire_decode_group(payload, GROUPS_PER_CHANNEL + group, &data);
+      CHECK(carried == ((count > 0 && group == indexes[0]) || (count > 1 && group == indexes[1])),
+            "changes %d %d of %d carry group %d: %d", indexes[0], indexes[1], count, group,
+            carried);
+      CHECK(!carried || group_equal(&data, &channel_groups[group]), "change of group %d", group);
+    }
+  }
+}
+
+/* time messages, and cues with times either side of the receiver's show time */
+static void times_check(void) {
+  static const int32_t aheads[] = {0, 1, -1, 32768, -32768, (1 << 27) - 1, -(1 << 27)};
+  uint8_t payload[WIRE_PAYLOAD_SIZE];
+  group_data_t sent, data;
+  uint32_t i, j, now, time, decoded;
+
+  for (i = 0; i < 1000; i++) {
+    time = check_rand(&state);
+    wire_encode_time(payload, i, time);
+    CHECK(wire_decode_time(payload, &decoded) && decoded == time, "time %u: %u", time, decoded);
+    CHECK(!wire_decode_group(payload, 1, &data), "time message carries a group");
+    for (j = 0; j < sizeof(aheads) / sizeof(aheads[0]); j++) {
+      now = check_rand(&state);
+      sent = random_group();
+      wire_encode_cue(payload, i, 5, &sent, now + aheads[j]);
+      CHECK(wire_decode_cue(payload, 5, now, &data, &decoded) && decoded == now + aheads[j] &&
+                group_equal(&data, &sent),
+            "cue %d ahead of %u: %u", aheads[j], now, decoded);
+      CHECK(!wire_decode_cue(payload, 6, now, &data, &decoded), "cue for group 5 taken by 6");
+      CHECK(!wire_decode_group(payload, 5, &data), "cue taken as a change");
+    }
+  }
+}
+
+/* runs of every length with each message of the run missed in turn */
+static void parity_check(void) {
+  uint8_t run[WIRE_PARITY_SPAN][WIRE_PAYLOAD_SIZE], xor[WIRE_PAYLOAD_SIZE] = {0};
+  uint8_t payload[WIRE_PAYLOAD_SIZE], indexes[WIRE_CHANGES_PER_MESSAGE];
+  uint8_t covers, missed, i, j, group;
+  wire_parity_t parity;
+  group_data_t data;
+  bool recovered;
+
+  for (group = 0; group < GROUPS_PER_CHANNEL; group++) {
+    channel_groups[group] = random_group();
+  }
+  for (covers = 1; covers <= WIRE_PARITY_SPAN; covers++) {
+    for (i = 0; i < covers; i++) {
+      indexes[0] = 2 * i;
+      indexes[1] = 2 * i + 1;
+      wire_encode_changes(run[i], 14 + i, channel_groups, indexes, WIRE_CHANGES_PER_MESSAGE);
+      for (j = 1; j < WIRE_PAYLOAD_SIZE; j++) {
+        xor[j] = i ? xor[j] ^ run[i][j] : run[i][j];
+      }
+    }
+    wire_encode_parity(payload, 14 + covers, covers, xor);
+    for (missed = 0; missed < covers; missed++) {
+      wire_parity_reset(&parity);
+      for (i = 0; i < covers; i++) {
+        if (i != missed) {
+          wire_parity_add(&parity, run[i]);
+        }
+      }
+      for (group = 0; group < 2 * covers; group++) {
+        recovered = wire_parity_recover(&parity, payload, group, &data);
+        CHECK(recovered == (group / 2 == missed), "run of %d missing %d: group %d recovered %d",
+              covers, missed, group, recovered);
+        CHECK(!recovered || group_equal(&data, &channel_groups[group]), "group %d rebuilt wrong",
+              group);
+      }
+    }
+  }
+}
+
+/* ######################### THROUGHPUT ######################### */
+static void throughput(void) {
+  static uint8_t payloads[256][WIRE_PAYLOAD_SIZE];
+  uint8_t indexes[WIRE_CHANGES_PER_MESSAGE] = {3, 77};
+  group_data_t data;
+  uint32_t i, time, sum = 0;
+  uint64_t start;
+  double page_encode, page_decode, changes_encode, changes_decode, cue_decode;
+
+  for (i = 0; i < GROUPS_PER_CHANNEL; i++) {
+    channel_groups[i] = random_group();
+  }
+  start = bench_ns();
+  for (i = 0; i < BENCH_MESSAGES; i++) {
+    wire_encode_page(payloads[i & 0xFF], i, i % PAGES_PER_CHANNEL,
+                     &channel_groups[(i % PAGES_PER_CHANNEL) * GROUPS_PER_PAGE], i & 3);
+  }
+  page_encode = (double)(bench_ns() - start) / BENCH_MESSAGES;
+  start = bench_ns();
+  for (i = 0; i < BENCH_MESSAGES; i++) {
+    sum += wire_decode_group(payloads[i & 0xFF], i % GROUPS_PER_CHANNEL, &data) + data.red;
+  }
+  page_decode = (double)(bench_ns() - start) / BENCH_MESSAGES;
+
+  start = bench_ns();
+  for (i = 0; i < BENCH_MESSAGES; i++) {
+    indexes[0] = i % GROUPS_PER_CHANNEL;
+    wire_encode_changes(payloads[i & 0xFF], i, channel_groups, indexes, 2);
+  }
+  changes_encode = (double)(bench_ns() - start) / BENCH_MESSAGES;
+  start = bench_ns();
+  for (i = 0; i < BENCH_MESSAGES; i++) {
+    sum += wire_decode_group(payloads[i & 0xFF], i % GROUPS_PER_CHANNEL, &data) + data.red;
+  }
+  changes_decode = (double)(bench_ns() - start) / BENCH_MESSAGES;
+
+  for (i = 0; i < 256; i++) {
+    wire_encode_cue(payloads[i], i, i % GROUPS_PER_CHANNEL, &channel_groups[0], i * 1000);
+  }
+  start = bench_ns();
+  for (i = 0; i < BENCH_MESSAGES; i++) {
+    sum += wire_decode_cue(payloads[i & 0xFF], i % GROUPS_PER_CHANNEL, i, &data, &time) + time;
+  }
+  cue_decode = (double)(bench_ns() - start) / BENCH_MESSAGES;
+  bench_sink += sum;
+
+  printf("time per message, encode and the decode of one group:\n");
+  printf("  page     %6.1f ns %6.1f ns\n", page_encode, page_decode);
+  printf("  changes  %6.1f ns %6.1f ns\n", changes_encode, changes_decode);
+  printf("  cue      %9s %6.1f ns\n", "", cue_decode);
+}
+
+/* ######################### CAPACITY ######################### */
+typedef struct capacity {
+  uint32_t messages;
+  uint32_t changes; /* change records and pages slots marked changed */
+  uint32_t rotations;
+  uint64_t rotation_ns; /* time of the last page 0 */
+  uint64_t rotation_sum_ns;
+} capacity_t;
+
+static void capacity_tx(uint8_t channel, const uint8_t payload[WIRE_PAYLOAD_SIZE],
+                        uint64_t time_ns, void* ctx) {
+  capacity_t* capacity = ctx;
+  group_data_t data;
+  uint8_t group;
+
+  if (channel != 0) {
+    return;
+  }
+  capacity->messages++;
+  if (WIRE_TYPE(payload) == WIRE_TYPE_CHANGE) {
+    for (group = 0; group < GROUPS_PER_CHANNEL; group++) {
+      capacity->changes += wire_decode_group(payload, group, &data);
+    }
+  } else if (WIRE_TYPE(payload) == WIRE_TYPE_PAGE) {
+    capacity->changes += (payload[4] & (WIRE_GROUP_CHANGED >> 16)) != 0;
+    capacity->changes += (payload[7] & (WIRE_GROUP_CHANGED >> 16)) != 0;
+    if (payload[1] == 0) {
+      if (capacity->rotation_ns) {
+        capacity->rotation_sum_ns += time_ns - capacity->rotation_ns;
+        capacity->rotations++;
+      }
+      capacity->rotation_ns = time_ns;
+    }
+  }
+}
+
+/* the controller from now for CAPACITY_SECONDS, with every group of channel 0 changed before
+   each of its messages when busy */
+static void capacity_run(bool busy, capacity_t* capacity) {
+  uint64_t time, end = ctrl_next_ns() + CAPACITY_SECONDS * SIM_S;
+  uint8_t group, color = 0;
+
+  *capacity = (capacity_t){0};
+  while ((time = ctrl_next_ns()) < end) {
+    if (busy) {
+      color++;
+      for (group = 0; group < GROUPS_PER_CHANNEL; group++) {
+        ctrl_update_payload(group, 0, color << 3, group << 2, 0);
+      }
+    }
+    ctrl_run_until(time, capacity_tx, capacity);
+  }
+}
+
+static void capacity_model(void) {
+  static const uint16_t periods[] = {1024, 512, 328};
+  capacity_t idle, busy;
+  double rate, period_rate, changes, model_changes, model_idle, model_busy, idle_s, busy_s;
+  uint32_t i;
+
+  ctrl_start();
+  capacity_run(false, &idle);
+  capacity_run(true, &busy);
+  rate = (double)busy.messages / CAPACITY_SECONDS;
+  changes = (double)busy.changes / CAPACITY_SECONDS;
+  idle_s = (double)idle.rotation_sum_ns / idle.rotations / SIM_S;
+  busy_s = (double)busy.rotation_sum_ns / busy.rotations / SIM_S;
+
+  model_changes = rate * BUSY_CHANGES / BUSY_MESSAGES;
+  model_idle = PAGES_PER_CHANNEL / (rate * (1 - 1.0 / WIRE_TIME_EVERY));
+  model_busy = PAGES_PER_CHANNEL / (rate * BUSY_KEYFRAMES / BUSY_MESSAGES);
+
+  printf("channel 0 at CHAN_PERIOD %d for %ds, measured and modelled:\n", CHAN_PERIOD,
+         CAPACITY_SECONDS);
+  printf("  messages/s            %6.1f\n", rate);
+  printf("  group changes/s       %6.1f %6.1f\n", changes, model_changes);
+  printf("  rotation idle         %5.2fs %5.2fs\n", idle_s, model_idle);
+  printf("  rotation busy         %5.2fs %5.2fs\n", busy_s, model_busy);
+  CHECK(rate == 32768.0 / CHAN_PERIOD, "%.1f messages/s", rate);
+  CHECK(changes * 100 > model_changes * (100 - MODEL_PERCENT) &&
+            changes * 100 < model_changes * (100 + MODEL_PERCENT),
+        "%.1f group changes/s against %.1f modelled", changes, model_changes);
+  CHECK(idle_s * 100 < model_idle * (100 + MODEL_PERCENT) &&
+            idle_s * 100 > model_idle * (100 - MODEL_PERCENT),
+        "idle rotation %.2fs against %.2fs modelled", idle_s, model_idle);
+  CHECK(busy_s * 100 < model_busy * (100 + MODEL_PERCENT) &&
+            busy_s * 100 > model_busy * (100 - MODEL_PERCENT),
+        "busy rotation %.2fs against %.2fs modelled", busy_s, model_busy);
+
+  printf("model for other channel periods, groups of a channel:\n");
+  printf("  %6s %7s %10s %14s %9s %9s\n", "period", "rate", "changes/s", "changing 10Hz",
+         "rot idle", "rot busy");
+  for (i = 0; i < sizeof(periods) / sizeof(periods[0]); i++) {
+    period_rate = 32768.0 / periods[i];
+    printf("  %6u %5.0fHz %10.0f %14u %8.1fs %8.1fs\n", periods[i], period_rate,
+           model_changes / rate * period_rate, (unsigned)(model_changes / rate * period_rate / 10),
+           model_idle * rate / period_rate, model_busy * rate / period_rate);
+  }
+}
+
+int main(void) {
+  pages_check();
+  changes_check();
+  times_check();
+  parity_check();
+  throughput();
+  capacity_model();
+  return check_failures;
+}
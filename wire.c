@@ -0,0 +1,224 @@
+/* Copyright (c) 2023  Hunter Whyte */
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "common.h"
+#include "wire.h"
+
+/* build a page message, groups points at the first group of the page and bit n of changed marks
+   group n of the page as changed */
+void wire_encode_page(uint8_t* payload, uint8_t seq, uint8_t page, const group_data_t* groups,
+                      uint8_t changed) {
+  uint32_t slot;
+  uint8_t i;
+  uint8_t* p = &payload[2];
+
+  payload[0] = (WIRE_TYPE_PAGE << 4) | (seq & WIRE_SEQ_MASK);
+  payload[1] = page;
+  for (i = 0; i < GROUPS_PER_PAGE; i++) {
+    slot = GROUP_PACKED(groups[i]);
+    if (changed & (1 << i)) {
+      slot |= WIRE_GROUP_CHANGED;
+    }
+    p[0] = slot;
+    p[1] = slot >> 8;
+    p[2] = slot >> 16;
+    p += WIRE_GROUP_BYTES;
+  }
+}
+
+/* build a change message, groups points at the first group of the channel and indexes are the
+   count changed groups within the channel to send */
+void wire_encode_changes(uint8_t* payload, uint8_t seq, const group_data_t* groups,
+                         const uint8_t* indexes, uint8_t count) {
+  uint64_t records = 0;
+  uint64_t record;
+  uint8_t i;
+
+  payload[0] = (WIRE_TYPE_CHANGE << 4) | (seq & WIRE_SEQ_MASK);
+  for (i = 0; i < WIRE_CHANGES_PER_MESSAGE; i++) {
+    if (i < count) {
+      record = ((uint64_t)indexes[i] << 21) | GROUP_PACKED(groups[indexes[i]]);
+    } else {
+      record = (uint64_t)WIRE_NO_GROUP << 21;
+    }
+    records |= record << (i * WIRE_RECORD_BITS);
+  }
+  for (i = 1; i < WIRE_PAYLOAD_SIZE; i++) {
+    payload[i] = records;
+    records >>= 8;
+  }
+}
+
+/* build a time message, show_time is when the message goes out */
+void wire_encode_time(uint8_t* payload, uint8_t seq, uint32_t show_time) {
+  uint8_t i;
+  payload[0] = (WIRE_TYPE_TIME << 4) | (seq & WIRE_SEQ_MASK);
+  for (i = 1; i < WIRE_PAYLOAD_SIZE; i++) {
+    payload[i] = i <= 4 ? show_time >> ((i - 1) * 8) : 0;
+  }
+}
+
+/* build a cue message, index is the group within the channel and show_time when it applies */
+void wire_encode_cue(uint8_t* payload, uint8_t seq, uint8_t index, const group_data_t* data,
+                     uint32_t show_time) {
+  uint64_t records;
+  uint8_t i;
+
+  payload[0] = (WIRE_TYPE_CUE << 4) | (seq & WIRE_SEQ_MASK);
+  records = ((uint64_t)index << 21) | GROUP_PACKED((*data));
+  records |= (uint64_t)(show_time & ((1UL << WIRE_CUE_TIME_BITS) - 1)) << WIRE_RECORD_BITS;
+  for (i = 1; i < WIRE_PAYLOAD_SIZE; i++) {
+    payload[i] = records;
+    records >>= 8;
+  }
+}
+
+/* build a parity message, bytes 1-7 of parity are the XOR of the covers messages before it */
+void wire_encode_parity(uint8_t* payload, uint8_t seq, uint8_t covers, const uint8_t* parity) {
+  payload[0] = ((WIRE_TYPE_PARITY | (covers - 1)) << 4) | (seq & WIRE_SEQ_MASK);
+  memcpy(&payload[1], &parity[1], WIRE_PAYLOAD_SIZE - 1);
+}
+
+/* 21 bits of group data out of a page slot or change record */
+static void group_unpack(uint32_t slot, group_data_t* data) {
+  data->control = GROUP_CONTROL(slot);
+  data->red = GROUP_RED(slot);
+  data->green = GROUP_GREEN(slot);
+  data->blue = GROUP_BLUE(slot);
+}
+
+/* pull one group out of a message, false if the message doesn't carry it */
+bool wire_decode_group(const uint8_t* payload, uint8_t group, group_data_t* data) {
+  uint32_t slot;
+  uint64_t records = 0;
+  const uint8_t* p;
+  uint8_t i;
+
+  if (WIRE_TYPE(payload) == WIRE_TYPE_CHANGE) {
+    for (i = WIRE_PAYLOAD_SIZE - 1; i > 0; i--) {
+      records = (records << 8) | payload[i];
+    }
+    for (i = 0; i < WIRE_CHANGES_PER_MESSAGE; i++) {
+      slot = records & ((1UL << WIRE_RECORD_BITS) - 1);
+      if ((slot >> 21) == group % GROUPS_PER_CHANNEL) {
+        group_unpack(slot, data);
+        return true;
+      }
+      records >>= WIRE_RECORD_BITS;
+    }
+    return false;
+  }
+  if (WIRE_TYPE(payload) != WIRE_TYPE_PAGE || payload[1] != GROUP_TO_PAGE(group)) {
+    return false;
+  }
+  p = &payload[2 + GROUP_TO_INDEX(group) * WIRE_GROUP_BYTES];
+  slot = p[0] | (p[1] << 8) | ((uint32_t)p[2] << 16);
+  group_unpack(slot, data);
+  return true;
+}
+
+/* pull a cue for one group out of a message, false if the message isn't a cue for it. The time
+   is the one closest to now that matches the 28 bits sent */
+bool wire_decode_cue(const uint8_t* payload, uint8_t group, uint32_t now, group_data_t* data,
+                     uint32_t* show_time) {
+  uint64_t records = 0;
+  uint32_t slot;
+  int32_t ahead;
+  uint8_t i;
+
+  if (WIRE_TYPE(payload) != WIRE_TYPE_CUE) {
+    return false;
+  }
+  for (i = WIRE_PAYLOAD_SIZE - 1; i > 0; i--) {
+    records = (records << 8) | payload[i];
+  }
+  slot = records & ((1UL << WIRE_RECORD_BITS) - 1);
+  if ((slot >> 21) != group % GROUPS_PER_CHANNEL) {
+    return false;
+  }
+  group_unpack(slot, data);
+  /* difference from the low bits of now, sign extended */
+  ahead = (int32_t)(((uint32_t)(records >> WIRE_RECORD_BITS) - now) << (32 - WIRE_CUE_TIME_BITS));
+  *show_time = now + (ahead >> (32 - WIRE_CUE_TIME_BITS));
+  return true;
+}
+
+/* show time out of a time message, false for any other message */
+bool wire_decode_time(const uint8_t* payload, uint32_t* show_time) {
+  if (WIRE_TYPE(payload) != WIRE_TYPE_TIME) {
+    return false;
+  }
+  *show_time = payload[1] | (payload[2] << 8) | (payload[3] << 16) | ((uint32_t)payload[4] << 24);
+  return true;
+}
+
+void wire_parity_reset(wire_parity_t* parity) {
+  parity->count = 0;
+}
+
+/* every message received goes through here, change messages are kept for the next parity
+   message and anything else starts the run again since parity only covers changes in a row */
+void wire_parity_add(wire_parity_t* parity, const uint8_t* payload) {
+  if (WIRE_TYPE(payload) != WIRE_TYPE_CHANGE) {
+    parity->count = 0;
+    return;
+  }
+  if (parity->count == WIRE_PARITY_SPAN) {
+    memmove(parity->messages[0], parity->messages[1],
+            (WIRE_PARITY_SPAN - 1) * WIRE_PAYLOAD_SIZE);
+    parity->count--;
+  }
+  memcpy(parity->messages[parity->count++], payload, WIRE_PAYLOAD_SIZE);
+}
+
+/* rebuild the one message of a parity message's run that was missed and pull the group out of
+   it, false if this isn't a parity message, more than one was missed, or the missed one has
+   nothing newer for the group than the rest of the run */
+bool wire_parity_recover(const wire_parity_t* parity, const uint8_t* payload, uint8_t group,
+                         group_data_t* data) {
+  uint8_t missed[WIRE_PAYLOAD_SIZE];
+  const uint8_t* covered[WIRE_PARITY_SPAN] = {NULL};
+  uint8_t covers = WIRE_PARITY_COVERS(payload);
+  uint8_t first = (WIRE_SEQ(payload) - covers) & WIRE_SEQ_MASK;
+  uint8_t count = 0;
+  uint8_t gap = 0;
+  uint8_t offset;
+  group_data_t newer;
+  uint8_t i, j;
+
+  if (!WIRE_IS_PARITY(payload) || covers > WIRE_PARITY_SPAN) {
+    return false;
+  }
+  for (i = 0; i < parity->count; i++) {
+    offset = (WIRE_SEQ(parity->messages[i]) - first) & WIRE_SEQ_MASK;
+    if (offset < covers && !covered[offset]) {
+      covered[offset] = parity->messages[i];
+      count++;
+    }
+  }
+  if (count != covers - 1) {
+    return false;
+  }
+  memcpy(missed, payload, WIRE_PAYLOAD_SIZE);
+  for (i = 0; i < covers; i++) {
+    if (!covered[i]) {
+      gap = i;
+      continue;
+    }
+    for (j = 1; j < WIRE_PAYLOAD_SIZE; j++) {
+      missed[j] ^= covered[i][j];
+    }
+  }
+  missed[0] = (WIRE_TYPE_CHANGE << 4) | ((first + gap) & WIRE_SEQ_MASK);
+  if (!wire_decode_group(missed, group, data)) {
+    return false;
+  }
+  for (i = gap + 1; i < covers; i++) {
+    if (wire_decode_group(covered[i], group, &newer)) {
+      return false;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,139 @@
+/* Copyright (c) 2023  Hunter Whyte */
+/* shared between bracelet and controller */
+#ifndef WIRE_H
+#define WIRE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "common.h"
+
+/*
+ANT payload format. Three groups to a payload limited a channel to three groups, so instead each
+channel's groups are split into pages of GROUPS_PER_PAGE and the controller sends one page per
+channel period, rotating through the pages and jumping the rotation for pages that changed.
+Every message is 8 bytes:
+  byte 0    message type in the top 4 bits, sequence number in the bottom 4
+  byte 1    page index within the channel
+  byte 2-4  first group of the page, 24 bits little endian
+  byte 5-7  second group
+A group is the 21 bits of GROUP_PACKED with WIRE_GROUP_CHANGED set if the group changed since
+the page was last sent. Pages are keyframes, the full state of the channel goes round in them.
+
+Changes go out as change messages instead, which carry any WIRE_CHANGES_PER_MESSAGE groups of the
+channel rather than both groups of one page:
+  byte 0    message type and sequence number, as a page
+  byte 1-7  two 28 bit records, little endian, each the 7 bit group index within the channel
+            above the 21 bits of GROUP_PACKED. Index WIRE_NO_GROUP marks an empty record
+A bracelet only tracks the channel of its group and only decodes its own slot, every other
+message is dropped after reading at most the two record indexes.
+
+Every WIRE_TIME_EVERY messages a channel sends a time message instead:
+  byte 0    message type and sequence number, as a page
+  byte 1-4  show time the message was sent at in 1/32768s, little endian
+  byte 5-7  0
+Messages go out exactly CHAN_PERIOD apart, so every message after a time message is timed too,
+by its sequence number. The show time comes from the controller's clock so it is the same on
+every channel.
+
+A cue is a change that takes effect at a show time instead of when it is received, so bracelets
+on every channel and ones that missed a message switch together:
+  byte 0    message type and sequence number, as a page
+  byte 1-7  a 28 bit change record, then the low 28 bits of the show time to apply it at, as two
+            28 bit records
+The controller sends each cue WIRE_CUE_REPEATS times ahead of its time, and a change for the group
+once the time has passed for bracelets that missed all of them. 28 bits of show time cover 8192s,
+the bracelet takes the time closest to its own show time.
+
+Nothing is acknowledged. With WIRE_PARITY set, the controller follows a run of change messages
+with a parity message covering the last WIRE_PARITY_SPAN of them at most, once no group is
+waiting to go out:
+  byte 0    WIRE_TYPE_PARITY with the number of changes covered less one in the type, and the
+            sequence number
+  byte 1-7  XOR of bytes 1-7 of the change messages right before it
+A bracelet that missed one of those messages rebuilds it from the others and the parity, and
+takes the change if it is for its group and no later message of the run had the group, instead
+of waiting for the group's page to come round. Parity only takes messages that would otherwise
+be an idle keyframe, so it never delays a change, but it slows the idle rotation. host/parity_test.c
+reports how long changes take to reach bracelets at several loss rates, with and without parity.
+
+Capacity per channel, with one message every CHAN_PERIOD/32768s. Idle, the rotation takes every
+message but the time messages. Busy, with more groups changing than the channel can send, a
+keyframe goes out after WIRE_KEYFRAME_EVERY - 1 other messages and carries the changed groups of
+its page, and a time message goes out every WIRE_TIME_EVERY messages. No parity goes out while
+busy. At the current settings the busy schedule repeats every 16 messages: 4 keyframes, 10 change
+messages and 2 time messages, with 28 group changes. Each cue takes WIRE_CUE_REPEATS messages
+from the changes.
+host/wire_test.c runs the controller's scheduler against these figures.
+  messages/s      = 32768 / CHAN_PERIOD
+  group changes/s = messages/s * 28 / 16 busy
+  full rotation   = PAGES_PER_CHANNEL / (messages/s * (1 - 1/T)) idle, T = WIRE_TIME_EVERY
+                    PAGES_PER_CHANNEL / (messages/s * 4 / 16) busy
+  CHAN_PERIOD  rate    group changes/s  groups changing at 10Hz  rotation idle / busy
+  1024         32Hz    56               5                        2.1s / 7.5s
+  512          64Hz    112              11                       1.1s / 3.8s
+  328          100Hz   175              17                       0.7s / 2.4s
+Without change records a scattered change takes a whole page, 32 changes/s at 32Hz. A changed
+group goes out in the next message of its channel, the rotation is what a bracelet that just
+joined or missed a message waits for in the worst case.
+*/
+
+#define WIRE_PAYLOAD_SIZE 8
+#define WIRE_TYPE_PAGE 0x0
+#define WIRE_TYPE_CHANGE 0x1
+#define WIRE_TYPE_TIME 0x2
+#define WIRE_TYPE_CUE 0x3
+#define WIRE_TYPE_PARITY 0x8 /* to 0xF, the low 3 bits are the changes covered less one */
+#define WIRE_CHANGES_PER_MESSAGE 2
+#define WIRE_RECORD_BITS 28
+#define WIRE_NO_GROUP 0x7F /* group index of an empty change record */
+#define WIRE_KEYFRAME_EVERY 4
+#define WIRE_TIME_EVERY 8
+#define WIRE_CUE_REPEATS 3
+#define WIRE_CUE_TIME_BITS 28
+/* shortest time ahead a cue is scheduled, enough to send every repeat around a time message */
+#define WIRE_CUE_MIN_LEAD ((WIRE_CUE_REPEATS + 2) * CHAN_PERIOD)
+/* 1 for the controller to send parity messages, bracelets use them either way */
+#ifndef WIRE_PARITY
+#define WIRE_PARITY 0
+#endif
+#define WIRE_PARITY_SPAN 3 /* most change messages covered by one parity message */
+#if WIRE_PARITY_SPAN > 8
+#error "parity messages only have 3 bits for the changes covered"
+#endif
+#if GROUPS_PER_CHANNEL > WIRE_NO_GROUP
+#error "change records only have 7 bits for the group index"
+#endif
+#define WIRE_SEQ_MASK 0x0F
+#define WIRE_GROUP_BYTES 3
+#define WIRE_GROUP_CHANGED 0x800000UL
+
+#define WIRE_TYPE(payload) ((payload)[0] >> 4)
+#define WIRE_SEQ(payload) ((payload)[0] & WIRE_SEQ_MASK)
+#define WIRE_IS_PARITY(payload) ((WIRE_TYPE(payload) & WIRE_TYPE_PARITY) != 0)
+#define WIRE_PARITY_COVERS(payload) ((WIRE_TYPE(payload) & 0x7) + 1)
+
+/* change messages received since anything else, for rebuilding one from a parity message */
+typedef struct wire_parity {
+  uint8_t messages[WIRE_PARITY_SPAN][WIRE_PAYLOAD_SIZE];
+  uint8_t count;
+} wire_parity_t;
+
+void wire_encode_page(uint8_t* payload, uint8_t seq, uint8_t page, const group_data_t* groups,
+                      uint8_t changed);
+void wire_encode_changes(uint8_t* payload, uint8_t seq, const group_data_t* groups,
+                         const uint8_t* indexes, uint8_t count);
+void wire_encode_time(uint8_t* payload, uint8_t seq, uint32_t show_time);
+void wire_encode_cue(uint8_t* payload, uint8_t seq, uint8_t index, const group_data_t* data,
+                     uint32_t show_time);
+void wire_encode_parity(uint8_t* payload, uint8_t seq, uint8_t covers, const uint8_t* parity);
+bool wire_decode_group(const uint8_t* payload, uint8_t group, group_data_t* data);
+bool wire_decode_time(const uint8_t* payload, uint32_t* show_time);
+bool wire_decode_cue(const uint8_t* payload, uint8_t group, uint32_t now, group_data_t* data,
+                     uint32_t* show_time);
+void wire_parity_reset(wire_parity_t* parity);
+void wire_parity_add(wire_parity_t* parity, const uint8_t* payload);
+bool wire_parity_recover(const wire_parity_t* parity, const uint8_t* payload, uint8_t group,
+                         group_data_t* data);
+
+#endif /* WIRE_H */